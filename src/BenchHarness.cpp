@@ -0,0 +1,40 @@
+#include "BenchHarness.hpp"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocations(0);
+
+void* countedAlloc(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    void* block = std::malloc(size == 0 ? 1 : size);
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    return block;
+}
+
+} // namespace
+
+// Global replacements: every new in the benchmark goes through the counter.
+// The aligned and nothrow forms keep their defaults (nothing here uses them on
+// a measured path).
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* block) noexcept { std::free(block); }
+void operator delete[](void* block) noexcept { std::free(block); }
+void operator delete(void* block, size_t) noexcept { std::free(block); }
+void operator delete[](void* block, size_t) noexcept { std::free(block); }
+
+uint64_t benchAllocationCount() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void BenchSuite::print(const BenchResult& result) {
+    printf("  %-40s %12.1f ns median %12.1f ns p99 %7.2f allocs/op\n",
+           result.name.c_str(), result.medianNs, result.p99Ns, result.allocsPerOp);
+    fflush(stdout);
+}
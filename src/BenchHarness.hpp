@@ -0,0 +1,102 @@
+#ifndef BENCH_HARNESS_HPP
+#define BENCH_HARNESS_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Allocations made through the global operator new since the process started.
+// BenchHarness.cpp replaces the global operators, so this only counts in
+// executables that link it (RazerBench).
+uint64_t benchAllocationCount();
+
+// Sampling for BenchSuite
+struct BenchOptions {
+    uint32_t samples = 101;             // Timed samples per case
+    uint64_t minSampleNs = 1000000;     // Ops per sample grow until a sample takes this long
+    uint64_t maxOpsPerSample = 1 << 22;
+    std::string filter;                 // Only cases whose name contains this (empty = all)
+};
+
+struct BenchResult {
+    std::string name;
+    uint64_t opsPerSample = 0;
+    double medianNs = 0;     // Per op, median over samples
+    double p99Ns = 0;        // Per op, 99th percentile over samples
+    double allocsPerOp = 0;  // operator new calls per op over all samples
+};
+
+// Reusable timing loop with stable statistics.
+//
+// Each case is calibrated first: ops per sample double until one sample takes
+// minSampleNs, so fast operations are timed in batches (a sample is then the
+// batch mean) and slow ones, like a query cycle waiting on the device, one op
+// per sample. The median and p99 over the samples are much steadier between
+// runs than a single mean, and the allocation count per op is exact. work(i)
+// gets a running op index to vary its input.
+class BenchSuite {
+public:
+    explicit BenchSuite(const BenchOptions& options = BenchOptions()) : options_(options) {}
+
+    bool wants(const char* name) const {
+        return options_.filter.empty() || std::strstr(name, options_.filter.c_str()) != nullptr;
+    }
+
+    // Times and prints one case; false if the filter skips it (results()
+    // then gains no entry)
+    template <typename Work>
+    bool run(const char* name, Work work) {
+        if (!wants(name)) {
+            return false;
+        }
+
+        uint64_t op = 0;
+        uint64_t ops = 1;
+        while (ops < options_.maxOpsPerSample && timeBatch(work, op, ops) < options_.minSampleNs) {
+            ops *= 2;
+        }
+
+        std::vector<double> perOp;
+        perOp.reserve(options_.samples);
+        uint64_t allocationsBefore = benchAllocationCount();
+        for (uint32_t s = 0; s < options_.samples; s++) {
+            perOp.push_back((double)timeBatch(work, op, ops) / (double)ops);
+        }
+        uint64_t allocations = benchAllocationCount() - allocationsBefore;
+        std::sort(perOp.begin(), perOp.end());
+
+        BenchResult result;
+        result.name = name;
+        result.opsPerSample = ops;
+        result.medianNs = perOp[perOp.size() / 2];
+        result.p99Ns = perOp[std::min(perOp.size() - 1, perOp.size() * 99 / 100)];
+        result.allocsPerOp = (double)allocations / ((double)ops * options_.samples);
+        results_.push_back(result);
+        print(result);
+        return true;
+    }
+
+    const std::vector<BenchResult>& results() const { return results_; }
+
+    // One aligned line per case: median, p99, allocations per op
+    static void print(const BenchResult& result);
+
+private:
+    BenchOptions options_;
+    std::vector<BenchResult> results_;
+
+    template <typename Work>
+    static uint64_t timeBatch(Work& work, uint64_t& op, uint64_t ops) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < ops; i++) {
+            work(op++);
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+    }
+};
+
+#endif // BENCH_HARNESS_HPP
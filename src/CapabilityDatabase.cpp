@@ -0,0 +1,313 @@
+#include "CapabilityDatabase.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[6] = {'R', 'Z', 'C', 'A', 'P', 'S'};
+constexpr uint16_t VERSION = 2;  // 1: 16-byte header without response layout
+
+bool commandLess(const RazerCapability& a, const RazerCapability& b) {
+    return a.cmdClass != b.cmdClass ? a.cmdClass < b.cmdClass : a.cmdId < b.cmdId;
+}
+
+const RazerCapability* findCommand(const RazerCapability* begin, const RazerCapability* end,
+                                   uint8_t cmdClass, uint8_t cmdId) {
+    RazerCapability key = {cmdClass, cmdId, 0, 0, 0, 0, 0};
+    const RazerCapability* it = std::lower_bound(begin, end, key, commandLess);
+    if (it == end || it->cmdClass != cmdClass || it->cmdId != cmdId) {
+        return nullptr;
+    }
+    return it;
+}
+
+bool isCommand(const RazerCommand& command, const RazerCommand& known) {
+    return command.cmdClass == known.cmdClass && command.cmdId == known.cmdId;
+}
+
+// Everything but the entries; false for files this version cannot use
+bool validHeader(const RazerCapabilityHeader& header) {
+    return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION &&
+           header.entrySize == sizeof(RazerCapability) && header.batteryFullScale != 0 &&
+           header.batteryOffset < RazerReportLayout::SIZE && header.chargingOffset < RazerReportLayout::SIZE;
+}
+
+} // namespace
+
+const RazerCapability* RazerCapabilities::find(uint8_t cmdClass, uint8_t cmdId) const {
+    return findCommand(commands.data(), commands.data() + commands.size(), cmdClass, cmdId);
+}
+
+void RazerCapabilities::describe(const RazerDeviceMatch& match) {
+    if (match.device == nullptr) {
+        return;  // Not in the table: keep the protocol defaults
+    }
+    batteryOffset = match.device->batteryOffset;
+    batteryFullScale = 255;
+    chargingOffset = 11;
+    flags = (uint8_t)((flags & ~CAPABILITY_WIRELESS) | (match.isWireless ? CAPABILITY_WIRELESS : 0));
+}
+
+void RazerCapabilities::merge(const std::vector<DiscoveryRecord>& records) {
+    // Answers per transaction ID, counting what is already known
+    uint32_t answered[256] = {};
+    for (const RazerCapability& command : commands) {
+        answered[command.transactionId]++;
+    }
+    for (const DiscoveryRecord& record : records) {
+        if (record.kind == DISCOVERY_COMMAND && DiscoveryEngine::isDataStatus(record.status)) {
+            answered[record.transactionId]++;
+        }
+    }
+    uint32_t best = 0;
+    for (uint32_t id = 0; id < 256; id++) {
+        if (answered[id] > answered[best]) {
+            best = id;
+        }
+    }
+    if (answered[best] != 0) {
+        transactionId = (uint8_t)best;
+    }
+
+    for (const DiscoveryRecord& record : records) {
+        if (record.kind != DISCOVERY_COMMAND || !DiscoveryEngine::isDataStatus(record.status)) {
+            continue;
+        }
+        RazerCapability entry;
+        entry.cmdClass = record.cmdClass;
+        entry.cmdId = record.cmdId;
+        entry.transactionId = record.transactionId;
+        entry.dataSize = record.dataSize;
+        entry.status = record.status;
+        entry.flags = record.flags;
+        entry.latencyUs = (uint16_t)std::min<uint32_t>(record.latencyUs, UINT16_MAX);
+
+        auto it = std::lower_bound(commands.begin(), commands.end(), entry, commandLess);
+        if (it == commands.end() || it->cmdClass != entry.cmdClass || it->cmdId != entry.cmdId) {
+            commands.insert(it, entry);
+        } else if (entry.transactionId == transactionId || it->transactionId != transactionId) {
+            // Prefer the answer on the device's own ID, and the one with data
+            entry.flags |= it->flags;
+            *it = entry;
+        }
+    }
+
+    // A battery get refused on the device's own ID: a cable PID that is full
+    // and charging whenever it is connected
+    for (const DiscoveryRecord& record : records) {
+        if (record.kind == DISCOVERY_COMMAND && record.transactionId == transactionId &&
+            record.cmdClass == RazerProtocol::CMD_BATTERY.cmdClass &&
+            record.cmdId == RazerProtocol::CMD_BATTERY.cmdId &&
+            DiscoveryEngine::isUnsupportedStatus(record.status)) {
+            flags |= CAPABILITY_NO_BATTERY;
+        }
+    }
+    const RazerCapability* battery = find(RazerProtocol::CMD_BATTERY.cmdClass, RazerProtocol::CMD_BATTERY.cmdId);
+    if (battery != nullptr) {
+        flags &= (uint8_t)~CAPABILITY_NO_BATTERY;
+        latencyUs = battery->latencyUs;
+    }
+}
+
+const RazerCapability* RazerCapabilityView::find(uint8_t cmdClass, uint8_t cmdId) const {
+    return findCommand(commands, commands + header->count, cmdClass, cmdId);
+}
+
+void RazerCapabilityView::applyTo(RazerProtocolProfile& profile) const {
+    profile.transactionId = header->transactionId;  // Discovered, not guessed
+    profile.batteryOffset = header->batteryOffset;
+    profile.batteryFullScale = header->batteryFullScale;
+    profile.chargingOffset = header->chargingOffset;
+    // On a dongle 0x04 means the mouse behind it is off or asleep, not wired
+    profile.notSupportedMeansWired = !isWireless();
+}
+
+size_t RazerCapabilityView::planBatch(const RazerCommand* commands, size_t count, RazerCommand* batch,
+                                      size_t capacity, RazerSnapshot& snapshot) const {
+    size_t batchCount = 0;
+    for (size_t i = 0; i < count && batchCount < capacity; i++) {
+        const RazerCommand& command = commands[i];
+        if (!isWireless() && isCommand(command, RazerProtocol::CMD_CHARGING)) {
+            snapshot.isCharging = true;  // Powered by the cable
+            snapshot.chargingValid = true;
+            continue;
+        }
+        if (!hasBattery() && isCommand(command, RazerProtocol::CMD_BATTERY)) {
+            snapshot.batteryPercent = 100;
+            snapshot.batteryValid = true;
+            continue;
+        }
+        if (!supports(command.cmdClass, command.cmdId)) {
+            continue;  // Would only be refused
+        }
+        batch[batchCount++] = command;
+    }
+    return batchCount;
+}
+
+CapabilityDatabase::~CapabilityDatabase() {
+    unmapAll();
+}
+
+void CapabilityDatabase::unmapAll() {
+    for (const Mapping& mapping : mappings_) {
+        munmap(mapping.base, mapping.length);
+    }
+    mappings_.clear();
+    index_.clear();
+}
+
+bool CapabilityDatabase::mapFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(RazerCapabilityHeader)) {
+        close(fd);
+        return false;
+    }
+    size_t length = (size_t)info.st_size;
+    void* base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping keeps the file
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    RazerCapabilityView view;
+    view.header = static_cast<const RazerCapabilityHeader*>(base);
+    view.commands = reinterpret_cast<const RazerCapability*>(view.header + 1);
+    bool ok = validHeader(*view.header) &&
+              length >= sizeof(RazerCapabilityHeader) + (size_t)view.header->count * sizeof(RazerCapability) &&
+              find(view.header->pid) == nullptr;
+    // Entries are searched in place, so they must already be sorted
+    for (size_t i = 1; ok && i < view.size(); i++) {
+        ok = commandLess(view.commands[i - 1], view.commands[i]);
+    }
+    if (!ok) {
+        munmap(base, length);
+        return false;
+    }
+
+    mappings_.push_back({base, length});
+    index_.insert(std::upper_bound(index_.begin(), index_.end(), view,
+                                   [](const RazerCapabilityView& a, const RazerCapabilityView& b) {
+                                       return a.pid() < b.pid();
+                                   }),
+                  view);
+    return true;
+}
+
+bool CapabilityDatabase::loadDirectory(const std::string& dir) {
+    unmapAll();
+    DIR* directory = opendir(dir.c_str());
+    if (directory == nullptr) {
+        return false;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != nullptr) {
+        std::string name = entry->d_name;
+        if (name.size() < 11 || name.compare(0, 6, "razer-") != 0 ||
+            name.compare(name.size() - 5, 5, ".caps") != 0) {
+            continue;
+        }
+        if (!mapFile(dir + "/" + name)) {
+            std::cerr << "Capabilities: skipping unreadable " << dir << "/" << name << std::endl;
+        }
+    }
+    closedir(directory);
+    return true;
+}
+
+const RazerCapabilityView* CapabilityDatabase::find(uint16_t pid) const {
+    auto it = std::lower_bound(index_.begin(), index_.end(), pid,
+                               [](const RazerCapabilityView& view, uint16_t key) { return view.pid() < key; });
+    return it != index_.end() && it->pid() == pid ? &*it : nullptr;
+}
+
+std::string CapabilityDatabase::defaultDirectory() {
+    const char* home = getenv("HOME");
+    std::string base = home != nullptr && home[0] != '\0' ? home : ".";
+#ifdef __APPLE__
+    return base + "/Library/Application Support/RazerBatteryMonitor/Capabilities";
+#else
+    return base + "/.local/share/razer-battery/capabilities";
+#endif
+}
+
+std::string CapabilityDatabase::fileName(uint16_t pid) {
+    char name[32];
+    snprintf(name, sizeof(name), "razer-%04x.caps", pid);
+    return name;
+}
+
+bool CapabilityDatabase::load(const std::string& path, RazerCapabilities& capabilities) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    RazerCapabilityHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1 && validHeader(header);
+    if (ok) {
+        capabilities.pid = header.pid;
+        capabilities.transactionId = header.transactionId;
+        capabilities.flags = header.flags;
+        capabilities.batteryOffset = header.batteryOffset;
+        capabilities.batteryFullScale = header.batteryFullScale;
+        capabilities.chargingOffset = header.chargingOffset;
+        capabilities.latencyUs = header.latencyUs;
+        capabilities.commands.resize(header.count);
+        ok = header.count == 0 ||
+             fread(capabilities.commands.data(), sizeof(RazerCapability), header.count, file) == header.count;
+    }
+    fclose(file);
+    if (ok) {
+        // Lookups binary-search; do not trust the writer to have sorted
+        std::sort(capabilities.commands.begin(), capabilities.commands.end(), commandLess);
+    }
+    return ok;
+}
+
+bool CapabilityDatabase::save(const std::string& dir, const RazerCapabilities& capabilities) {
+    std::string path = dir + "/" + fileName(capabilities.pid);
+    std::string temp = path + ".tmp";
+
+    RazerCapabilityHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.pid = capabilities.pid;
+    header.transactionId = capabilities.transactionId;
+    header.flags = capabilities.flags;
+    header.batteryOffset = capabilities.batteryOffset;
+    header.batteryFullScale = capabilities.batteryFullScale;
+    header.chargingOffset = capabilities.chargingOffset;
+    header.latencyUs = capabilities.latencyUs;
+    header.count = (uint16_t)std::min<size_t>(capabilities.commands.size(), UINT16_MAX);
+    header.entrySize = sizeof(RazerCapability);
+
+    FILE* file = fopen(temp.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Capabilities: cannot create " << temp << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              (header.count == 0 ||
+               fwrite(capabilities.commands.data(), sizeof(RazerCapability), header.count, file) == header.count);
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Capabilities: cannot write " << path << std::endl;
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,143 @@
+#ifndef CAPABILITY_DATABASE_HPP
+#define CAPABILITY_DATABASE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DiscoveryEngine.hpp"
+#include "RazerDeviceTable.hpp"
+#include "RazerProtocol.hpp"
+
+// One command a device answered with data (8 bytes on disk)
+struct RazerCapability {
+    uint8_t cmdClass;
+    uint8_t cmdId;
+    uint8_t transactionId;  // ID it answered on (the device's main one when several did)
+    uint8_t dataSize;       // Data size of the answer
+    uint8_t status;         // 0x00 or 0x02
+    uint8_t flags;          // DISCOVERY_HAS_DATA
+    uint16_t latencyUs;     // Measured turnaround, saturated at 65535
+};
+static_assert(sizeof(RazerCapability) == 8, "Capability entry must stay 8 bytes on disk");
+
+constexpr uint8_t CAPABILITY_WIRELESS = 0x01;    // Dongle PID: the mouse behind it reports its battery
+constexpr uint8_t CAPABILITY_NO_BATTERY = 0x02;  // Battery get refused (cable): full and charging, never asked
+
+// Per-PID header of a capability file (32 bytes on disk); the sorted entries follow
+struct RazerCapabilityHeader {
+    char magic[6];
+    uint16_t version;
+    uint16_t pid;
+    uint8_t transactionId;
+    uint8_t flags;              // CAPABILITY_*
+    uint8_t batteryOffset;      // Response byte holding the raw battery level
+    uint8_t batteryFullScale;   // Raw level that means 100%
+    uint8_t chargingOffset;     // Response byte holding 0x01 while charging
+    uint8_t reserved0;
+    uint16_t count;             // Entries that follow
+    uint16_t entrySize;
+    uint32_t latencyUs;         // Typical battery query turnaround (0 = unknown)
+    uint8_t reserved[8];
+};
+static_assert(sizeof(RazerCapabilityHeader) == 32, "Capability header must stay 32 bytes on disk");
+
+// Everything discovered about one PID, as RazerDiscover builds and saves it:
+// the transaction ID it answers on, how to read its answers and its commands,
+// sorted by class/id
+struct RazerCapabilities {
+    uint16_t pid = 0;
+    uint8_t transactionId = 0;
+    uint8_t flags = 0;
+    uint8_t batteryOffset = 9;
+    uint8_t batteryFullScale = 255;
+    uint8_t chargingOffset = 11;
+    uint32_t latencyUs = 0;
+    std::vector<RazerCapability> commands;
+
+    const RazerCapability* find(uint8_t cmdClass, uint8_t cmdId) const;
+    bool supports(uint8_t cmdClass, uint8_t cmdId) const { return find(cmdClass, cmdId) != nullptr; }
+
+    // Response layout and link type from the supported device table, for a PID
+    // seen for the first time
+    void describe(const RazerDeviceMatch& match);
+
+    // Folds discovery records in: one entry per class/id however many
+    // transaction IDs and retries answered it. The transaction ID that answered
+    // the most commands becomes the device's; a refused battery get on it marks
+    // the PID CAPABILITY_NO_BATTERY.
+    void merge(const std::vector<DiscoveryRecord>& records);
+};
+
+// One PID's file as mapped by CapabilityDatabase; valid while the database lives
+struct RazerCapabilityView {
+    const RazerCapabilityHeader* header;
+    const RazerCapability* commands;  // header->count entries, sorted
+
+    uint16_t pid() const { return header->pid; }
+    uint8_t transactionId() const { return header->transactionId; }
+    size_t size() const { return header->count; }
+    uint32_t latencyUs() const { return header->latencyUs; }
+    bool isWireless() const { return (header->flags & CAPABILITY_WIRELESS) != 0; }
+    bool hasBattery() const { return (header->flags & CAPABILITY_NO_BATTERY) == 0; }
+
+    const RazerCapability* find(uint8_t cmdClass, uint8_t cmdId) const;
+    bool supports(uint8_t cmdClass, uint8_t cmdId) const { return find(cmdClass, cmdId) != nullptr; }
+
+    // Overwrites what the file knows (transaction ID, offsets, scaling, what
+    // 0x04 means) so the first query after connect is already the right one
+    void applyTo(RazerProtocolProfile& profile) const;
+
+    // Drops the commands this PID does not answer from a refresh batch. What
+    // the file answers by itself (a cable-powered mouse is full and charging)
+    // goes straight into snapshot. Returns the number of commands left in batch.
+    size_t planBatch(const RazerCommand* commands, size_t count, RazerCommand* batch, size_t capacity,
+                     RazerSnapshot& snapshot) const;
+};
+
+// Per-PID capability files in one directory (razer-<pid>.caps), written by
+// RazerDiscover and loaded by the monitor at startup.
+//
+// File (version 2): 32-byte header (magic, version, PID, transaction ID, link
+// flags, battery/charging offsets, battery scaling, expected latency, entry
+// count), then the 8-byte entries sorted by class/id. loadDirectory() maps each
+// file read-only and keeps a PID-sorted index of the mappings, so a lookup at
+// connect time is a binary search and the entries are used in place.
+class CapabilityDatabase {
+public:
+    CapabilityDatabase() = default;
+    ~CapabilityDatabase();
+
+    CapabilityDatabase(const CapabilityDatabase&) = delete;
+    CapabilityDatabase& operator=(const CapabilityDatabase&) = delete;
+
+    // Maps every capability file in dir; false if the directory is missing.
+    // Files that fail to validate are skipped with a warning.
+    bool loadDirectory(const std::string& dir);
+
+    // nullptr if nothing is known about the PID
+    const RazerCapabilityView* find(uint16_t pid) const;
+    size_t size() const { return index_.size(); }
+
+    // Writes capabilities to dir, replacing the PID's file (atomic rename)
+    static bool save(const std::string& dir, const RazerCapabilities& capabilities);
+    static bool load(const std::string& path, RazerCapabilities& capabilities);
+    static std::string fileName(uint16_t pid);
+
+    // ~/Library/Application Support/RazerBatteryMonitor/Capabilities (next to
+    // the app's history files), ~/.local/share/razer-battery/capabilities elsewhere
+    static std::string defaultDirectory();
+
+private:
+    struct Mapping {
+        void* base;
+        size_t length;
+    };
+    std::vector<Mapping> mappings_;
+    std::vector<RazerCapabilityView> index_;  // Sorted by PID
+
+    bool mapFile(const std::string& path);
+    void unmapAll();
+};
+
+#endif // CAPABILITY_DATABASE_HPP
@@ -0,0 +1,134 @@
+#include "ConnectionStateMachine.hpp"
+#include <algorithm>
+
+const char* connectionStateName(ConnectionState state) {
+    switch (state) {
+        case ConnectionState::Disconnected: return "Disconnected";
+        case ConnectionState::Enumerating: return "Enumerating";
+        case ConnectionState::Opening: return "Opening";
+        case ConnectionState::ModeSwitching: return "ModeSwitching";
+        case ConnectionState::Ready: return "Ready";
+    }
+    return "Unknown";
+}
+
+ConnectionStateMachine::ConnectionStateMachine(const ConnectionRetryPolicy& policy, uint32_t seed)
+    : policy_(policy),
+      state_(ConnectionState::Disconnected),
+      pending_(false),
+      inFlight_(false),
+      cancelled_(false),
+      gaveUp_(false),
+      lostDuringAttempt_(false),
+      nextAttemptAtMs_(0),
+      startedAtMs_(0),
+      generation_(0),
+      attempts_(0),
+      retryDelayMs_(policy.firstRetryMs),
+      rng_(seed ? seed : 1) {
+}
+
+uint32_t ConnectionStateMachine::jitter(uint32_t delayMs) {
+    if (policy_.jitterPercent == 0 || delayMs == 0) {
+        return delayMs;
+    }
+    // xorshift32 - deterministic per seed
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    uint32_t spread = delayMs * policy_.jitterPercent / 100;
+    return delayMs - spread + rng_ % (2 * spread + 1);
+}
+
+void ConnectionStateMachine::restart(uint64_t nowMs) {
+    generation_++;
+    pending_ = true;
+    cancelled_ = false;
+    gaveUp_ = false;
+    lostDuringAttempt_ = false;
+    nextAttemptAtMs_ = nowMs;  // First attempt fires immediately
+    startedAtMs_ = nowMs;
+    attempts_ = 0;
+    retryDelayMs_ = policy_.firstRetryMs;
+}
+
+void ConnectionStateMachine::onDeviceMatched(uint64_t nowMs) {
+    if (inFlight_) {
+        // The running attempt will see the new device; just make sure a
+        // failure retries promptly instead of waiting out a long backoff
+        retryDelayMs_ = policy_.firstRetryMs;
+        return;
+    }
+    restart(nowMs);
+}
+
+void ConnectionStateMachine::onDeviceLost(uint64_t nowMs) {
+    state_ = ConnectionState::Disconnected;
+    if (inFlight_) {
+        lostDuringAttempt_ = true;  // onAttemptFinished() restarts
+        return;
+    }
+    restart(nowMs);
+}
+
+void ConnectionStateMachine::cancel() {
+    generation_++;
+    pending_ = false;
+    cancelled_ = true;
+}
+
+bool ConnectionStateMachine::beginAttemptIfDue(uint64_t nowMs) {
+    if (!pending_ || inFlight_ || nowMs < nextAttemptAtMs_) {
+        return false;
+    }
+    pending_ = false;
+    inFlight_ = true;
+    attempts_++;
+    state_ = ConnectionState::Enumerating;
+    return true;
+}
+
+void ConnectionStateMachine::onAttemptFinished(ConnectionState reached, uint64_t nowMs) {
+    if (!inFlight_) {
+        return;
+    }
+    inFlight_ = false;
+
+    if (lostDuringAttempt_) {
+        // Whatever it reached is gone: start over, unless cancelled meanwhile
+        lostDuringAttempt_ = false;
+        state_ = ConnectionState::Disconnected;
+        if (!cancelled_) {
+            restart(nowMs);
+        }
+        return;
+    }
+
+    if (reached == ConnectionState::Ready) {
+        state_ = ConnectionState::Ready;
+        pending_ = false;
+        gaveUp_ = false;
+        retryDelayMs_ = policy_.firstRetryMs;
+        return;
+    }
+
+    state_ = ConnectionState::Disconnected;
+    if (cancelled_) {
+        return;
+    }
+    if (nowMs - startedAtMs_ >= policy_.giveUpAfterMs) {
+        gaveUp_ = true;
+    }
+
+    // A device that was found but failed to open/switch is usually still settling
+    // after enumeration: retry at the short delay. Nothing on the bus: back off.
+    uint32_t delayMs = retryDelayMs_;
+    if (reached == ConnectionState::Opening || reached == ConnectionState::ModeSwitching) {
+        delayMs = policy_.firstRetryMs;
+    } else {
+        retryDelayMs_ = std::min(retryDelayMs_ * 2, policy_.maxRetryMs);
+    }
+
+    pending_ = true;
+    nextAttemptAtMs_ = nowMs + jitter(delayMs);
+}
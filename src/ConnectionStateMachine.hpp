@@ -0,0 +1,83 @@
+#ifndef CONNECTION_STATE_MACHINE_HPP
+#define CONNECTION_STATE_MACHINE_HPP
+
+#include <cstdint>
+
+// Where a connection is (or how far the last connect attempt got)
+enum class ConnectionState : uint8_t {
+    Disconnected,
+    Enumerating,    // Looking for a supported PID on the bus
+    Opening,        // Device found, opening Interface 2
+    ModeSwitching,  // Interface open, switching to driver mode
+    Ready
+};
+
+const char* connectionStateName(ConnectionState state);
+
+// Retry timing for ConnectionStateMachine (milliseconds)
+struct ConnectionRetryPolicy {
+    uint32_t firstRetryMs = 250;      // Delay after the first failed attempt
+    uint32_t maxRetryMs = 10000;      // Backoff cap; retries continue at this rate
+    uint32_t jitterPercent = 20;      // +/- random spread on every delay
+    uint32_t giveUpAfterMs = 15000;   // Report "not found" after this long without success
+};
+
+// Event-driven connect/reconnect logic, free of any clock or thread.
+//
+// The caller feeds it events with the current time (monotonic ms) and asks when
+// the next attempt is due; main.mm drives it from one dispatch timer, and a
+// virtual clock can drive it the same way on Linux. Every (re)start bumps the
+// generation, so a timer armed for an older generation is simply ignored -
+// that is how pending retries are cancelled.
+class ConnectionStateMachine {
+public:
+    explicit ConnectionStateMachine(const ConnectionRetryPolicy& policy = ConnectionRetryPolicy(),
+                                    uint32_t seed = 0x5EED);
+
+    // A supported device matched (or a reconnect was requested): attempt at once
+    void onDeviceMatched(uint64_t nowMs);
+
+    // The open device went away: drop to Disconnected and start retrying. During
+    // an attempt the retry waits for it to finish, and even a Ready outcome then
+    // counts as lost (the device it reached is gone).
+    void onDeviceLost(uint64_t nowMs);
+
+    // Stop retrying (e.g. on quit); state is left as is. An attempt already in
+    // flight may still finish and report Ready, but no new one is scheduled.
+    void cancel();
+
+    // Driver calls this when the timer fires; true = start an attempt now
+    bool beginAttemptIfDue(uint64_t nowMs);
+
+    // Outcome of the attempt begun by beginAttemptIfDue. reached = furthest phase
+    // the connect path got to (Ready on success).
+    void onAttemptFinished(ConnectionState reached, uint64_t nowMs);
+
+    ConnectionState state() const { return state_; }
+    bool attemptInFlight() const { return inFlight_; }
+    bool hasPendingAttempt() const { return pending_; }
+    uint64_t nextAttemptAtMs() const { return nextAttemptAtMs_; }
+    uint64_t generation() const { return generation_; }
+    uint32_t attempts() const { return attempts_; }
+    bool gaveUp() const { return gaveUp_; }
+
+private:
+    ConnectionRetryPolicy policy_;
+    ConnectionState state_;
+    bool pending_;
+    bool inFlight_;
+    bool cancelled_;
+    bool gaveUp_;
+    bool lostDuringAttempt_;
+    uint64_t nextAttemptAtMs_;
+    uint64_t startedAtMs_;
+    uint64_t generation_;
+    uint32_t attempts_;
+    uint32_t retryDelayMs_;
+    uint32_t rng_;
+
+    void restart(uint64_t nowMs);
+    uint32_t jitter(uint32_t delayMs);
+};
+
+#endif // CONNECTION_STATE_MACHINE_HPP
@@ -0,0 +1,43 @@
+#include "DeviceEvents.hpp"
+#include "RazerDeviceTable.hpp"
+#include <algorithm>
+
+DeviceEventAction classifyDeviceEvent(const DeviceEvent& event, bool connected,
+                                      uint16_t openPid, uint32_t openLocationId) {
+    RazerDeviceMatch match = RazerDeviceTable::find(event.pid);
+    if (match.device == nullptr) {
+        return DeviceEventAction::Ignore;  // Keyboard, headset, ... on the same VID
+    }
+    
+    if (!connected) {
+        // A supported device appeared (or something changed) while we have nothing open
+        return event.added ? DeviceEventAction::Reconnect : DeviceEventAction::Ignore;
+    }
+    
+    bool sameDevice = event.pid == openPid &&
+        (event.locationId == 0 || openLocationId == 0 || event.locationId == openLocationId);
+    if (sameDevice) {
+        // Our interface is gone (removed) or was re-enumerated (added again)
+        return DeviceEventAction::Reconnect;
+    }
+    
+    RazerDeviceMatch open = RazerDeviceTable::find(openPid);
+    if (open.device == match.device && event.pid != openPid) {
+        // Other PID of the same model: cable plugged/unplugged next to the dongle.
+        // The same PID elsewhere is a second mouse of that model, not ours.
+        return DeviceEventAction::Probe;
+    }
+    
+    return DeviceEventAction::Ignore;
+}
+
+void sortByConnectPreference(std::vector<DeviceEvent>& devices) {
+    std::stable_sort(devices.begin(), devices.end(), [](const DeviceEvent& a, const DeviceEvent& b) {
+        RazerDeviceMatch ma = RazerDeviceTable::find(a.pid);
+        RazerDeviceMatch mb = RazerDeviceTable::find(b.pid);
+        if (ma.tableIndex != mb.tableIndex) {
+            return ma.tableIndex < mb.tableIndex;
+        }
+        return ma.isWireless && !mb.isWireless;
+    });
+}
@@ -0,0 +1,31 @@
+#ifndef DEVICE_EVENTS_HPP
+#define DEVICE_EVENTS_HPP
+
+#include <cstdint>
+#include <vector>
+
+// One hotplug notification for a Razer (VID 0x1532) USB device
+struct DeviceEvent {
+    bool added;           // false = removed
+    uint16_t pid;
+    uint32_t locationId;  // USB location, 0 if unknown
+};
+
+// What the monitor should do about a hotplug event
+enum class DeviceEventAction {
+    Ignore,     // Unrelated device - keep the open interface untouched
+    Probe,      // Sibling PID of the open model changed (cable in/out): check liveness, refresh
+    Reconnect   // Open device went away, or nothing is open: run the connect path
+};
+
+// Decides from the event and the currently open device whether a USB topology
+// change actually affects us. Only a removal of the open device, or an arrival
+// while nothing is open, costs a full reconnect.
+DeviceEventAction classifyDeviceEvent(const DeviceEvent& event, bool connected,
+                                      uint16_t openPid, uint32_t openLocationId);
+
+// Orders attached devices the way RazerDevice::connect() prefers them: earliest
+// table entry first, wireless PID before the wired one
+void sortByConnectPreference(std::vector<DeviceEvent>& devices);
+
+#endif // DEVICE_EVENTS_HPP
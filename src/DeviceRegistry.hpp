@@ -0,0 +1,156 @@
+#ifndef DEVICE_REGISTRY_HPP
+#define DEVICE_REGISTRY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "ConnectionStateMachine.hpp"
+#include "DeviceWorker.hpp"
+#include "PollScheduler.hpp"
+
+// Every monitored device, each with its own worker thread, connect state and
+// poll schedule.
+//
+// Device is whatever the caller keeps per device (main.mm: the IOKit device
+// plus its sample ring and history; RazerBench: a simulated transport). It is
+// created by the caller and only touched from jobs on its slot's worker, so a
+// slow or busy dongle delays its own jobs and nobody else's: refreshing N
+// devices takes as long as the slowest one, not the sum. The registry itself
+// and the slot bookkeeping belong to one thread (main.mm: the main queue).
+template <typename Device>
+class DeviceRegistry {
+public:
+    struct Slot {
+        uint32_t id = 0;          // Registry key (USB location on macOS)
+        uint16_t pid = 0;
+        std::unique_ptr<Device> device;
+        ConnectionStateMachine connection;
+        PollScheduler scheduler;
+        DeviceJobResult last;     // Latest completed job, as seen by the owning thread
+
+        // Declared last: destroyed (stopped and joined) before the device goes away
+        std::unique_ptr<DeviceWorker> worker;
+    };
+
+    // Per-device completion for postAll; runs on that device's worker thread
+    typedef std::function<void(uint32_t id, const DeviceJobResult& result)> SlotCompletion;
+
+    DeviceRegistry() {}
+    ~DeviceRegistry() { clear(); }
+
+    DeviceRegistry(const DeviceRegistry&) = delete;
+    DeviceRegistry& operator=(const DeviceRegistry&) = delete;
+
+    // Starts the device's worker; nullptr if the id is already registered
+    Slot* add(uint32_t id, uint16_t pid, std::unique_ptr<Device> device) {
+        if (slots_.count(id) != 0) {
+            return nullptr;
+        }
+        std::unique_ptr<Slot> slot(new Slot());
+        slot->id = id;
+        slot->pid = pid;
+        slot->device = std::move(device);
+        slot->worker.reset(new DeviceWorker());
+
+        Slot* raw = slot.get();
+        slots_[id] = std::move(slot);
+        return raw;
+    }
+
+    // Finishes the device's running job, drops queued ones and destroys the slot
+    bool remove(uint32_t id) {
+        auto it = slots_.find(id);
+        if (it == slots_.end()) {
+            return false;
+        }
+        it->second->worker->stop();
+        slots_.erase(it);
+        return true;
+    }
+
+    void clear() {
+        stopAll();
+        slots_.clear();
+    }
+
+    // Stops every worker but keeps the slots (e.g. while quitting)
+    void stopAll() {
+        for (auto& entry : slots_) {
+            entry.second->worker->stop();
+        }
+    }
+
+    Slot* find(uint32_t id) const {
+        auto it = slots_.find(id);
+        return it != slots_.end() ? it->second.get() : nullptr;
+    }
+
+    size_t size() const { return slots_.size(); }
+    bool empty() const { return slots_.empty(); }
+
+    // Slots in id order
+    std::vector<Slot*> slots() const {
+        std::vector<Slot*> result;
+        result.reserve(slots_.size());
+        for (const auto& entry : slots_) {
+            result.push_back(entry.second.get());
+        }
+        return result;
+    }
+
+    // Queues a job on one device's worker (coalescing as DeviceWorker::post)
+    bool post(uint32_t id, uint32_t key, DeviceWorker::Job job,
+              DeviceWorker::Completion completion = DeviceWorker::Completion()) {
+        Slot* slot = find(id);
+        if (slot == nullptr) {
+            return false;
+        }
+        return slot->worker->post(key, std::move(job), std::move(completion));
+    }
+
+    // Fans one job out to every device at once. makeJob builds each device's job
+    // (on the calling thread); perDevice runs as each device finishes, allDone
+    // once after the last one, both on the worker that finished. Returns how many
+    // devices the job was posted to (allDone never runs for 0).
+    size_t postAll(uint32_t key, const std::function<DeviceWorker::Job(Slot& slot)>& makeJob,
+                   SlotCompletion perDevice, std::function<void()> allDone = std::function<void()>()) {
+        if (slots_.empty()) {
+            return 0;
+        }
+
+        struct FanOut {
+            std::atomic<size_t> remaining;
+            SlotCompletion perDevice;
+            std::function<void()> allDone;
+        };
+        std::shared_ptr<FanOut> fanOut(new FanOut());
+        fanOut->remaining = slots_.size();
+        fanOut->perDevice = std::move(perDevice);
+        fanOut->allDone = std::move(allDone);
+
+        for (auto& entry : slots_) {
+            uint32_t id = entry.first;
+            // Coalesced posts still get their completion, so the count always drains
+            entry.second->worker->post(key, makeJob(*entry.second),
+                [fanOut, id](const DeviceJobResult& result) {
+                    if (fanOut->perDevice) {
+                        fanOut->perDevice(id, result);
+                    }
+                    if (fanOut->remaining.fetch_sub(1) == 1 && fanOut->allDone) {
+                        fanOut->allDone();
+                    }
+                });
+        }
+        return slots_.size();
+    }
+
+private:
+    std::map<uint32_t, std::unique_ptr<Slot>> slots_;
+};
+
+#endif // DEVICE_REGISTRY_HPP
@@ -0,0 +1,20 @@
+#include "DeviceStatus.hpp"
+#include "DeviceWorker.hpp"
+#include "DrainModel.hpp"
+
+void updateDeviceStatus(DeviceStatus& status, const DeviceJobResult& result,
+                        const DrainModel& model, uint64_t wallMs) {
+    status.connected = result.connected;
+    if (result.ok) {
+        status.batteryValid = true;
+        status.batteryPercent = result.snapshot.batteryPercent;
+        status.charging = result.snapshot.chargingValid && result.snapshot.isCharging;
+        status.timeMs = wallMs;
+    }
+
+    uint64_t estimateMs = 0;
+    status.estimateToFull = model.charging();
+    status.estimateValid = status.estimateToFull ? model.timeToFullMs(estimateMs)
+                                                 : model.timeToEmptyMs(estimateMs);
+    status.estimateMs = estimateMs;
+}
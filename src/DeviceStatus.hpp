@@ -0,0 +1,31 @@
+#ifndef DEVICE_STATUS_HPP
+#define DEVICE_STATUS_HPP
+
+#include <cstdint>
+#include <string>
+
+struct DeviceJobResult;
+class DrainModel;
+
+// Cached state of one monitored device, as published to other processes
+// (StatusServer socket clients, SharedStatus readers)
+struct DeviceStatus {
+    uint32_t id = 0;              // Registry key
+    uint16_t pid = 0;
+    std::string name;
+    bool connected = false;
+    bool batteryValid = false;
+    uint8_t batteryPercent = 0;
+    bool charging = false;
+    uint64_t timeMs = 0;          // Wall clock (Unix ms) of the reading
+    bool estimateValid = false;
+    bool estimateToFull = false;  // false = time to empty
+    uint64_t estimateMs = 0;
+};
+
+// Folds a worker result into status. The last good reading stays (marked
+// disconnected) while the device is away; the estimate comes from model.
+void updateDeviceStatus(DeviceStatus& status, const DeviceJobResult& result,
+                        const DrainModel& model, uint64_t wallMs);
+
+#endif // DEVICE_STATUS_HPP
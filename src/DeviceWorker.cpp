@@ -0,0 +1,112 @@
+#include "DeviceWorker.hpp"
+#include <algorithm>
+
+DeviceWorker::DeviceWorker()
+    : stopping_(false),
+      executed_(0),
+      coalesced_(0),
+      totalQueueDelayUs_(0),
+      maxQueueDelayUs_(0),
+      thread_(&DeviceWorker::run, this) {
+}
+
+DeviceWorker::~DeviceWorker() {
+    stop();
+}
+
+bool DeviceWorker::post(uint32_t key, Job job, Completion completion) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+        return false;
+    }
+
+    if (key != 0) {
+        for (Entry& entry : queue_) {
+            if (entry.key == key) {
+                if (completion) {
+                    entry.completions.push_back(std::move(completion));
+                }
+                coalesced_++;
+                return false;
+            }
+        }
+    }
+
+    Entry entry;
+    entry.key = key;
+    entry.job = std::move(job);
+    if (completion) {
+        entry.completions.push_back(std::move(completion));
+    }
+    entry.postedAt = Clock::now();
+    queue_.push_back(std::move(entry));
+    wakeup_.notify_one();
+    return true;
+}
+
+void DeviceWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        queue_.clear();
+    }
+    wakeup_.notify_one();
+    if (thread_.joinable() && !isWorkerThread()) {
+        thread_.join();
+    }
+}
+
+size_t DeviceWorker::pendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+uint64_t DeviceWorker::executedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return executed_;
+}
+
+uint64_t DeviceWorker::coalescedCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return coalesced_;
+}
+
+uint64_t DeviceWorker::maxQueueDelayUs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return maxQueueDelayUs_;
+}
+
+uint64_t DeviceWorker::averageQueueDelayUs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return executed_ ? totalQueueDelayUs_ / executed_ : 0;
+}
+
+void DeviceWorker::run() {
+    while (true) {
+        Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeup_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_) {
+                return;
+            }
+            entry = std::move(queue_.front());
+            queue_.pop_front();
+
+            uint64_t delayUs = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                Clock::now() - entry.postedAt).count();
+            executed_++;
+            totalQueueDelayUs_ += delayUs;
+            maxQueueDelayUs_ = std::max(maxQueueDelayUs_, delayUs);
+        }
+
+        // Run outside the lock so callers can keep posting while USB I/O is in flight
+        DeviceJobResult result;
+        if (entry.job) {
+            entry.job(result);
+        }
+        for (const Completion& completion : entry.completions) {
+            completion(result);
+        }
+    }
+}
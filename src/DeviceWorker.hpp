@@ -0,0 +1,81 @@
+#ifndef DEVICE_WORKER_HPP
+#define DEVICE_WORKER_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "ConnectionStateMachine.hpp"
+#include "RazerProtocol.hpp"
+
+// Outcome of one device job, handed to every completion attached to it
+struct DeviceJobResult {
+    bool connected = false;   // Device was open after the job ran
+    bool ok = false;          // Job-specific success (e.g. snapshot has battery data)
+    uint16_t pid = 0;         // Open device identity when connected
+    uint32_t locationId = 0;
+    ConnectionState reached = ConnectionState::Disconnected;  // Furthest connect phase
+    RazerSnapshot snapshot;
+};
+
+// Serial execution context for all device I/O.
+//
+// The device object (RazerDevice, or a RazerProtocol over any transport) is only
+// touched from jobs run here, so slow USB transfers never block the caller. Jobs
+// posted with the same non-zero key while an earlier one is still queued are
+// coalesced: the job runs once and every completion receives its result.
+// Completions run on the worker thread; UI callers marshal them to their own
+// queue (main.mm uses dispatch_async to the main queue).
+class DeviceWorker {
+public:
+    typedef std::function<void(DeviceJobResult& result)> Job;
+    typedef std::function<void(const DeviceJobResult& result)> Completion;
+
+    DeviceWorker();
+    ~DeviceWorker();
+
+    // Returns false if the request was merged into an already queued job
+    bool post(uint32_t key, Job job, Completion completion = Completion());
+
+    // Finishes the running job, drops queued ones and joins the thread
+    void stop();
+
+    bool isWorkerThread() const { return std::this_thread::get_id() == thread_.get_id(); }
+    size_t pendingCount() const;
+
+    // Queueing statistics (time from post() until the job started)
+    uint64_t executedCount() const;
+    uint64_t coalescedCount() const;
+    uint64_t maxQueueDelayUs() const;
+    uint64_t averageQueueDelayUs() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry {
+        uint32_t key;
+        Job job;
+        std::vector<Completion> completions;
+        Clock::time_point postedAt;
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::deque<Entry> queue_;
+    bool stopping_;
+
+    uint64_t executed_;
+    uint64_t coalesced_;
+    uint64_t totalQueueDelayUs_;
+    uint64_t maxQueueDelayUs_;
+
+    std::thread thread_;  // Declared last: started after all other members exist
+
+    void run();
+};
+
+#endif // DEVICE_WORKER_HPP
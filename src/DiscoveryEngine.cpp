@@ -0,0 +1,317 @@
+#include "DiscoveryEngine.hpp"
+#include "RazerProtocol.hpp"
+#include "RazerReport.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+
+namespace {
+
+constexpr char MAGIC[8] = {'R', 'Z', 'D', 'I', 'S', 'C', '1', 0};
+constexpr uint32_t MAX_DEADLINE_US = 1000000;
+
+struct CheckpointHeader {
+    char magic[8];
+    uint16_t pid;
+    uint16_t recordSize;
+    uint32_t reserved;
+};
+static_assert(sizeof(CheckpointHeader) == 16, "Checkpoint header must stay 16 bytes on disk");
+
+// Short waits: most probes are refused at once, and a slow one is retried
+// later with a longer deadline instead of holding up the sweep
+ResponseWaitPolicy discoveryWaitPolicy() {
+    ResponseWaitPolicy policy;
+    policy.minInitialDelayUs = 1000;
+    policy.maxInitialDelayUs = 10000;
+    policy.firstBackoffUs = 500;
+    policy.maxBackoffUs = 5000;
+    return policy;
+}
+
+uint32_t deadlineFor(const DiscoveryOptions& options, uint32_t attempt) {
+    uint64_t deadline = (uint64_t)options.firstDeadlineUs << std::min(attempt, 16u);
+    return (uint32_t)std::min<uint64_t>(deadline, MAX_DEADLINE_US);
+}
+
+bool isKnownTransactionId(uint8_t transactionId) {
+    return transactionId == 0x1F || transactionId == 0x3F || transactionId == 0xFF;
+}
+
+} // namespace
+
+DiscoveryEngine::DiscoveryEngine()
+    : checkpoint_(nullptr),
+      waiter_(discoveryWaitPolicy()),
+      probes_(0),
+      resumed_(0) {
+}
+
+DiscoveryEngine::~DiscoveryEngine() {
+    closeCheckpoint();
+}
+
+bool DiscoveryEngine::openCheckpoint(const std::string& path, uint16_t pid) {
+    closeCheckpoint();
+
+    FILE* file = fopen(path.c_str(), "r+b");
+    if (file != nullptr) {
+        CheckpointHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 ||
+            std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+            header.recordSize != sizeof(DiscoveryRecord)) {
+            std::cerr << "Discovery: " << path << " is not a discovery checkpoint" << std::endl;
+            fclose(file);
+            return false;
+        }
+        if (header.pid != pid) {
+            std::cerr << "Discovery: " << path << " belongs to PID 0x" << std::hex << header.pid
+                      << std::dec << std::endl;
+            fclose(file);
+            return false;
+        }
+
+        DiscoveryRecord record;
+        long good = (long)sizeof(header);
+        while (fread(&record, sizeof(record), 1, file) == 1) {
+            remember(record);
+            resumed_++;
+            good += (long)sizeof(record);
+        }
+        // Cut a torn last record so new ones stay aligned
+        if (fseek(file, good, SEEK_SET) != 0) {
+            fclose(file);
+            return false;
+        }
+    } else {
+        file = fopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            std::cerr << "Discovery: cannot create " << path << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        CheckpointHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.pid = pid;
+        header.recordSize = sizeof(DiscoveryRecord);
+        if (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0) {
+            fclose(file);
+            return false;
+        }
+    }
+
+    checkpoint_ = file;
+    return true;
+}
+
+void DiscoveryEngine::closeCheckpoint() {
+    if (checkpoint_ != nullptr) {
+        fclose(checkpoint_);
+        checkpoint_ = nullptr;
+    }
+}
+
+const DiscoveryRecord* DiscoveryEngine::find(uint8_t kind, uint8_t transactionId, uint8_t cmdClass,
+                                             uint8_t cmdId) const {
+    auto it = done_.find(recordKey(kind, transactionId, cmdClass, cmdId));
+    return it != done_.end() ? &records_[it->second] : nullptr;
+}
+
+void DiscoveryEngine::remember(const DiscoveryRecord& record) {
+    done_[recordKey(record.kind, record.transactionId, record.cmdClass, record.cmdId)] = records_.size();
+    records_.push_back(record);
+}
+
+bool DiscoveryEngine::append(const DiscoveryRecord& record) {
+    remember(record);
+    if (progress_) {
+        progress_(record);
+    }
+    if (checkpoint_ == nullptr) {
+        return true;
+    }
+    if (fwrite(&record, sizeof(record), 1, checkpoint_) != 1 || fflush(checkpoint_) != 0) {
+        std::cerr << "Discovery: checkpoint write failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DiscoveryEngine::shouldStop(const DiscoveryOptions& options, const std::atomic<bool>* stop) const {
+    return (stop != nullptr && stop->load(std::memory_order_relaxed)) ||
+           (options.maxProbes != 0 && probes_ >= options.maxProbes);
+}
+
+bool DiscoveryEngine::probe(RazerTransport& transport, uint8_t kind, uint8_t transactionId, uint8_t cmdClass,
+                            uint8_t cmdId, uint32_t deadlineUs, DiscoveryRecord& record) {
+    RazerReport request = RazerProtocol::requestFor({cmdClass, cmdId, 0x00, 0x00});
+    request.setTransactionId(transactionId);
+
+    std::memset(&record, 0, sizeof(record));
+    record.kind = kind;
+    record.transactionId = transactionId;
+    record.cmdClass = cmdClass;
+    record.cmdId = cmdId;
+    record.status = DISCOVERY_NO_ANSWER;
+
+    probes_++;
+    auto start = std::chrono::steady_clock::now();
+    if (!transport.sendReport(request.data())) {
+        return false;
+    }
+
+    uint8_t response[RazerReportLayout::SIZE];
+    std::memset(response, 0, sizeof(response));
+    waiter_.setDeadlineUs(deadlineUs);
+    ResponseWaiter::Result result = waiter_.wait(
+        request.data(), response, sizeof(response),
+        [&transport](uint8_t* buffer, size_t bufferSize) { return transport.readResponse(buffer, bufferSize); });
+    record.latencyUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    if (result != ResponseWaiter::Result::Ready || !RazerProtocol::verifyChecksum(response)) {
+        return true;  // No answer this time
+    }
+    RazerResponseView view(response);
+    record.status = view.status();
+    record.dataSize = response[RazerReportLayout::DATA_SIZE];
+    for (size_t i = 0; i < RazerReportLayout::ARGS_SIZE; i++) {
+        if (view.arg(i) != 0x00) {
+            record.flags |= DISCOVERY_HAS_DATA;
+            break;
+        }
+    }
+    return true;
+}
+
+bool DiscoveryEngine::sweepTransactionIds(RazerTransport& transport, const DiscoveryOptions& options,
+                                          const std::atomic<bool>* stop, std::vector<uint8_t>& answering) {
+    answering.clear();
+    for (uint32_t transactionId = 0; transactionId <= 0xFF; transactionId++) {
+        const DiscoveryRecord* known = find(DISCOVERY_TRANSACTION, (uint8_t)transactionId,
+                                            options.probeClass, options.probeId);
+        DiscoveryRecord record;
+        if (known != nullptr) {
+            record = *known;
+        } else {
+            if (shouldStop(options, stop)) {
+                return false;
+            }
+            // One long attempt: a wrong ID is simply never answered
+            if (!probe(transport, DISCOVERY_TRANSACTION, (uint8_t)transactionId, options.probeClass,
+                       options.probeId, deadlineFor(options, options.maxAttempts - 1), record)) {
+                return false;
+            }
+            record.attempts = 1;
+            if (!append(record)) {
+                return false;
+            }
+        }
+        if (isDataStatus(record.status) || isUnsupportedStatus(record.status)) {
+            answering.push_back((uint8_t)transactionId);
+        }
+    }
+
+    if (answering.size() > options.maxTransactionIds) {
+        // Not a routing ID on this device: sweep the usual ones first
+        std::stable_sort(answering.begin(), answering.end(), [](uint8_t a, uint8_t b) {
+            return isKnownTransactionId(a) && !isKnownTransactionId(b);
+        });
+        answering.resize(options.maxTransactionIds);
+    }
+    return true;
+}
+
+bool DiscoveryEngine::sweepIds(RazerTransport& transport, const DiscoveryOptions& options,
+                               const std::atomic<bool>* stop, uint8_t transactionId, uint8_t cmdClass,
+                               uint32_t firstId, uint32_t lastId) {
+    // Retries go to the back: everything else in the range is probed before a
+    // busy command is asked again, with a longer deadline each time
+    struct Pending {
+        uint8_t cmdId;
+        uint8_t attempts;
+    };
+    std::deque<Pending> queue;
+    for (uint32_t id = firstId; id <= lastId; id++) {
+        if (find(DISCOVERY_COMMAND, transactionId, cmdClass, (uint8_t)id) == nullptr) {
+            queue.push_back({(uint8_t)id, 0});
+        }
+    }
+
+    while (!queue.empty()) {
+        if (shouldStop(options, stop)) {
+            return false;
+        }
+        Pending pending = queue.front();
+        queue.pop_front();
+
+        DiscoveryRecord record;
+        if (!probe(transport, DISCOVERY_COMMAND, transactionId, cmdClass, pending.cmdId,
+                   deadlineFor(options, pending.attempts), record)) {
+            return false;
+        }
+        pending.attempts++;
+        if (record.status == DISCOVERY_NO_ANSWER && pending.attempts < options.maxAttempts) {
+            queue.push_back(pending);
+            continue;
+        }
+        record.attempts = pending.attempts;
+        if (!append(record)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DiscoveryEngine::sweepClass(RazerTransport& transport, const DiscoveryOptions& options,
+                                 const std::atomic<bool>* stop, uint8_t transactionId, uint8_t cmdClass) {
+    if (find(DISCOVERY_SKIP_CLASS, transactionId, cmdClass, 0) != nullptr) {
+        return true;
+    }
+
+    uint32_t firstId = options.firstId;
+    uint32_t lastId = std::max(options.firstId, options.lastId);
+    uint32_t headLast = std::min(lastId, firstId + std::max(options.unsupportedSkip, 1u) - 1);
+    if (!sweepIds(transport, options, stop, transactionId, cmdClass, firstId, headLast)) {
+        return false;
+    }
+
+    // The first ids decide whether the class exists at all
+    if (options.unsupportedSkip != 0 && headLast < lastId) {
+        bool unsupported = true;
+        for (uint32_t id = firstId; id <= headLast && unsupported; id++) {
+            const DiscoveryRecord* record = find(DISCOVERY_COMMAND, transactionId, cmdClass, (uint8_t)id);
+            unsupported = record != nullptr && isUnsupportedStatus(record->status);
+        }
+        if (unsupported) {
+            DiscoveryRecord skip;
+            std::memset(&skip, 0, sizeof(skip));
+            skip.kind = DISCOVERY_SKIP_CLASS;
+            skip.transactionId = transactionId;
+            skip.cmdClass = cmdClass;
+            return append(skip);
+        }
+    }
+    return headLast >= lastId || sweepIds(transport, options, stop, transactionId, cmdClass, headLast + 1, lastId);
+}
+
+bool DiscoveryEngine::run(RazerTransport& transport, const DiscoveryOptions& options,
+                          const std::atomic<bool>* stop) {
+    probes_ = 0;
+    std::vector<uint8_t> transactionIds = options.transactionIds;
+    if (transactionIds.empty() && !sweepTransactionIds(transport, options, stop, transactionIds)) {
+        return false;
+    }
+
+    for (uint8_t transactionId : transactionIds) {
+        for (uint32_t cmdClass = options.firstClass; cmdClass <= options.lastClass; cmdClass++) {
+            if (!sweepClass(transport, options, stop, transactionId, (uint8_t)cmdClass)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+#ifndef DISCOVERY_ENGINE_HPP
+#define DISCOVERY_ENGINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "RazerTransport.hpp"
+#include "ResponseWaiter.hpp"
+
+enum DiscoveryRecordKind : uint8_t {
+    DISCOVERY_TRANSACTION = 1,  // Transaction ID probe (class/id = the probe command)
+    DISCOVERY_COMMAND = 2,      // One class/id under one transaction ID
+    DISCOVERY_SKIP_CLASS = 3    // Rest of a class skipped (not supported)
+};
+
+constexpr uint8_t DISCOVERY_HAS_DATA = 0x01;    // Some argument byte was non-zero
+constexpr uint8_t DISCOVERY_NO_ANSWER = 0xFF;   // status: read failed or still busy after every retry
+
+// Outcome of one probe; also the 12-byte checkpoint record on disk
+struct DiscoveryRecord {
+    uint8_t kind;           // DiscoveryRecordKind
+    uint8_t transactionId;
+    uint8_t cmdClass;
+    uint8_t cmdId;
+    uint8_t status;         // Status byte of the answer, DISCOVERY_NO_ANSWER if none
+    uint8_t dataSize;       // Data size the device answered with
+    uint8_t flags;          // DISCOVERY_HAS_DATA
+    uint8_t attempts;       // Sends it took (busy retries included)
+    uint32_t latencyUs;     // Send to answer of the last attempt
+};
+static_assert(sizeof(DiscoveryRecord) == 12, "Discovery record must stay 12 bytes on disk");
+
+// What to sweep and how patiently
+struct DiscoveryOptions {
+    uint8_t firstClass = 0x00;
+    uint8_t lastClass = 0xFF;
+    // Get commands only by default: ids below 0x80 are setters (device mode,
+    // DPI, lighting, ...) and would change the mouse while it is being probed
+    uint8_t firstId = 0x80;
+    uint8_t lastId = 0xFF;
+    // Transaction IDs to sweep under; empty = probe all 256 and keep those the
+    // device answers (probeClass/probeId must be a command it implements)
+    std::vector<uint8_t> transactionIds;
+    uint8_t probeClass = 0x00;          // Firmware version: implemented by every model
+    uint8_t probeId = 0x81;
+    uint32_t unsupportedSkip = 16;      // First N ids of a class all unsupported: skip the class
+    uint32_t maxAttempts = 4;           // Sends per command before it counts as no answer
+    uint32_t firstDeadlineUs = 20000;   // Wait for the first attempt; doubles per retry
+    uint32_t maxTransactionIds = 4;     // More answer: the device ignores the ID, sweep the first few
+    uint32_t maxProbes = 0;             // Stop after this many probes (0 = no limit)
+};
+
+// Sweeps the Razer command space of one device for the commands it answers.
+//
+// Replaces CommandScanner's fixed list and fixed sleeps. The transaction IDs
+// come first, then every class/id under each answering ID. Answers are awaited
+// with ResponseWaiter (learned turnaround, no fixed sleeps). A command still busy
+// at its short deadline is queued behind the rest of its class and retried with
+// a doubled deadline, so one slow command does not stall the sweep. A class whose
+// first ids all answer 0x05 (or 0x04, which these mice also use for "not
+// supported") is skipped.
+//
+// The device holds one report buffer, so probes on one device are strictly
+// serial; run one engine per device, each on its own thread, to sweep several
+// at once. Every finished probe is appended to the checkpoint file and flushed,
+// so an interrupted sweep resumes where it stopped.
+class DiscoveryEngine {
+public:
+    typedef std::function<void(const DiscoveryRecord& record)> ProgressHandler;
+
+    DiscoveryEngine();
+    ~DiscoveryEngine();
+
+    DiscoveryEngine(const DiscoveryEngine&) = delete;
+    DiscoveryEngine& operator=(const DiscoveryEngine&) = delete;
+
+    // Loads what an earlier run of the same PID recorded (if the file exists)
+    // and appends to it from now on. False if the file belongs to another PID
+    // or cannot be written.
+    bool openCheckpoint(const std::string& path, uint16_t pid);
+    void closeCheckpoint();
+
+    // Runs until the sweep is complete (true), stop is set, maxProbes is
+    // reached or the transport fails (false). Call again to continue.
+    bool run(RazerTransport& transport, const DiscoveryOptions& options,
+             const std::atomic<bool>* stop = nullptr);
+
+    // Called on the sweeping thread after every new probe
+    void setProgressHandler(ProgressHandler handler) { progress_ = handler; }
+
+    // Everything known so far, resumed records included
+    const std::vector<DiscoveryRecord>& records() const { return records_; }
+    uint64_t probesSent() const { return probes_; }
+    uint64_t resumedRecords() const { return resumed_; }
+
+    static bool isDataStatus(uint8_t status) { return status == 0x00 || status == 0x02; }
+    static bool isUnsupportedStatus(uint8_t status) { return status == 0x04 || status == 0x05; }
+
+private:
+    std::vector<DiscoveryRecord> records_;
+    std::unordered_map<uint32_t, size_t> done_;  // recordKey() -> index in records_
+    FILE* checkpoint_;
+    ResponseWaiter waiter_;
+    ProgressHandler progress_;
+    uint64_t probes_;
+    uint64_t resumed_;
+
+    static uint32_t recordKey(uint8_t kind, uint8_t transactionId, uint8_t cmdClass, uint8_t cmdId) {
+        return (uint32_t)kind << 24 | (uint32_t)transactionId << 16 | (uint32_t)cmdClass << 8 | cmdId;
+    }
+    const DiscoveryRecord* find(uint8_t kind, uint8_t transactionId, uint8_t cmdClass, uint8_t cmdId) const;
+    void remember(const DiscoveryRecord& record);
+    bool append(const DiscoveryRecord& record);
+
+    // One send + wait; false only if the transport failed to send
+    bool probe(RazerTransport& transport, uint8_t kind, uint8_t transactionId, uint8_t cmdClass,
+               uint8_t cmdId, uint32_t deadlineUs, DiscoveryRecord& record);
+    bool sweepTransactionIds(RazerTransport& transport, const DiscoveryOptions& options,
+                             const std::atomic<bool>* stop, std::vector<uint8_t>& answering);
+    bool sweepClass(RazerTransport& transport, const DiscoveryOptions& options,
+                    const std::atomic<bool>* stop, uint8_t transactionId, uint8_t cmdClass);
+    bool sweepIds(RazerTransport& transport, const DiscoveryOptions& options, const std::atomic<bool>* stop,
+                  uint8_t transactionId, uint8_t cmdClass, uint32_t firstId, uint32_t lastId);
+    bool shouldStop(const DiscoveryOptions& options, const std::atomic<bool>* stop) const;
+};
+
+#endif // DISCOVERY_ENGINE_HPP
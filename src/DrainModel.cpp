@@ -0,0 +1,80 @@
+#include "DrainModel.hpp"
+#include <algorithm>
+
+namespace {
+
+constexpr double MS_PER_HOUR = 3600000.0;
+constexpr double MIN_SLOPE = 0.01;  // %/h; anything flatter counts as "not moving"
+
+} // namespace
+
+DrainModel::DrainModel(size_t window)
+    : samples_(),
+      window_(std::min(std::max<size_t>(window, 1), CAPACITY)),
+      head_(0),
+      count_(0),
+      charging_(false) {
+}
+
+void DrainModel::reset() {
+    head_ = 0;
+    count_ = 0;
+}
+
+const BatterySample& DrainModel::sampleAt(size_t age) const {
+    return samples_[(head_ + window_ - 1 - age) % window_];
+}
+
+void DrainModel::add(const BatterySample& sample) {
+    if (count_ > 0 && sample.charging != charging_) {
+        reset();
+    }
+    charging_ = sample.charging;
+
+    samples_[head_] = sample;
+    head_ = (head_ + 1) % window_;
+    count_ = std::min(count_ + 1, window_);
+}
+
+double DrainModel::slopePercentPerHour() const {
+    if (count_ < 2) {
+        return 0.0;
+    }
+
+    // Times relative to the oldest sample keep the sums well conditioned
+    uint64_t origin = sampleAt(count_ - 1).timeMs;
+    double sumT = 0, sumP = 0, sumTT = 0, sumTP = 0;
+    for (size_t i = 0; i < count_; i++) {
+        const BatterySample& sample = sampleAt(i);
+        double hours = (double)(sample.timeMs - origin) / MS_PER_HOUR;
+        sumT += hours;
+        sumP += sample.percent;
+        sumTT += hours * hours;
+        sumTP += hours * sample.percent;
+    }
+
+    double n = (double)count_;
+    double denominator = n * sumTT - sumT * sumT;
+    if (denominator <= 0.0) {
+        return 0.0;
+    }
+    return (n * sumTP - sumT * sumP) / denominator;
+}
+
+bool DrainModel::timeToEmptyMs(uint64_t& ms) const {
+    double slope = slopePercentPerHour();
+    if (count_ < 2 || charging_ || slope > -MIN_SLOPE) {
+        return false;
+    }
+    ms = (uint64_t)(latest().percent / -slope * MS_PER_HOUR);
+    return true;
+}
+
+bool DrainModel::timeToFullMs(uint64_t& ms) const {
+    double slope = slopePercentPerHour();
+    if (count_ < 2 || !charging_ || slope < MIN_SLOPE) {
+        return false;
+    }
+    ms = (uint64_t)((100 - std::min<int>(latest().percent, 100)) / slope * MS_PER_HOUR);
+    return true;
+}
@@ -0,0 +1,53 @@
+#ifndef DRAIN_MODEL_HPP
+#define DRAIN_MODEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// One battery reading as recorded by the device worker
+struct BatterySample {
+    uint64_t timeMs = 0;        // Wall clock (Unix ms), so samples stay comparable across restarts
+    uint32_t latencyUs = 0;     // Wall time of the query batch that produced it
+    uint8_t percent = 0;
+    uint8_t transactionId = 0;  // Transaction ID the device answered on
+    bool charging = false;
+};
+
+// Least-squares battery slope over the most recent samples of one charging
+// state, with time-to-empty / time-to-full estimates on top.
+//
+// Fixed inline storage: add() never allocates, so the model can run for weeks
+// at constant memory. A charging flip starts a fresh window, since the slope of
+// the other direction says nothing about this one.
+class DrainModel {
+public:
+    static constexpr size_t CAPACITY = 32;
+
+    // window: how many recent samples to fit (1..CAPACITY)
+    explicit DrainModel(size_t window = CAPACITY);
+
+    void add(const BatterySample& sample);
+    void reset();
+
+    // Fitted slope in percent per hour (negative while discharging), 0 if unknown
+    double slopePercentPerHour() const;
+
+    // Estimated time until 0% (discharging) / 100% (charging); false if unknown
+    bool timeToEmptyMs(uint64_t& ms) const;
+    bool timeToFullMs(uint64_t& ms) const;
+
+    size_t count() const { return count_; }
+    bool charging() const { return charging_; }
+    const BatterySample& latest() const { return sampleAt(0); }  // Requires count() > 0
+
+private:
+    BatterySample samples_[CAPACITY];
+    size_t window_;
+    size_t head_;    // Next slot to write
+    size_t count_;
+    bool charging_;
+
+    const BatterySample& sampleAt(size_t age) const;  // 0 = newest
+};
+
+#endif // DRAIN_MODEL_HPP
@@ -0,0 +1,219 @@
+/**
+ * HidrawDevices.cpp - Razer hidraw nodes from sysfs, USB hotplug from uevents
+ *
+ * /sys/class/hidraw/hidrawN/device resolves to the HID device
+ * (.../usb1/1-2/1-2:1.2/0003:1532:00A6.0003), whose uevent carries
+ * HID_ID=bus:vendor:product. Its parent is the USB interface
+ * (bInterfaceNumber), and the interface's parent is the USB device (serial,
+ * and the port path in its name).
+ */
+
+#include "HidrawDevices.hpp"
+#include "RazerDeviceTable.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+
+namespace {
+
+constexpr unsigned BUS_USB_ID = 0x03;  // BUS_USB in linux/input.h
+
+// Whole (small) sysfs attribute, trailing newline removed
+bool readAttribute(const std::string& path, std::string& value) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return false;
+    }
+    char buffer[4096];
+    size_t length = fread(buffer, 1, sizeof(buffer) - 1, file);
+    fclose(file);
+    while (length > 0 && (buffer[length - 1] == '\n' || buffer[length - 1] == '\r')) {
+        length--;
+    }
+    value.assign(buffer, length);
+    return true;
+}
+
+std::string resolvePath(const std::string& path) {
+    char* resolved = realpath(path.c_str(), nullptr);
+    if (resolved == nullptr) {
+        return std::string();
+    }
+    std::string result = resolved;
+    free(resolved);
+    return result;
+}
+
+std::string parentOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos || slash == 0 ? std::string() : path.substr(0, slash);
+}
+
+std::string nameOf(const std::string& path) {
+    size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// Value of a KEY=value line of a uevent file (the whole file in text)
+bool ueventValue(const std::string& text, const char* key, std::string& value) {
+    size_t keyLength = strlen(key);
+    for (size_t start = 0; start < text.size(); ) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        if (end - start > keyLength && text.compare(start, keyLength, key) == 0 && text[start + keyLength] == '=') {
+            value = text.substr(start + keyLength + 1, end - start - keyLength - 1);
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+// Value of a KEY=value field of a uevent datagram, nullptr if this is another key
+const char* fieldValue(const char* field, const char* key) {
+    size_t keyLength = strlen(key);
+    return strncmp(field, key, keyLength) == 0 && field[keyLength] == '=' ? field + keyLength + 1 : nullptr;
+}
+
+} // namespace
+
+void HidrawDevices::list(std::vector<HidrawNode>& nodes, const std::string& sysRoot, const std::string& devRoot) {
+    nodes.clear();
+
+    std::string classDir = sysRoot + "/class/hidraw";
+    DIR* dir = opendir(classDir.c_str());
+    if (dir == nullptr) {
+        return;  // No hidraw driver loaded, or not Linux
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strncmp(entry->d_name, "hidraw", 6) != 0) {
+            continue;
+        }
+        std::string hidDevice = resolvePath(classDir + "/" + entry->d_name + "/device");
+        std::string uevent;
+        std::string hidId;
+        if (hidDevice.empty() || !readAttribute(hidDevice + "/uevent", uevent) ||
+            !ueventValue(uevent, "HID_ID", hidId)) {
+            continue;
+        }
+        unsigned bus = 0;
+        unsigned vendor = 0;
+        unsigned product = 0;
+        if (sscanf(hidId.c_str(), "%x:%x:%x", &bus, &vendor, &product) != 3 || bus != BUS_USB_ID ||
+            vendor != RazerDeviceTable::VENDOR_ID || product > 0xFFFF) {
+            continue;  // Bluetooth, I2C or another vendor
+        }
+
+        // HID device -> USB interface -> USB device
+        std::string usbInterface = parentOf(hidDevice);
+        std::string usbDevice = parentOf(usbInterface);
+        std::string interfaceNumber;
+        if (!readAttribute(usbInterface + "/bInterfaceNumber", interfaceNumber)) {
+            continue;
+        }
+
+        HidrawNode node;
+        node.devNode = devRoot + "/" + entry->d_name;
+        node.pid = (uint16_t)product;
+        node.locationId = locationId(nameOf(usbDevice).c_str());
+        node.interfaceNumber = (uint8_t)strtoul(interfaceNumber.c_str(), nullptr, 16);
+        readAttribute(usbDevice + "/serial", node.serial);  // Dongles often have none
+        nodes.push_back(node);
+    }
+    closedir(dir);
+
+    // readdir() order is arbitrary; keep one device's interfaces together
+    std::sort(nodes.begin(), nodes.end(), [](const HidrawNode& a, const HidrawNode& b) {
+        if (a.locationId != b.locationId) {
+            return a.locationId < b.locationId;
+        }
+        return a.interfaceNumber < b.interfaceNumber;
+    });
+}
+
+uint32_t HidrawDevices::locationId(const char* usbName) {
+    char* end = nullptr;
+    unsigned long bus = strtoul(usbName, &end, 10);
+    if (end == usbName || *end != '-' || bus > 0xFF) {
+        return 0;  // Root hub ("usb1") or not a USB device name
+    }
+
+    // Bus in the top byte, then one nibble per port, outermost first
+    uint32_t location = (uint32_t)bus << 24;
+    int shift = 20;
+    const char* port = end + 1;
+    for (;;) {
+        unsigned long number = strtoul(port, &end, 10);
+        if (end == port || number == 0 || number > 0xF || shift < 0) {
+            return 0;
+        }
+        location |= (uint32_t)number << shift;
+        shift -= 4;
+        if (*end == '\0') {
+            return location;
+        }
+        if (*end != '.') {
+            return 0;  // "1-2:1.2" is an interface of 1-2
+        }
+        port = end + 1;
+    }
+}
+
+bool HidrawDevices::parseUevent(const char* message, size_t length, DeviceEvent& event) {
+    // Kernel datagrams are "ACTION@DEVPATH" and NUL-terminated KEY=value
+    // fields; udev's own start with "libudev" and carry no '@' header
+    if (length == 0 || message[length - 1] != '\0' || strchr(message, '@') == nullptr) {
+        return false;
+    }
+
+    const char* action = nullptr;
+    const char* devPath = nullptr;
+    const char* subsystem = nullptr;
+    const char* devType = nullptr;
+    const char* product = nullptr;
+    const char* end = message + length;
+    for (const char* field = message + strlen(message) + 1; field < end; field += strlen(field) + 1) {
+        const char* value;
+        if ((value = fieldValue(field, "ACTION")) != nullptr) {
+            action = value;
+        } else if ((value = fieldValue(field, "DEVPATH")) != nullptr) {
+            devPath = value;
+        } else if ((value = fieldValue(field, "SUBSYSTEM")) != nullptr) {
+            subsystem = value;
+        } else if ((value = fieldValue(field, "DEVTYPE")) != nullptr) {
+            devType = value;
+        } else if ((value = fieldValue(field, "PRODUCT")) != nullptr) {
+            product = value;
+        }
+    }
+
+    // Whole USB devices only, like IOKit's IOUSBDevice matching: one event per plug
+    if (action == nullptr || devPath == nullptr || product == nullptr || subsystem == nullptr ||
+        devType == nullptr || strcmp(subsystem, "usb") != 0 || strcmp(devType, "usb_device") != 0) {
+        return false;
+    }
+    bool added = strcmp(action, "add") == 0;
+    if (!added && strcmp(action, "remove") != 0) {
+        return false;  // bind, change, ...
+    }
+
+    // PRODUCT=1532/a6/200: vendor/product/bcdDevice in hex. Still there on
+    // remove, when sysfs no longer is.
+    unsigned vendor = 0;
+    unsigned pid = 0;
+    if (sscanf(product, "%x/%x", &vendor, &pid) != 2 || vendor != RazerDeviceTable::VENDOR_ID || pid > 0xFFFF) {
+        return false;
+    }
+    const char* name = strrchr(devPath, '/');
+
+    event.added = added;
+    event.pid = (uint16_t)pid;
+    event.locationId = locationId(name != nullptr ? name + 1 : devPath);
+    return true;
+}
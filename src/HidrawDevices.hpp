@@ -0,0 +1,42 @@
+#ifndef HIDRAW_DEVICES_HPP
+#define HIDRAW_DEVICES_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DeviceEvents.hpp"
+
+// One hidraw node of a Razer USB device, as sysfs describes it
+struct HidrawNode {
+    std::string devNode;      // /dev/hidrawN
+    uint16_t pid;
+    uint32_t locationId;      // Same encoding as IOKit's USB location ID
+    uint8_t interfaceNumber;  // USB interface the HID device sits on
+    std::string serial;       // Empty when the device reports none
+};
+
+// Linux device lookup without libudev: sysfs for what is attached, kernel
+// uevents for what changes.
+//
+// Both roots are parameters so a fake tree (plain directories, files and
+// symlinks laid out like /sys/class/hidraw and /sys/devices) stands in for
+// the real one in tests.
+class HidrawDevices {
+public:
+    // Every hidraw node of a Razer (VID 0x1532) USB device, whatever the PID
+    static void list(std::vector<HidrawNode>& nodes, const std::string& sysRoot = "/sys",
+                     const std::string& devRoot = "/dev");
+
+    // USB device name as sysfs spells it ("1-2.3": bus 1, port 2, port 3) to the
+    // macOS location ID layout (0x01230000), so the two backends key devices
+    // alike. 0 if the name is not a USB device.
+    static uint32_t locationId(const char* usbName);
+
+    // One kernel uevent datagram ("add@/devices/...\0ACTION=add\0...") about a
+    // USB device of VID 0x1532. False for anything else (interfaces, hidraw
+    // nodes, other vendors, udev's re-broadcasts), which callers skip.
+    static bool parseUevent(const char* message, size_t length, DeviceEvent& event);
+};
+
+#endif // HIDRAW_DEVICES_HPP
@@ -0,0 +1,135 @@
+/**
+ * HidrawTransport.cpp - Razer feature reports over Linux hidraw
+ *
+ * HIDIOCSFEATURE / HIDIOCGFEATURE take the report ID in byte 0, so a
+ * transfer is 91 bytes: 0x00 and the 90-byte report. The HID core turns them
+ * into SET_REPORT / GET_REPORT (feature, ID 0) control transfers, the same
+ * requests IOKitTransport issues by hand.
+ *
+ * Event reports arrive as input reports: read() on the node.
+ */
+
+#include "HidrawTransport.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <linux/hidraw.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+HidrawTransport::HidrawTransport(IoctlFunction ioctlFunction)
+    : fd_(-1),
+      ioctl_(ioctlFunction != nullptr ? ioctlFunction : systemIoctl),
+      stopFd_(-1) {
+}
+
+HidrawTransport::~HidrawTransport() {
+    stopEvents();
+}
+
+int HidrawTransport::systemIoctl(int fd, unsigned long request, void* argument) {
+    return ioctl(fd, request, argument);
+}
+
+bool HidrawTransport::sendReport(const uint8_t* report) {
+    if (fd_ < 0) {
+        return false;
+    }
+
+    uint8_t buffer[1 + REPORT_SIZE];
+    buffer[0] = 0x00;  // Report ID 0
+    std::memcpy(buffer + 1, report, REPORT_SIZE);
+    if (ioctl_(fd_, HIDIOCSFEATURE(sizeof(buffer)), buffer) < 0) {
+        std::cerr << "Failed to send report: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool HidrawTransport::readResponse(uint8_t* buffer, size_t bufferSize) {
+    if (fd_ < 0 || bufferSize < REPORT_SIZE) {
+        return false;
+    }
+
+    uint8_t response[1 + REPORT_SIZE];
+    response[0] = 0x00;  // Report ID to fetch
+    int length = ioctl_(fd_, HIDIOCGFEATURE(sizeof(response)), response);
+    if (length < 0) {
+        std::cerr << "Failed to read response: " << strerror(errno) << std::endl;
+        return false;
+    }
+    if ((size_t)length < sizeof(response)) {
+        std::cerr << "Short response: " << length << " bytes" << std::endl;
+        return false;
+    }
+    std::memcpy(buffer, response + 1, REPORT_SIZE);
+    return true;
+}
+
+bool HidrawTransport::startEvents(RazerEventSink* sink) {
+    stopEvents();
+    if (fd_ < 0 || sink == nullptr) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(eventMutex_);
+    stopFd_ = eventfd(0, EFD_CLOEXEC);
+    if (stopFd_ < 0) {
+        std::cerr << "Failed to create event stop descriptor: " << strerror(errno) << std::endl;
+        return false;
+    }
+    eventThread_ = std::thread(&HidrawTransport::readEvents, this, fd_, sink);
+    return true;
+}
+
+void HidrawTransport::stopEvents() {
+    std::lock_guard<std::mutex> lock(eventMutex_);
+    if (!eventThread_.joinable()) {
+        return;
+    }
+    uint64_t one = 1;
+    if (write(stopFd_, &one, sizeof(one)) != (ssize_t)sizeof(one)) {
+        std::cerr << "Failed to stop the event reader: " << strerror(errno) << std::endl;
+    }
+    eventThread_.join();  // Once this returns the sink is no longer called
+    close(stopFd_);
+    stopFd_ = -1;
+}
+
+void HidrawTransport::readEvents(int fd, RazerEventSink* sink) {
+    pollfd descriptors[2];
+    descriptors[0].fd = fd;
+    descriptors[0].events = POLLIN;
+    descriptors[1].fd = stopFd_;
+    descriptors[1].events = POLLIN;
+
+    uint8_t report[EVENT_BUFFER_SIZE];
+    for (;;) {
+        descriptors[0].revents = 0;
+        descriptors[1].revents = 0;
+        if (poll(descriptors, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (descriptors[1].revents != 0) {
+            return;  // stopEvents()
+        }
+        ssize_t length = read(fd, report, sizeof(report));
+        if (length < 0 && (errno == EINTR || errno == EAGAIN)) {
+            continue;
+        }
+        if (length == 0) {
+            errno = ENODEV;  // End of file: the node went away
+        }
+        if (length <= 0) {
+            break;
+        }
+        sink->onEventReport(report, (size_t)length);
+    }
+    // Device gone: polling carries on without events
+    std::cerr << "Event reports stopped: " << strerror(errno) << std::endl;
+}
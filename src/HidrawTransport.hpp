@@ -0,0 +1,58 @@
+#ifndef HIDRAW_TRANSPORT_HPP
+#define HIDRAW_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "RazerTransport.hpp"
+
+// RazerTransport over a Linux hidraw node (interface 2 of the device): the
+// 90-byte report goes out with HIDIOCSFEATURE and comes back with
+// HIDIOCGFEATURE, behind report ID 0. The descriptor is owned by RazerDevice;
+// this class only borrows it. The kernel addresses those requests to the
+// node's own interface, where IOKitTransport sends wIndex 0.
+//
+// hidraw has no per-request timeout or abort: the HID core gives up on a
+// control request after its own 5 s, which WatchdogTransport then counts as a
+// timeout.
+//
+// Events: a reader thread poll()s the node and passes every input report to
+// the sink, so on Linux the sink runs on that thread. stopEvents() before the
+// descriptor is closed.
+class HidrawTransport : public RazerTransport {
+public:
+    // The feature report ioctls go through this; tests route them to a fake
+    typedef int (*IoctlFunction)(int fd, unsigned long request, void* argument);
+
+    explicit HidrawTransport(IoctlFunction ioctlFunction = nullptr);
+    ~HidrawTransport();
+
+    HidrawTransport(const HidrawTransport&) = delete;
+    HidrawTransport& operator=(const HidrawTransport&) = delete;
+
+    void setDevice(int fd) { fd_ = fd; }
+
+    bool sendReport(const uint8_t* report) override;
+    bool readResponse(uint8_t* buffer, size_t bufferSize) override;
+    bool isOpen() const override { return fd_ >= 0; }
+    bool startEvents(RazerEventSink* sink) override;
+    void stopEvents() override;
+
+private:
+    static constexpr size_t REPORT_SIZE = 90;
+    static constexpr size_t EVENT_BUFFER_SIZE = 64;  // Largest input report expected
+
+    int fd_;
+    IoctlFunction ioctl_;
+
+    // Reader thread, started and stopped from the worker
+    std::mutex eventMutex_;
+    std::thread eventThread_;
+    int stopFd_;  // eventfd that wakes the reader for stopEvents()
+
+    void readEvents(int fd, RazerEventSink* sink);
+    static int systemIoctl(int fd, unsigned long request, void* argument);
+};
+
+#endif // HIDRAW_TRANSPORT_HPP
@@ -0,0 +1,253 @@
+#include "HistoryLog.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'R', 'Z', 'H', 'I', 'S', 'T', '0', '1'};
+constexpr uint32_t VERSION = 2;
+constexpr uint32_t VERSION_LINEAR = 1;  // No ring yet: start always 0
+
+} // namespace
+
+struct HistoryLog::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint32_t capacity;
+    uint32_t start;        // Slot of the oldest record (reserved, so 0, in version 1)
+    uint64_t count;        // Records committed; written after each record
+    uint8_t padding[32];
+};
+
+HistoryLog::HistoryLog()
+    : fd_(-1),
+      base_(nullptr),
+      mappedSize_(0),
+      capacity_(0),
+      start_(0),
+      count_(0) {
+}
+
+HistoryLog::~HistoryLog() {
+    close();
+}
+
+HistoryLog::Header* HistoryLog::header() const {
+    static_assert(sizeof(Header) == 64, "History header must stay 64 bytes on disk");
+    return static_cast<Header*>(base_);
+}
+
+HistoryRecord* HistoryLog::records() const {
+    return reinterpret_cast<HistoryRecord*>(static_cast<uint8_t*>(base_) + sizeof(Header));
+}
+
+HistoryRecord& HistoryLog::slot(size_t index) const {
+    return records()[(start_ + index) % capacity_];
+}
+
+uint8_t HistoryLog::checksum(const HistoryRecord& record) {
+    // Rotate-xor over everything but the check byte, seeded so all-zero never matches
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&record);
+    uint8_t sum = 0xA5;
+    for (size_t i = 0; i < offsetof(HistoryRecord, check); i++) {
+        sum = (uint8_t)((sum << 1 | sum >> 7) ^ bytes[i]);
+    }
+    return sum;
+}
+
+bool HistoryLog::isValid(const HistoryRecord& record) {
+    return (record.flags & HISTORY_FLAG_VALID) != 0 && record.check == checksum(record);
+}
+
+HistoryRecord HistoryLog::makeRecord(const BatterySample& sample) {
+    HistoryRecord record;
+    std::memset(&record, 0, sizeof(record));
+    record.wallMs = sample.timeMs;
+    record.latencyUs = sample.latencyUs;
+    record.percent = sample.percent;
+    record.flags = HISTORY_FLAG_VALID | (sample.charging ? HISTORY_FLAG_CHARGING : 0);
+    record.transactionId = sample.transactionId;
+    record.check = checksum(record);
+    return record;
+}
+
+bool HistoryLog::mapFile(uint32_t capacity, bool initialize) {
+    mappedSize_ = sizeof(Header) + (size_t)capacity * sizeof(HistoryRecord);
+    if (initialize && ftruncate(fd_, 0) != 0) {
+        return false;
+    }
+    // Sparse file: untouched record pages take no disk space
+    if (ftruncate(fd_, (off_t)mappedSize_) != 0) {
+        std::cerr << "History: cannot size file" << std::endl;
+        return false;
+    }
+
+    void* base = mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (base == MAP_FAILED) {
+        std::cerr << "History: mmap failed" << std::endl;
+        return false;
+    }
+    base_ = base;
+    capacity_ = capacity;
+
+    if (initialize) {
+        Header* h = header();
+        std::memset(h, 0, sizeof(Header));
+        std::memcpy(h->magic, MAGIC, sizeof(MAGIC));
+        h->version = VERSION;
+        h->recordSize = sizeof(HistoryRecord);
+        h->capacity = capacity;
+        h->start = 0;
+        h->count = 0;
+    }
+    return true;
+}
+
+bool HistoryLog::open(const std::string& path, uint32_t capacity) {
+    close();
+    if (capacity < 2 || capacity > MAX_CAPACITY) {
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        std::cerr << "History: cannot open " << path << std::endl;
+        return false;
+    }
+
+    // Reuse an existing file only if it is ours and intact: a corrupt header
+    // must not resize the file (the capacity is checked against its real size)
+    Header existing;
+    std::memset(&existing, 0, sizeof(existing));
+    struct stat info;
+    bool reuse = pread(fd_, &existing, sizeof(existing), 0) == (ssize_t)sizeof(existing) &&
+                 std::memcmp(existing.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+                 (existing.version == VERSION || existing.version == VERSION_LINEAR) &&
+                 existing.recordSize == sizeof(HistoryRecord) &&
+                 existing.capacity >= 2 && existing.capacity <= MAX_CAPACITY &&
+                 existing.start < existing.capacity &&
+                 fstat(fd_, &info) == 0 &&
+                 (uint64_t)info.st_size == sizeof(Header) + (uint64_t)existing.capacity * sizeof(HistoryRecord);
+
+    if (!mapFile(reuse ? existing.capacity : capacity, !reuse)) {
+        close();
+        return false;
+    }
+
+    if (reuse) {
+        header()->version = VERSION;  // Version 1 is the ring with start 0
+        start_ = header()->start;
+        count_ = (size_t)std::min<uint64_t>(header()->count, capacity_);
+        recoverTail();
+    }
+    return true;
+}
+
+void HistoryLog::close() {
+    if (base_ != nullptr) {
+        munmap(base_, mappedSize_);
+        base_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    mappedSize_ = 0;
+    capacity_ = 0;
+    start_ = 0;
+    count_ = 0;
+}
+
+void HistoryLog::recoverTail() {
+    size_t before = count_;
+    size_t beforeStart = start_;
+
+    // Oldest slot cleared for a wrap whose header update never landed: drop it
+    while (count_ > 0 && !isValid(slot(0))) {
+        start_ = (start_ + 1) % capacity_;
+        count_--;
+    }
+    // Count was committed but the record behind it is torn: drop it
+    while (count_ > 0 && !isValid(slot(count_ - 1))) {
+        count_--;
+    }
+    // Records written after the last header update (crash in between): keep them
+    while (count_ < capacity_ && isValid(slot(count_))) {
+        count_++;
+    }
+
+    if (count_ != before || start_ != beforeStart) {
+        std::cerr << "History: recovered tail (" << before << " -> " << count_ << " records)" << std::endl;
+        commitCount();
+    }
+}
+
+void HistoryLog::commitCount() {
+    // Plain stores into the shared mapping; the kernel writes them back with the
+    // record. Kept after the record stores, which a crash must never trail.
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    header()->start = (uint32_t)start_;
+    header()->count = count_;
+}
+
+bool HistoryLog::append(const HistoryRecord& record) {
+    if (!isOpen()) {
+        return false;
+    }
+
+    if (count_ == capacity_) {
+        // Full: drop the oldest. Its slot is cleared before the header stops
+        // counting it, so recovery can never read it back as the newest record.
+        std::memset(&slot(0), 0, sizeof(HistoryRecord));
+        start_ = (start_ + 1) % capacity_;
+        count_--;
+        commitCount();
+    }
+
+    slot(count_) = record;
+    count_++;
+    commitCount();
+    return true;
+}
+
+bool HistoryLog::recordAt(size_t index, HistoryRecord& record) const {
+    if (!isOpen() || index >= count_) {
+        return false;
+    }
+    record = slot(index);
+    return true;
+}
+
+bool HistoryLog::latest(HistoryRecord& record) const {
+    return count_ > 0 && recordAt(count_ - 1, record);
+}
+
+size_t HistoryLog::replay(DrainModel& model) const {
+    if (!isOpen() || count_ == 0) {
+        return 0;
+    }
+
+    size_t first = count_ > DrainModel::CAPACITY ? count_ - DrainModel::CAPACITY : 0;
+    size_t fed = 0;
+    for (size_t i = first; i < count_; i++) {
+        const HistoryRecord& record = slot(i);
+
+        BatterySample sample;
+        sample.timeMs = record.wallMs;
+        sample.latencyUs = record.latencyUs;
+        sample.percent = record.percent;
+        sample.transactionId = record.transactionId;
+        sample.charging = (record.flags & HISTORY_FLAG_CHARGING) != 0;
+        model.add(sample);
+        fed++;
+    }
+    return fed;
+}
@@ -0,0 +1,87 @@
+#ifndef HISTORY_LOG_HPP
+#define HISTORY_LOG_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "DrainModel.hpp"
+
+// One persisted battery reading (16 bytes, little endian as laid out in memory)
+struct HistoryRecord {
+    uint64_t wallMs;          // Wall clock (Unix ms) - survives restarts, unlike monotonic time
+    uint32_t latencyUs;
+    uint8_t percent;
+    uint8_t flags;            // HISTORY_FLAG_*
+    uint8_t transactionId;
+    uint8_t check;            // Record checksum, see HistoryLog::checksum
+};
+static_assert(sizeof(HistoryRecord) == 16, "HistoryRecord must stay 16 bytes on disk");
+
+constexpr uint8_t HISTORY_FLAG_VALID = 0x80;    // Always set: an all-zero record is never valid
+constexpr uint8_t HISTORY_FLAG_CHARGING = 0x01;
+
+// Append-only, fixed-record battery history in an mmap'd file.
+//
+// Layout: a 64-byte header (magic, version, capacity, start, committed count)
+// followed by `capacity` 16-byte records used as a ring: record i lives in
+// slot (start + i) % capacity. Appending is a store into the mapping plus a
+// header update, so it costs no syscall. The header is written after the
+// record; on open both ends are re-validated from it (torn records dropped,
+// records written after the last header update recovered), which keeps
+// recovery O(1) instead of scanning the file. When full, each append drops
+// the oldest record: its slot is cleared and start advanced before the new
+// record goes in, so a crash at any point leaves a log that reads back in
+// order. (A crash is the process dying; the page cache keeps every store.)
+//
+// 16 bytes per record: a year of adaptive-rate polling (~100 samples a day) is
+// well under 1 MB; the default 256K-record capacity (4 MB) covers fixed 30 s
+// polling for three months.
+class HistoryLog {
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY = 262144;
+    static constexpr uint32_t MAX_CAPACITY = 16 * DEFAULT_CAPACITY;  // 64 MB; larger headers are corrupt
+
+    HistoryLog();
+    ~HistoryLog();
+
+    HistoryLog(const HistoryLog&) = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+
+    // Creates the file if needed; an unreadable or foreign file is recreated
+    bool open(const std::string& path, uint32_t capacity = DEFAULT_CAPACITY);
+    void close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    bool append(const HistoryRecord& record);
+
+    size_t count() const { return count_; }
+    bool recordAt(size_t index, HistoryRecord& record) const;
+    bool latest(HistoryRecord& record) const;
+
+    // Loads the newest records into model (sample times are wall ms, as
+    // recorded). Returns how many samples were fed.
+    size_t replay(DrainModel& model) const;
+
+    static HistoryRecord makeRecord(const BatterySample& sample);
+    static uint8_t checksum(const HistoryRecord& record);
+    static bool isValid(const HistoryRecord& record);
+
+private:
+    struct Header;
+
+    int fd_;
+    void* base_;
+    size_t mappedSize_;
+    uint32_t capacity_;
+    size_t start_;   // Slot of the oldest record
+    size_t count_;
+
+    Header* header() const;
+    HistoryRecord* records() const;
+    bool mapFile(uint32_t capacity, bool initialize);
+    void recoverTail();
+    HistoryRecord& slot(size_t index) const;  // Record index, oldest first
+    void commitCount();
+};
+
+#endif // HISTORY_LOG_HPP
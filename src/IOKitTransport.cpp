@@ -0,0 +1,183 @@
+/**
+ * IOKitTransport.cpp - Razer feature reports over IOKit control transfers
+ * 
+ * USB Control Transfer Parameters:
+ * - bmRequestType: 0x21 (SET) / 0xA1 (GET)
+ * - bRequest: 0x09 (SET_REPORT) / 0x01 (GET_REPORT)
+ * - wValue: 0x0300 (Feature Report, ID 0)
+ * - wIndex: 0x00 (protocol index for mice)
+ * - wLength: 90 bytes
+ * - Timeouts: noDataTimeout / completionTimeout from setTransferTimeoutMs()
+ *
+ * Event reports arrive on the interface's interrupt IN pipe (ReadPipeAsync).
+ */
+
+#include "IOKitTransport.hpp"
+#include <algorithm>
+#include <iostream>
+
+bool IOKitTransport::controlRequest(UInt8 requestType, UInt8 request, void* data, const char* what) {
+    // NOTE: wIndex = 0x00 for mice (per librazermacos), NOT the interface number!
+    IOUSBDevRequestTO transfer;
+    transfer.bmRequestType = requestType;
+    transfer.bRequest = request;
+    transfer.wValue = 0x0300;  // Feature Report, Report ID 0
+    transfer.wIndex = 0x00;  // Protocol index for mice (librazermacos default)
+    transfer.wLength = REPORT_SIZE;  // 90 bytes
+    transfer.pData = data;
+    transfer.wLenDone = 0;
+    // A wedged receiver fails the request here instead of blocking the worker
+    transfer.noDataTimeout = timeoutMs_;
+    transfer.completionTimeout = timeoutMs_;
+    
+    IOReturn kr = (*usbInterface_)->ControlRequestTO(usbInterface_, 0, &transfer);
+    
+    if (kr != kIOReturnSuccess) {
+        std::cerr << "Failed to " << what << ": 0x" << std::hex << kr << std::dec
+                  << (kr == kIOUSBTransactionTimeout ? " (timed out)" : "") << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool IOKitTransport::sendReport(const uint8_t* report) {
+    if (usbInterface_ == nullptr) {
+        return false;
+    }
+    
+    // USB Control Transfer - SET_REPORT via Interface
+    return controlRequest(USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_OUT,  // 0x21
+                          HID_REQ_SET_REPORT,  // 0x09
+                          (void*)report, "send report");
+}
+
+bool IOKitTransport::readResponse(uint8_t* buffer, size_t bufferSize) {
+    if (usbInterface_ == nullptr || bufferSize < REPORT_SIZE) {
+        return false;
+    }
+    
+    // USB Control Transfer - GET_REPORT via Interface
+    return controlRequest(USB_TYPE_CLASS | USB_RECIP_INTERFACE | USB_DIR_IN,  // 0xA1
+                          HID_REQ_GET_REPORT,  // 0x01
+                          buffer, "read response");
+}
+
+void IOKitTransport::abortTransfer() {
+    // Watchdog thread; the interface cannot go away while a transfer is watched
+    IOUSBInterfaceInterface182** interface = usbInterface_;
+    if (interface != nullptr) {
+        (*interface)->AbortPipe(interface, 0);  // Pipe 0: the default control pipe
+    }
+}
+
+UInt8 IOKitTransport::findInterruptInPipe() const {
+    UInt8 endpoints = 0;
+    if ((*usbInterface_)->GetNumEndpoints(usbInterface_, &endpoints) != kIOReturnSuccess) {
+        return 0;
+    }
+    // Pipe 0 is the default control pipe; endpoints are numbered from 1
+    for (UInt8 pipe = 1; pipe <= endpoints; pipe++) {
+        UInt8 direction = 0;
+        UInt8 number = 0;
+        UInt8 transferType = 0;
+        UInt16 maxPacketSize = 0;
+        UInt8 interval = 0;
+        IOReturn kr = (*usbInterface_)->GetPipeProperties(usbInterface_, pipe, &direction, &number,
+                                                         &transferType, &maxPacketSize, &interval);
+        if (kr == kIOReturnSuccess && direction == kUSBIn && transferType == kUSBInterrupt) {
+            return pipe;
+        }
+    }
+    return 0;
+}
+
+bool IOKitTransport::startEvents(RazerEventSink* sink) {
+    stopEvents();
+    if (usbInterface_ == nullptr || sink == nullptr) {
+        return false;
+    }
+
+    UInt8 pipe = findInterruptInPipe();
+    if (pipe == 0) {
+        return false;  // No interrupt IN endpoint on this interface: poll only
+    }
+
+    // The source belongs to the interface and goes away with it (not released here)
+    CFRunLoopSourceRef source = nullptr;
+    IOReturn kr = (*usbInterface_)->CreateInterfaceAsyncEventSource(usbInterface_, &source);
+    if (kr != kIOReturnSuccess || source == nullptr) {
+        std::cerr << "Failed to create event source: 0x" << std::hex << kr << std::dec << std::endl;
+        return false;
+    }
+    CFRunLoopAddSource(CFRunLoopGetMain(), source, kCFRunLoopDefaultMode);
+
+    std::lock_guard<std::mutex> lock(eventMutex_);
+    eventSink_ = sink;
+    eventInterface_ = usbInterface_;
+    eventPipe_ = pipe;
+    eventSource_ = source;
+    if (!armEventRead()) {
+        // e.g. interface not opened exclusively: reads fail, control transfers still work
+        CFRunLoopRemoveSource(CFRunLoopGetMain(), source, kCFRunLoopDefaultMode);
+        eventSink_ = nullptr;
+        eventInterface_ = nullptr;
+        eventPipe_ = 0;
+        eventSource_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void IOKitTransport::stopEvents() {
+    IOUSBInterfaceInterface182** interface;
+    UInt8 pipe;
+    CFRunLoopSourceRef source;
+    {
+        // From here a completion already in flight finds no sink and does not re-arm
+        std::lock_guard<std::mutex> lock(eventMutex_);
+        interface = eventInterface_;
+        pipe = eventPipe_;
+        source = eventSource_;
+        eventSink_ = nullptr;
+        eventInterface_ = nullptr;
+        eventPipe_ = 0;
+        eventSource_ = nullptr;
+    }
+    if (interface != nullptr && pipe != 0) {
+        (*interface)->AbortPipe(interface, pipe);
+    }
+    if (source != nullptr) {
+        CFRunLoopRemoveSource(CFRunLoopGetMain(), source, kCFRunLoopDefaultMode);
+    }
+}
+
+bool IOKitTransport::armEventRead() {
+    IOReturn kr = (*eventInterface_)->ReadPipeAsync(eventInterface_, eventPipe_, eventBuffer_,
+                                                   (UInt32)EVENT_BUFFER_SIZE, eventReadComplete, this);
+    if (kr != kIOReturnSuccess) {
+        std::cerr << "Failed to read event pipe: 0x" << std::hex << kr << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void IOKitTransport::eventReadComplete(void* refCon, IOReturn result, void* arg0) {
+    IOKitTransport* self = static_cast<IOKitTransport*>(refCon);
+    std::lock_guard<std::mutex> lock(self->eventMutex_);
+    if (self->eventSink_ == nullptr) {
+        return;  // Stopped (our own AbortPipe lands here as kIOReturnAborted)
+    }
+    if (result != kIOReturnSuccess) {
+        // Device gone or pipe stalled: polling carries on without events
+        std::cerr << "Event pipe stopped: 0x" << std::hex << result << std::dec << std::endl;
+        self->eventSink_ = nullptr;
+        return;
+    }
+
+    size_t length = std::min((size_t)(uintptr_t)arg0, EVENT_BUFFER_SIZE);
+    self->eventSink_->onEventReport(self->eventBuffer_, length);
+    if (!self->armEventRead()) {
+        self->eventSink_ = nullptr;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef IOKIT_TRANSPORT_HPP
+#define IOKIT_TRANSPORT_HPP
+
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+#include <IOKit/usb/IOUSBLib.h>
+#include <mutex>
+#include "RazerTransport.hpp"
+
+// RazerTransport over IOKit USB control transfers on an already opened
+// interface. The interface is owned by RazerDevice; this class only borrows it.
+// Every transfer carries a deadline (ControlRequestTO, so the 1.8.2 interface),
+// and abortTransfer() aborts the control pipe for the watchdog.
+//
+// Events: an asynchronous read on the interface's interrupt IN pipe, re-armed
+// after every report. Completions run on the main run loop (the app's and the
+// daemon's), so the sink is called there. stopEvents() before the interface
+// goes away.
+class IOKitTransport : public RazerTransport {
+public:
+    IOKitTransport()
+        : usbInterface_(nullptr),
+          timeoutMs_(0),
+          eventSink_(nullptr),
+          eventInterface_(nullptr),
+          eventPipe_(0),
+          eventSource_(nullptr) {}
+
+    void setInterface(IOUSBInterfaceInterface182** usbInterface) { usbInterface_ = usbInterface; }
+
+    bool sendReport(const uint8_t* report) override;
+    bool readResponse(uint8_t* buffer, size_t bufferSize) override;
+    bool isOpen() const override { return usbInterface_ != nullptr; }
+    bool startEvents(RazerEventSink* sink) override;
+    void stopEvents() override;
+    void setTransferTimeoutMs(uint32_t timeoutMs) override { timeoutMs_ = timeoutMs; }
+    void abortTransfer() override;
+
+private:
+    static constexpr size_t REPORT_SIZE = 90;
+    
+    // USB HID Request types
+    static constexpr uint8_t USB_TYPE_CLASS = 0x01 << 5;
+    static constexpr uint8_t USB_RECIP_INTERFACE = 0x01;
+    static constexpr uint8_t USB_DIR_OUT = 0x00;
+    static constexpr uint8_t USB_DIR_IN = 0x80;
+    static constexpr uint8_t HID_REQ_SET_REPORT = 0x09;
+    static constexpr uint8_t HID_REQ_GET_REPORT = 0x01;
+
+    static constexpr size_t EVENT_BUFFER_SIZE = 64;  // Largest interrupt packet expected
+
+    IOUSBInterfaceInterface182** usbInterface_;
+    uint32_t timeoutMs_;  // Per control request, 0 = the kernel's default
+
+    // Interrupt reader state, shared between the worker (start/stop) and the
+    // completion on the main run loop
+    std::mutex eventMutex_;
+    RazerEventSink* eventSink_;                 // nullptr = stopped, do not re-arm
+    IOUSBInterfaceInterface182** eventInterface_;
+    UInt8 eventPipe_;
+    CFRunLoopSourceRef eventSource_;
+    uint8_t eventBuffer_[EVENT_BUFFER_SIZE];
+
+    bool controlRequest(UInt8 requestType, UInt8 request, void* data, const char* what);
+    UInt8 findInterruptInPipe() const;
+    bool armEventRead();  // Caller holds eventMutex_
+    static void eventReadComplete(void* refCon, IOReturn result, void* arg0);
+};
+
+#endif // IOKIT_TRANSPORT_HPP
@@ -3,6 +3,13 @@
 #include <iomanip>
 #include <cstring>
 #include <unistd.h>
+#include "RazerReport.hpp"
+
+// Standard battery query (Class 0x07, Cmd 0x80) with checksum computed at compile time
+constexpr RazerReport BATTERY_QUERY = RazerReportBuilder()
+    .transactionId(0x1F)
+    .command({0x07, 0x80, 0x00, 0x00})
+    .build();
 
 void analyzeInterface(const char* path, int interfaceNum) {
     std::cout << "\n========================================" << std::endl;
@@ -60,35 +67,20 @@ void analyzeInterface(const char* path, int interfaceNum) {
     }
 
     std::cout << "\n--- Test 2: Try standard battery query (Class 0x07, Cmd 0x80) ---" << std::endl;
-    uint8_t report[90];
-    memset(report, 0, 90);
-    report[0] = 0x02;  // NEW_REQUEST
-    report[1] = 0x1F;  // Transaction ID
-    report[6] = 0x07;  // Command Class
-    report[7] = 0x80;  // Command ID - Battery
-
-    uint8_t checksum = 0;
-    for (int i = 2; i <= 88; ++i) {
-        checksum ^= report[i];
-    }
-    report[89] = checksum;
+    RazerReport report = BATTERY_QUERY;
+    report.setStatus(0x02);  // NEW_REQUEST
 
     uint8_t writeBuf[91];
     writeBuf[0] = 0x00;
-    memcpy(writeBuf + 1, report, 90);
+    memcpy(writeBuf + 1, report.data(), RazerReportLayout::SIZE);
 
     result = hid_send_feature_report(device, writeBuf, 91);
     std::cout << "Send result: " << result << " bytes" << std::endl;
 
     usleep(200000);
 
-    report[0] = 0x00;  // RETRIEVE
-    checksum = 0;
-    for (int i = 2; i <= 88; ++i) {
-        checksum ^= report[i];
-    }
-    report[89] = checksum;
-    memcpy(writeBuf + 1, report, 90);
+    report.setStatus(0x00);  // RETRIEVE (status is not checksummed)
+    memcpy(writeBuf + 1, report.data(), RazerReportLayout::SIZE);
 
     hid_send_feature_report(device, writeBuf, 91);
     usleep(50000);
@@ -99,7 +91,7 @@ void analyzeInterface(const char* path, int interfaceNum) {
 
     if (result > 0) {
         std::cout << "Response Status: 0x" << std::hex << std::setfill('0')
-                  << std::setw(2) << (int)readBuf[1] << std::dec << std::endl;
+                  << std::setw(2) << (int)RazerResponseView(readBuf + 1).status() << std::dec << std::endl;
 
         bool hasData = false;
         for (int i = 9; i < result && i < 91; ++i) {
@@ -122,19 +114,8 @@ void analyzeInterface(const char* path, int interfaceNum) {
     }
 
     std::cout << "\n--- Test 3: Try reading without Double Tap (Status 0x00 only) ---" << std::endl;
-    memset(report, 0, 90);
-    report[0] = 0x00;  // Standard query
-    report[1] = 0x1F;
-    report[6] = 0x07;
-    report[7] = 0x80;
-
-    checksum = 0;
-    for (int i = 2; i <= 88; ++i) {
-        checksum ^= report[i];
-    }
-    report[89] = checksum;
-
-    memcpy(writeBuf + 1, report, 90);
+    report = BATTERY_QUERY;  // Standard query, status 0x00
+    memcpy(writeBuf + 1, report.data(), RazerReportLayout::SIZE);
     hid_send_feature_report(device, writeBuf, 91);
     usleep(100000);
 
@@ -0,0 +1,102 @@
+#ifndef MENU_BAR_STATE_HPP
+#define MENU_BAR_STATE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// What the menu bar item shows. Two states that compare equal render the same
+// title and icon, so the app only touches the status item when the state changes.
+// A reading is one of 101 x 2 states (percent, charging), which lets the app
+// build every title once and reuse it.
+struct MenuBarState {
+    enum Kind : uint8_t {
+        Connecting,     // "..." until the first connect attempt is over
+        NotFound,
+        Disconnected,
+        Reading,        // Percent (+ charging) from the last query
+        Stale,          // Last query failed: cached percent with (?)
+        Error           // Last query failed and nothing is cached
+    };
+
+    // Title color; TintNone = plain title in the menu bar's own color
+    enum Tint : uint8_t { TintNone, TintGray, TintRed, TintYellow, TintGreen };
+
+    static constexpr size_t READING_STATES = 101 * 2;
+
+    Kind kind = Connecting;
+    uint8_t percent = 0;    // Reading and Stale
+    bool charging = false;  // Reading
+
+    static MenuBarState of(Kind kind) {
+        MenuBarState state;
+        state.kind = kind;
+        return state;
+    }
+
+    static MenuBarState reading(uint8_t percent, bool charging) {
+        MenuBarState state;
+        state.kind = Reading;
+        state.percent = percent > 100 ? 100 : percent;
+        state.charging = charging;
+        return state;
+    }
+
+    static MenuBarState stale(uint8_t percent) {
+        MenuBarState state;
+        state.kind = Stale;
+        state.percent = percent > 100 ? 100 : percent;
+        return state;
+    }
+
+    bool operator==(const MenuBarState& other) const {
+        return kind == other.kind && percent == other.percent && charging == other.charging;
+    }
+    bool operator!=(const MenuBarState& other) const { return !(*this == other); }
+
+    // Slot of a Reading state in the pre-built title cache
+    size_t readingIndex() const { return (size_t)percent * 2 + (charging ? 1 : 0); }
+
+    Tint tint() const {
+        switch (kind) {
+            case Reading:
+                if (percent <= 20) {
+                    return TintRed;      // Critical (0-20%)
+                }
+                return percent <= 40 ? TintYellow : TintGreen;  // Warning (21-40%), good
+            case Stale:
+            case Error:
+                return TintGray;
+            default:
+                return TintNone;
+        }
+    }
+
+    // UTF-8 title; withEmoji prefixes the mouse emoji for systems without the
+    // SF Symbol icon
+    void formatTitle(char* buffer, size_t size, bool withEmoji) const {
+        const char* prefix = withEmoji ? "🖱️ " : "";
+        switch (kind) {
+            case Connecting:
+                snprintf(buffer, size, "%s...", prefix);
+                break;
+            case NotFound:
+                snprintf(buffer, size, "%sNot Found", prefix);
+                break;
+            case Disconnected:
+                snprintf(buffer, size, "%sDisconnected", prefix);
+                break;
+            case Reading:
+                snprintf(buffer, size, "%s%u%%%s", prefix, (unsigned)percent, charging ? " ⚡" : "");
+                break;
+            case Stale:
+                snprintf(buffer, size, "%s%u%% (?)", prefix, (unsigned)percent);
+                break;
+            case Error:
+                snprintf(buffer, size, "%sError", prefix);
+                break;
+        }
+    }
+};
+
+#endif // MENU_BAR_STATE_HPP
@@ -0,0 +1,54 @@
+#include "PollScheduler.hpp"
+#include <algorithm>
+#include <cmath>
+
+PollScheduler::PollScheduler(const PollSchedulePolicy& policy)
+    : policy_(policy),
+      model_(WINDOW),
+      lastIntervalMs_(0) {
+}
+
+void PollScheduler::reset() {
+    model_.reset();
+    lastIntervalMs_ = 0;
+}
+
+void PollScheduler::addSample(uint64_t nowMs, uint8_t percent, bool charging) {
+    if (model_.count() > 0 && charging != model_.charging()) {
+        lastIntervalMs_ = 0;  // New direction: learn again from the short interval
+    }
+    BatterySample sample;
+    sample.timeMs = nowMs;
+    sample.percent = percent;
+    sample.charging = charging;
+    model_.add(sample);
+}
+
+double PollScheduler::slopePercentPerHour() const {
+    return model_.slopePercentPerHour();
+}
+
+uint32_t PollScheduler::clamp(uint64_t intervalMs) const {
+    uint64_t upper = policy_.maxIntervalMs;
+    if (model_.count() > 0 && !model_.charging() && model_.latest().percent <= policy_.lowBatteryPercent) {
+        upper = std::min<uint64_t>(upper, policy_.lowBatteryMaxIntervalMs);
+    }
+    return (uint32_t)std::max<uint64_t>(std::min(intervalMs, upper), policy_.minIntervalMs);
+}
+
+uint32_t PollScheduler::nextIntervalMs() {
+    double slope = std::fabs(slopePercentPerHour());
+    uint64_t interval;
+
+    if (model_.count() < 2) {
+        interval = policy_.learningIntervalMs;
+    } else if (slope < 0.01) {
+        // Nothing moved yet (full, idle or on the charger): back off geometrically
+        interval = (uint64_t)std::max(lastIntervalMs_, policy_.learningIntervalMs) * 2;
+    } else {
+        interval = (uint64_t)(policy_.targetChangePercent / slope * 3600000.0);
+    }
+
+    lastIntervalMs_ = clamp(interval);
+    return lastIntervalMs_;
+}
@@ -0,0 +1,53 @@
+#ifndef POLL_SCHEDULER_HPP
+#define POLL_SCHEDULER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "DrainModel.hpp"
+
+// Bounds for PollScheduler (milliseconds unless noted)
+struct PollSchedulePolicy {
+    uint32_t minIntervalMs = 30000;           // Never poll more often than this
+    uint32_t maxIntervalMs = 900000;          // Never wait longer than 15 minutes
+    uint32_t learningIntervalMs = 60000;      // Until a slope is known
+    double targetChangePercent = 1.0;         // Aim for ~1% change between polls
+    uint8_t lowBatteryPercent = 20;           // Below this (discharging) polls tighten
+    uint32_t lowBatteryMaxIntervalMs = 120000;
+};
+
+// Picks the next battery poll time from the measured drain/charge rate.
+//
+// Fits the drain slope over the last few samples of the current charging state
+// (DrainModel with a short window). The next interval is the time the
+// battery needs to move targetChangePercent at that slope, clamped to the policy
+// bounds. While no change has been observed yet the interval doubles, so a full
+// or idle battery quickly backs off to maxIntervalMs. Like ConnectionStateMachine
+// it takes the current time as an argument and owns no timer.
+class PollScheduler {
+public:
+    explicit PollScheduler(const PollSchedulePolicy& policy = PollSchedulePolicy());
+
+    // Record one battery reading; a charging flip restarts the slope estimate
+    void addSample(uint64_t nowMs, uint8_t percent, bool charging);
+
+    // Delay until the next poll, based on the samples so far
+    uint32_t nextIntervalMs();
+
+    // Fitted slope in percent per hour (negative while discharging), 0 if unknown
+    double slopePercentPerHour() const;
+
+    size_t sampleCount() const { return model_.count(); }
+    uint32_t lastIntervalMs() const { return lastIntervalMs_; }
+    void reset();
+
+private:
+    static constexpr size_t WINDOW = 8;  // Short window: react to load changes quickly
+
+    PollSchedulePolicy policy_;
+    DrainModel model_;
+    uint32_t lastIntervalMs_;
+
+    uint32_t clamp(uint64_t intervalMs) const;
+};
+
+#endif // POLL_SCHEDULER_HPP
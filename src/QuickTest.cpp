@@ -2,6 +2,7 @@
 #include <iostream>
 #include <cstring>
 #include <unistd.h>
+#include "RazerReport.hpp"
 
 int main() {
     if (hid_init() != 0) {
@@ -21,28 +22,15 @@ int main() {
 
     std::cout << "Device opened (using default interface)" << std::endl;
 
-    // Construct battery query using exact OpenRazer format
-    uint8_t report[91];  // 1 (report ID) + 90 (data)
-    memset(report, 0, 91);
+    // Construct battery query using exact OpenRazer format (checksum folded at compile time)
+    constexpr RazerReport batteryQuery = RazerReportBuilder()
+        .transactionId(0x1F)
+        .command({0x07, 0x80, 0x02, 0x00})  // Class 0x07, Command 0x80, data size 2
+        .build();
 
+    uint8_t report[91];  // 1 (report ID) + 90 (data)
     report[0] = 0x00;  // Report ID
-    report[1] = 0x00;  // Status (0x00 for host->device)
-    report[2] = 0x1F;  // Transaction ID
-    report[3] = 0x00;  // Reserved
-    report[4] = 0x00;  // Reserved
-    report[5] = 0x00;  // Reserved
-    report[6] = 0x02;  // Data size
-    report[7] = 0x00;  // Reserved
-    report[8] = 0x07;  // Command class
-    report[9] = 0x80;  // Command ID
-    // report[10-89] = 0x00 (parameters/arguments)
-
-    // Calculate CRC (XOR of bytes 3-89, stored at byte 90)
-    uint8_t crc = 0;
-    for (int i = 3; i <= 89; ++i) {
-        crc ^= report[i];
-    }
-    report[90] = crc;
+    memcpy(report + 1, batteryQuery.data(), RazerReportLayout::SIZE);
 
     std::cout << "Sending query via feature report..." << std::endl;
     int result = hid_send_feature_report(dev, report, 91);
@@ -64,11 +52,13 @@ int main() {
         }
         std::cout << std::endl;
 
-        std::cout << "Battery at byte 11 (arguments[1]): 0x" << std::hex
-                  << (int)report[11] << std::dec << " (" << (int)report[11] << ")" << std::endl;
+        // Skip the report ID; battery is arguments[1] (report byte 9)
+        RazerResponseView response(report + 1);
+        std::cout << "Battery at arguments[1]: 0x" << std::hex
+                  << (int)response.arg(1) << std::dec << " (" << (int)response.arg(1) << ")" << std::endl;
 
-        if (report[11] != 0) {
-            int percentage = (report[11] * 100) / 255;
+        if (response.arg(1) != 0) {
+            int percentage = (response.arg(1) * 100) / 255;
             std::cout << "*** BATTERY FOUND: " << percentage << "% ***" << std::endl;
         }
     } else {
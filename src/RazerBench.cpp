@@ -0,0 +1,1940 @@
+/**
+ * RazerBench.cpp - Benchmarks for the protocol, scheduling and status paths
+ *
+ * The suite (BenchHarness) reports median, p99 and allocations per op for
+ * report build + checksum, response parsing, PID lookup, a query cycle and a
+ * reconnect after a synthetic hotplug against a simulated device, the poll
+ * scheduler and the status update every refresh publishes. `--suite` runs only
+ * that; `--latency US` sets the simulated device's answer time.
+ *
+ * The full run also compares the hand-filled report (memset, magic offsets,
+ * runtime checksum over 86 bytes) with the compile-time RazerReport templates,
+ * and byte-offset parsing with RazerResponseView. It refreshes several simulated devices through
+ * DeviceRegistry to check that one slow dongle does not hold up the others,
+ * times a status query against StatusServer over a real Unix socket, and reads
+ * SharedStatus snapshots from several threads while one thread keeps writing.
+ * Event reports are injected through SimulatedRazerDevice to time the path
+ * from interrupt report to updated snapshot, and the transfer histograms are
+ * checked against a scripted device and timed per recorded transfer. A
+ * session is captured into a RazerTrace and replayed, paced and at full speed.
+ * MenuBarState's title slots, tints and equality are checked exhaustively.
+ * PollScheduler is replayed over a synthetic day of discharge and charge.
+ * SampleRing is run across a producer/consumer thread pair and DrainModel fed
+ * a known linear discharge and charge.
+ * ConnectionStateMachine's retry timing is checked on a virtual clock.
+ * The history log is wrapped, then reopened after each way a crash can leave
+ * it (stale count, torn record, half-done wrap, corrupt capacity).
+ * A device that hangs mid-request must be cut off by TransferWatchdog within
+ * one deadline. On Linux the hidraw backend runs against a fake sysfs tree, a
+ * simulated mouse behind its feature report ioctls and a fake uevent stream.
+ * Finally DiscoveryEngine sweeps three simulated mice in parallel, an
+ * interrupted sweep is resumed from its checkpoint, and the resulting capability
+ * files are mapped and checked to make the first query after connect exact.
+ * Portable: `make CXX=g++ bench && ./RazerBench`.
+ */
+
+#include "BenchHarness.hpp"
+#include "CapabilityDatabase.hpp"
+#include "ConnectionStateMachine.hpp"
+#include "DeviceRegistry.hpp"
+#include "DeviceStatus.hpp"
+#include "DiscoveryEngine.hpp"
+#include "DrainModel.hpp"
+#include "HistoryLog.hpp"
+#include "MenuBarState.hpp"
+#ifdef __linux__
+#include "HidrawDevices.hpp"
+#include "HidrawTransport.hpp"
+#include "RazerDeviceMonitor.hpp"
+#endif
+#include "PollScheduler.hpp"
+#include "RazerDeviceTable.hpp"
+#include "RazerProtocol.hpp"
+#include "RazerReport.hpp"
+#include "RazerTrace.hpp"
+#include "SampleRing.hpp"
+#include "SharedStatus.hpp"
+#include "SimulatedRazerDevice.hpp"
+#include "StatusServer.hpp"
+#include "TraceReplay.hpp"
+#include "TransferStats.hpp"
+#include "TransferWatchdog.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+#ifdef __linux__
+#include <ftw.h>
+#include <linux/hidraw.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#endif
+
+namespace {
+
+constexpr uint32_t ITERATIONS = 5000000;
+constexpr uint32_t HISTORY_CAPACITY = 8;  // Small enough to wrap in a few appends
+
+// Keeps the compiler from dropping the measured work
+volatile uint8_t sink;
+
+// The pre-RazerReport way of building a query
+void buildLegacy(uint8_t* report, uint8_t transactionId, const RazerCommand& command) {
+    std::memset(report, 0, 90);
+    report[0] = 0x00;
+    report[1] = transactionId;
+    report[5] = command.dataSize;
+    report[6] = command.cmdClass;
+    report[7] = command.cmdId;
+    report[8] = command.arg0;
+
+    uint8_t checksum = 0;
+    for (size_t i = 2; i < 88; ++i) {
+        checksum ^= report[i];
+    }
+    report[88] = checksum;
+}
+
+uint16_t parseLegacy(const uint8_t* response) {
+    // Copy out, then read fixed offsets (what the tools did)
+    uint8_t copy[90];
+    std::memcpy(copy, response, 90);
+    const uint8_t* args = copy + 8;
+    return (uint16_t)(copy[0] + ((args[1] << 8) | args[2]) + copy[9]);
+}
+
+uint16_t parseView(const uint8_t* response) {
+    RazerResponseView view(response);
+    return (uint16_t)(view.status() + view.argU16(1) + view.arg(1));
+}
+
+template <typename Work>
+double nanosPerOp(Work work) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        work(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / ITERATIONS;
+}
+
+void printRow(const char* name, double nanos) {
+    std::cout << "  " << name << ": " << nanos << " ns/op" << std::endl;
+}
+
+// One simulated device as the registry sees it
+struct SimulatedSlotDevice {
+    SimulatedRazerDevice transport;
+    RazerProtocol protocol;
+
+    explicit SimulatedSlotDevice(uint32_t latencyUs) : protocol(&transport) {
+        SimulatedCommandConfig config;
+        config.latencyUs = latencyUs;
+        transport.setDefaultCommand(config);
+    }
+};
+
+void refreshSimulated(SimulatedSlotDevice* device, DeviceJobResult& result) {
+    static const RazerCommand refreshCommands[] = {
+        RazerProtocol::CMD_BATTERY,
+        RazerProtocol::CMD_CHARGING
+    };
+    result.connected = true;
+    result.ok = device->protocol.queryAll(refreshCommands, 2, result.snapshot);
+}
+
+double millisSince(std::chrono::steady_clock::time_point start) {
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return (double)std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000.0;
+}
+
+// Refreshes one dongle per latency, first back to back on a single worker (the
+// old single-device path), then through DeviceRegistry with a worker per device
+bool benchParallelRefresh() {
+    const uint32_t latenciesUs[] = {10000, 10000, 10000, 30000};  // The last one is the slow dongle
+    const size_t deviceCount = sizeof(latenciesUs) / sizeof(latenciesUs[0]);
+
+    double sumMs = 0;
+    double maxMs = 0;
+    for (uint32_t latencyUs : latenciesUs) {
+        // Two commands per refresh
+        double ms = 2.0 * latencyUs / 1000.0;
+        sumMs += ms;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t finished = 0;
+
+    // Serial: every device behind one worker
+    std::vector<std::unique_ptr<SimulatedSlotDevice>> serialDevices;
+    for (uint32_t latencyUs : latenciesUs) {
+        serialDevices.emplace_back(new SimulatedSlotDevice(latencyUs));
+    }
+    DeviceWorker serialWorker;
+    auto start = std::chrono::steady_clock::now();
+    for (auto& device : serialDevices) {
+        SimulatedSlotDevice* raw = device.get();
+        serialWorker.post(0, [raw](DeviceJobResult& result) { refreshSimulated(raw, result); },
+            [&](const DeviceJobResult&) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished++;
+                done.notify_one();
+            });
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return finished == deviceCount; });
+    }
+    double serialMs = millisSince(start);
+
+    // Parallel: one registry slot (and worker) per device
+    DeviceRegistry<SimulatedSlotDevice> registry;
+    for (size_t i = 0; i < deviceCount; i++) {
+        registry.add((uint32_t)(i + 1), 0x00A6,
+                     std::unique_ptr<SimulatedSlotDevice>(new SimulatedSlotDevice(latenciesUs[i])));
+    }
+    bool allDone = false;
+    size_t okCount = 0;
+    start = std::chrono::steady_clock::now();
+    registry.postAll(1,
+        [](DeviceRegistry<SimulatedSlotDevice>::Slot& slot) -> DeviceWorker::Job {
+            SimulatedSlotDevice* device = slot.device.get();
+            return [device](DeviceJobResult& result) { refreshSimulated(device, result); };
+        },
+        [&](uint32_t, const DeviceJobResult& result) {
+            std::lock_guard<std::mutex> lock(mutex);
+            okCount += result.ok ? 1 : 0;
+        },
+        [&]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            allDone = true;
+            done.notify_one();
+        });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return allDone; });
+    }
+    double parallelMs = millisSince(start);
+
+    std::cout << "Refresh " << deviceCount << " devices (device latency: sum " << sumMs
+              << " ms, max " << maxMs << " ms)" << std::endl;
+    std::cout << "  one worker for all devices: " << serialMs << " ms" << std::endl;
+    std::cout << "  DeviceRegistry, worker per device: " << parallelMs << " ms" << std::endl;
+
+    if (okCount != deviceCount) {
+        std::cerr << "Only " << okCount << " of " << deviceCount << " devices answered" << std::endl;
+        return false;
+    }
+    // Bounded by the slowest device, not the sum (generous slack for loaded machines)
+    if (parallelMs >= sumMs) {
+        std::cerr << "Registry refresh took the sum of device latencies" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Reads one reply line from a blocking socket
+bool readLine(int fd, std::string& pending, std::string& line) {
+    char buffer[1024];
+    size_t newline;
+    while ((newline = pending.find('\n')) == std::string::npos) {
+        ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            return false;
+        }
+        pending.append(buffer, (size_t)received);
+    }
+    line = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    return true;
+}
+
+// Round trip of a cached "status" query, the cost a script pays instead of a
+// USB refresh, plus one subscribe push after a publish
+bool benchStatusQuery() {
+    const uint32_t queries = 20000;
+    std::string path = "/tmp/razer-bench-" + std::to_string(getpid()) + ".sock";
+
+    StatusServer server;
+    if (!server.start(path)) {
+        return false;
+    }
+    DeviceStatus status;
+    status.id = 1;
+    status.pid = 0x00A6;
+    status.name = "Razer Viper V2 Pro";
+    status.connected = true;
+    status.batteryValid = true;
+    status.batteryPercent = 87;
+    status.timeMs = 1700000000000ULL;
+    server.publish(status);
+
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (const sockaddr*)&address, sizeof(address)) != 0) {
+        std::cerr << "Cannot connect to " << path << std::endl;
+        return false;
+    }
+
+    std::string expected = server.statusLine();
+    std::string pending;
+    std::string line;
+
+    // Before the first publishStats(): an empty stats object, not the status line
+    bool ok = send(fd, "stats\n", 6, 0) == 6 && readLine(fd, pending, line) && line == "{\"stats\":[]}";
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < queries && ok; i++) {
+        ok = send(fd, "status\n", 7, 0) == 7 && readLine(fd, pending, line) && line == expected;
+    }
+    double usPerQuery = millisSince(start) * 1000.0 / queries;
+
+    // A subscriber gets the current line, then the changed one
+    if (ok) {
+        status.batteryPercent = 86;
+        ok = send(fd, "subscribe\n", 10, 0) == 10 && readLine(fd, pending, line) && line == expected;
+        server.publish(status);
+        ok = ok && readLine(fd, pending, line) && line == server.statusLine() && line != expected;
+    }
+    close(fd);
+
+    // A client streaming without a newline is dropped once it passes the
+    // longest request, not after the server has buffered all it sent
+    int flood = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (ok && flood >= 0 && connect(flood, (const sockaddr*)&address, sizeof(address)) == 0) {
+        std::string junk(4096, 'x');  // Fits the socket buffer: one wakeup's worth
+        char byte;
+        timeval timeout = {1, 0};
+        setsockopt(flood, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        ok = send(flood, junk.data(), junk.size(), 0) == (ssize_t)junk.size() &&
+             (recv(flood, &byte, 1, 0) == 0 || errno == ECONNRESET);
+        if (!ok) {
+            std::cerr << "Status server kept a client sending no newline" << std::endl;
+        }
+    }
+    if (flood >= 0) {
+        close(flood);
+    }
+    server.stop();
+
+    std::cout << "Status query over Unix socket (" << queries << " round trips)" << std::endl;
+    std::cout << "  cached reply: " << usPerQuery << " us/query (a USB refresh is ~20 ms)" << std::endl;
+    if (!ok) {
+        std::cerr << "Status server replied with an unexpected line: " << line << std::endl;
+    }
+    return ok;
+}
+
+
+// Snapshot a writer publishes as its count-th update: every field derives from
+// count, so a reader can tell a torn copy from a consistent one
+SharedDeviceSnapshot countedSnapshot(uint32_t id, uint64_t count) {
+    SharedDeviceSnapshot snapshot;
+    std::memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.id = id;
+    snapshot.pid = 0x00A6;
+    snapshot.batteryPercent = (uint8_t)(count % 101);
+    snapshot.connected = true;
+    snapshot.batteryValid = true;
+    snapshot.charging = (count & 1) != 0;
+    snapshot.timeMs = count;
+    snapshot.estimateMs = count * 3;
+    // Hex digits of count spread over the whole name, so tearing shows in any word
+    for (size_t i = 0; i + 1 < sizeof(snapshot.name); i++) {
+        snapshot.name[i] = "0123456789abcdef"[(count >> ((i % 16) * 4)) & 0xF];
+    }
+    return snapshot;
+}
+
+bool isCounted(const SharedDeviceSnapshot& snapshot) {
+    SharedDeviceSnapshot expected = countedSnapshot(snapshot.id, snapshot.timeMs);
+    return std::memcmp(&snapshot, &expected, sizeof(snapshot)) == 0;
+}
+
+// One writer republishing two devices as fast as it can, readerCount readers
+// (each with its own mapping, as separate processes would have) copying both
+struct SeqlockRun {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t retries = 0;
+    uint64_t torn = 0;
+    double nsPerRead = 0;
+};
+
+bool runSeqlock(const std::string& path, size_t readerCount, bool withWriter, SeqlockRun& run) {
+    const auto duration = std::chrono::milliseconds(150);
+
+    SharedStatusWriter writer;
+    if (!writer.open(path)) {
+        return false;
+    }
+    writer.publish(countedSnapshot(1, 0));
+    writer.publish(countedSnapshot(2, 0));
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0);
+    std::atomic<uint64_t> retries(0);
+    std::atomic<uint64_t> torn(0);
+    std::atomic<uint64_t> readNs(0);
+    bool opened = true;
+
+    std::vector<std::unique_ptr<SharedStatusReader>> readers;
+    for (size_t i = 0; i < readerCount; i++) {
+        readers.emplace_back(new SharedStatusReader());
+        opened = readers.back()->open(path) && opened;
+    }
+    if (!opened) {
+        return false;
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < readerCount; i++) {
+        SharedStatusReader* reader = readers[i].get();
+        threads.emplace_back([&, reader]() {
+            SharedDeviceSnapshot devices[SharedStatusWriter::MAX_DEVICES];
+            uint64_t count = 0;
+            uint64_t bad = 0;
+            auto start = std::chrono::steady_clock::now();
+            while (!stop.load(std::memory_order_relaxed)) {
+                size_t n = reader->read(devices, SharedStatusWriter::MAX_DEVICES);
+                for (size_t d = 0; d < n; d++) {
+                    bad += isCounted(devices[d]) ? 0 : 1;
+                }
+                bad += n == 2 ? 0 : 1;
+                count++;
+            }
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            reads += count;
+            torn += bad;
+            retries += reader->retries();
+            readNs += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        });
+    }
+
+    uint64_t writes = 0;
+    auto start = std::chrono::steady_clock::now();
+    if (withWriter) {
+        while (std::chrono::steady_clock::now() - start < duration) {
+            writes++;
+            writer.publish(countedSnapshot(1 + (uint32_t)(writes & 1), writes));
+        }
+    } else {
+        std::this_thread::sleep_for(duration);
+    }
+    stop = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    run.reads = reads;
+    run.writes = writes;
+    run.retries = retries;
+    run.torn = torn;
+    run.nsPerRead = run.reads > 0 ? (double)readNs / (double)run.reads : 0;
+    return true;
+}
+
+// Seqlock reads of the shared snapshot under write contention
+bool benchSharedStatus() {
+    std::string path = "/tmp/razer-bench-" + std::to_string(getpid()) + ".status";
+    const size_t readerCounts[] = {1, 2, 4, 8};
+
+    std::cout << "SharedStatus seqlock read (2 devices per read, 150 ms per run)" << std::endl;
+    bool ok = true;
+    for (int contended = 0; contended < 2 && ok; contended++) {
+        for (size_t readerCount : readerCounts) {
+            SeqlockRun run;
+            if (!runSeqlock(path, readerCount, contended != 0, run)) {
+                std::cerr << "Cannot open shared status at " << path << std::endl;
+                return false;
+            }
+            std::cout << "  " << readerCount << (readerCount == 1 ? " reader, " : " readers, ")
+                      << (contended ? "writer busy: " : "writer idle: ") << run.nsPerRead << " ns/read, "
+                      << run.reads << " reads, " << run.writes << " writes, " << run.retries << " retries"
+                      << std::endl;
+            if (run.torn != 0) {
+                std::cerr << run.torn << " reads returned a torn or missing snapshot" << std::endl;
+                ok = false;
+            }
+            if (!contended) {
+                break;  // Uncontended cost does not depend on the reader count
+            }
+        }
+    }
+    return ok;
+}
+
+
+// Charger plug/unplug reports injected as if read from the interrupt pipe,
+// through RazerProtocol's parser into a snapshot
+bool benchEventDispatch() {
+    const uint32_t events = 1000000;
+
+    SimulatedRazerDevice device;
+    RazerProtocol protocol(&device);
+    RazerSnapshot snapshot;
+    uint32_t unknown = 0;
+    protocol.setEventHandler([&](const RazerEvent& event) {
+        if (!RazerProtocol::applyEvent(event, snapshot)) {
+            unknown++;
+        }
+    });
+    if (!protocol.startEvents()) {
+        std::cerr << "Simulated device did not accept an event sink" << std::endl;
+        return false;
+    }
+
+    uint8_t charging[16] = {RazerEventParser::REPORT_ID, RazerEventParser::TYPE_CHARGING, 0x00};
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < events; i++) {
+        charging[2] = (uint8_t)(i & 1);
+        device.injectEventReport(charging, sizeof(charging));
+        sink = snapshot.isCharging ? 1 : 0;
+    }
+    double nsPerEvent = millisSince(start) * 1000000.0 / events;
+
+    // Battery level, a type without payload, and ordinary input that is not an event
+    const uint8_t battery[16] = {RazerEventParser::REPORT_ID, RazerEventParser::TYPE_BATTERY, 0xFF};
+    const uint8_t other[16] = {RazerEventParser::REPORT_ID, 0x02};
+    const uint8_t input[8] = {0x01, 0x00, 0x05};
+    device.injectEventReport(battery, sizeof(battery));
+    device.injectEventReport(other, sizeof(other));
+    device.injectEventReport(input, sizeof(input));
+    protocol.stopEvents();
+    bool delivered = device.injectEventReport(charging, sizeof(charging));
+
+    std::cout << "Event report to snapshot (" << events << " charger events)" << std::endl;
+    std::cout << "  interrupt event: " << nsPerEvent << " ns/event (a 30 s poll sees a change after 15 s on average)"
+              << std::endl;
+
+    bool ok = snapshot.chargingValid && snapshot.isCharging == ((events - 1) & 1) &&
+              snapshot.batteryValid && snapshot.batteryPercent == 100 &&
+              unknown == 1 && protocol.eventCount() == events + 2 && !delivered;
+    if (!ok) {
+        std::cerr << "Event dispatch produced the wrong snapshot" << std::endl;
+    }
+    return ok;
+}
+
+// Bucket math, the counts a scripted device must produce, and what the
+// instrumentation adds to each transfer
+bool benchTransferStats() {
+    bool ok = true;
+    for (size_t i = 0; i + 1 < LatencyHistogram::BUCKETS; i++) {
+        uint32_t upper = LatencyHistogram::bucketUpperUs(i);
+        if (LatencyHistogram::bucketFor(upper) != i || LatencyHistogram::bucketFor(upper + 1) != i + 1) {
+            std::cerr << "Histogram bucket " << i << " does not round-trip" << std::endl;
+            ok = false;
+        }
+    }
+
+    LatencyHistogram uniform;
+    for (uint32_t us = 1; us <= 100000; us++) {
+        uniform.record(us);
+    }
+    uint32_t p50 = uniform.percentileUs(0.50);
+    uint32_t p99 = uniform.percentileUs(0.99);
+    if (p50 < 50000 || p50 > 56250 || p99 < 99000 || p99 > 100000) {
+        std::cerr << "Histogram percentiles off: p50 " << p50 << " us, p99 " << p99 << " us" << std::endl;
+        ok = false;
+    }
+
+    // Wrong cached transaction ID (0x03 then a re-probe), an unsupported command
+    // (0x04) and one corrupted answer to a mode switch
+    SimulatedRazerDevice device;
+    RazerProtocol protocol(&device);
+    device.setTransactionId(0xFF);
+    SimulatedCommandConfig unsupported;
+    unsupported.notSupported = true;
+    device.setCommand(RazerProtocol::CMD_IDLE_TIME.cmdClass, RazerProtocol::CMD_IDLE_TIME.cmdId, unsupported);
+
+    const RazerCommand commands[] = {RazerProtocol::CMD_BATTERY, RazerProtocol::CMD_CHARGING};
+    const uint32_t refreshes = 20;
+    RazerSnapshot snapshot;
+    for (uint32_t i = 0; i < refreshes; i++) {
+        protocol.queryAll(commands, 2, snapshot);
+    }
+    protocol.queryAll(&RazerProtocol::CMD_IDLE_TIME, 1, snapshot);
+    device.setChecksumFaults(1);
+    protocol.setDeviceMode(RazerProtocol::DRIVER_MODE, 0x00);
+    protocol.setDeviceMode(RazerProtocol::DRIVER_MODE, 0x00);
+
+    const TransferStats& stats = protocol.transferStats();
+    uint64_t transfers = device.sendCount();
+    const TransferStats::Command* battery = nullptr;
+    const TransferStats::Command* idle = nullptr;
+    for (size_t i = 0; i < stats.commandCount(); i++) {
+        const TransferStats::Command& command = stats.command(i);
+        if (command.cmdClass() == 0x07 && command.cmdId() == 0x80) {
+            battery = &command;
+        } else if (command.cmdClass() == 0x07 && command.cmdId() == 0x83) {
+            idle = &command;
+        }
+    }
+    bool counted = stats.phase(TransferPhase::Send).count() == transfers &&
+                   stats.phase(TransferPhase::Wait).count() == transfers &&
+                   stats.phase(TransferPhase::Read).count() >= transfers &&
+                   stats.phase(TransferPhase::Retry).count() == 1 &&
+                   battery != nullptr && battery->status00 + battery->status02 == refreshes && battery->statusOther == 1 &&
+                   idle != nullptr && idle->status04 == 1 &&
+                   stats.modeSwitch().count() == 2 && stats.modeSwitchFailures() == 1;
+    std::string json = stats.toJson();
+    if (!counted || json.find("\"retry\":{\"count\":1,") == std::string::npos) {
+        std::cerr << "Transfer statistics do not match the scripted device" << std::endl << stats.toText();
+        ok = false;
+    }
+
+    // Per transfer: four clock reads, three phase records and one command record
+    TransferStats scratch;
+    double nsPerTransfer = nanosPerOp([&](uint32_t i) {
+        uint64_t start = TransferStats::nowNs();
+        uint64_t sent = TransferStats::nowNs();
+        scratch.recordPhase(TransferPhase::Send, TransferStats::elapsedUs(start, sent));
+        uint64_t read = TransferStats::nowNs();
+        scratch.recordPhase(TransferPhase::Read, (i & 0x3FF) + 100);
+        uint64_t done = TransferStats::nowNs();
+        scratch.recordPhase(TransferPhase::Wait, TransferStats::elapsedUs(read, done));
+        scratch.recordCommand(0x07, (uint8_t)(0x80 + (i & 3)), TransferStats::elapsedUs(start, done), true, 0x00);
+    });
+
+    std::cout << "Transfer statistics (" << transfers << " simulated transfers)" << std::endl;
+    printRow("instrumentation per transfer", nsPerTransfer);
+    if (battery != nullptr && battery->latency.count() != 0) {
+        std::cout << "  simulated battery transfer: mean " << battery->latency.sumUs() / battery->latency.count()
+                  << " us, p99 " << battery->latency.percentileUs(0.99) << " us" << std::endl;
+    }
+    std::cout << "  JSON export: " << json.size() << " bytes" << std::endl;
+    return ok;
+}
+
+// Captures a connect-and-poll session against a simulated dongle, then replays
+// it paced and at full speed; both must send exactly the recorded requests
+bool benchTraceReplay() {
+    const uint32_t refreshes = 50;
+    const uint32_t loops = 200;
+    std::string path = "/tmp/razer-bench-" + std::to_string(getpid()) + ".rztrace";
+
+    SimulatedRazerDevice device;
+    SimulatedCommandConfig slow;
+    slow.latencyUs = 1500;
+    slow.jitterUs = 1000;
+    slow.busyReads = 1;
+    device.setDefaultCommand(slow);
+    device.setBatteryRaw(0xB3);
+
+    RazerTraceWriter writer;
+    if (!writer.open(path)) {
+        return false;
+    }
+    TracingTransport tracing(&device, &writer);
+    RazerProtocol protocol(&tracing);
+    protocol.setEventHandler([](const RazerEvent&) {});
+    protocol.startEvents();
+
+    // What RazerDevice::connect and the refresh jobs do
+    writer.appendProfile(0x00A6, protocol.profile());
+    uint8_t mode = 0;
+    if (!protocol.queryDeviceMode(mode) || mode != RazerProtocol::DRIVER_MODE) {
+        protocol.setDeviceMode(RazerProtocol::DRIVER_MODE, 0x00);
+    }
+    const RazerCommand commands[] = {RazerProtocol::CMD_BATTERY, RazerProtocol::CMD_CHARGING};
+    const uint8_t charging[16] = {RazerEventParser::REPORT_ID, RazerEventParser::TYPE_CHARGING, 0x01};
+    RazerSnapshot recorded;
+    for (uint32_t i = 0; i < refreshes; i++) {
+        if (i == refreshes / 2) {
+            device.injectEventReport(charging, sizeof(charging));
+        }
+        protocol.queryAll(commands, 2, recorded);
+    }
+    protocol.stopEvents();
+    writer.close();
+
+    RazerTraceReader trace;
+    if (!trace.load(path)) {
+        std::cerr << "Cannot load the captured trace " << path << std::endl;
+        unlink(path.c_str());
+        return false;
+    }
+    unlink(path.c_str());
+
+    TraceReplay replay(trace);
+    TraceReplayResult paced;
+    replay.run(true, 1, paced);
+    TraceReplayResult fast;
+    replay.run(false, loops, fast);
+
+    std::cout << "Trace replay (" << trace.records().size() << " records, "
+              << trace.durationUs() / 1000.0 << " ms recorded)" << std::endl;
+    std::cout << "  paced: " << paced.elapsedUs / 1000.0 << " ms" << std::endl;
+    std::cout << "  full speed: " << loops << " loops in " << fast.elapsedUs / 1000.0 << " ms, "
+              << (fast.elapsedUs != 0 ? (double)fast.recordedUs / (double)fast.elapsedUs : 0.0)
+              << "x real time, " << (fast.transfers != 0 ? fast.elapsedUs * 1000.0 / fast.transfers : 0.0)
+              << " ns/transfer" << std::endl;
+
+    bool ok = true;
+    for (const TraceReplayResult* result : {&paced, &fast}) {
+        uint32_t runs = result == &fast ? loops : 1;
+        if (result->mismatches != 0 || result->readings != (uint64_t)refreshes * runs ||
+            result->events != runs || !result->snapshot.batteryValid ||
+            result->snapshot.batteryPercent != recorded.batteryPercent ||
+            !result->snapshot.chargingValid || result->snapshot.isCharging != recorded.isCharging) {
+            std::cerr << "Replay diverged from the capture: " << result->mismatches << " mismatches, "
+                      << result->readings << " readings, " << result->events << " events" << std::endl;
+            ok = false;
+        }
+    }
+    if (paced.elapsedUs + 1000 < trace.durationUs() || fast.recordedUs <= fast.elapsedUs) {
+        std::cerr << "Replay pacing is off" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// Reopens the log and checks it holds exactly the records stamped first..last, in order
+bool historyHolds(const std::string& path, uint64_t first, uint64_t last, const char* what) {
+    HistoryLog log;
+    if (!log.open(path, HISTORY_CAPACITY)) {
+        std::cerr << "History (" << what << "): cannot reopen" << std::endl;
+        return false;
+    }
+    bool ok = log.count() == last - first + 1;
+    for (size_t i = 0; ok && i < log.count(); i++) {
+        HistoryRecord record;
+        ok = log.recordAt(i, record) && HistoryLog::isValid(record) && record.wallMs == first + i;
+    }
+    if (!ok) {
+        std::cerr << "History (" << what << "): " << log.count() << " records, expected "
+                  << first << ".." << last << " in order" << std::endl;
+    }
+    return ok;
+}
+
+// Writes at a file offset behind the log's back, as a crash would have left it
+void patchHistory(const std::string& path, off_t offset, const void* bytes, size_t size) {
+    int fd = open(path.c_str(), O_RDWR);
+    if (fd >= 0) {
+        sink = (uint8_t)pwrite(fd, bytes, size, offset);
+        close(fd);
+    }
+}
+
+HistoryRecord stampedRecord(uint64_t stamp) {
+    BatterySample sample;
+    sample.timeMs = stamp;
+    sample.latencyUs = 1000;
+    sample.percent = (uint8_t)(stamp % 101);
+    sample.transactionId = 0x1F;
+    sample.charging = false;
+    return HistoryLog::makeRecord(sample);
+}
+
+// Crash recovery of the mmap'd history: the log wraps, then the file is left
+// as a crash at each step of an append would leave it, and every reopen must
+// read back the right records in order. A corrupt capacity must not grow the file.
+bool benchHistoryLog() {
+    std::string path = "/tmp/razer-bench-" + std::to_string(getpid()) + ".history";
+    const off_t headerSize = 64;
+    const off_t startOffset = 20;  // Header::start
+    const off_t countOffset = 24;  // Header::count
+    auto slotOffset = [&](uint64_t slot) { return headerSize + (off_t)(slot * sizeof(HistoryRecord)); };
+    unlink(path.c_str());
+
+    // 20 records through 8 slots: 13..20 remain, the oldest (13) in slot 4
+    bool ok = true;
+    {
+        HistoryLog log;
+        if (!log.open(path, HISTORY_CAPACITY)) {
+            std::cerr << "History: cannot create " << path << std::endl;
+            return false;
+        }
+        for (uint64_t stamp = 1; stamp <= 20; stamp++) {
+            log.append(stampedRecord(stamp));
+        }
+    }
+    ok = historyHolds(path, 13, 20, "wrapped") && ok;
+
+    // Stale count: the newest record landed, the header update did not
+    uint64_t count = 7;
+    patchHistory(path, countOffset, &count, sizeof(count));
+    ok = historyHolds(path, 13, 20, "stale count") && ok;
+
+    // Torn newest record (slot 3): dropped
+    uint8_t torn = 0x00;
+    patchHistory(path, slotOffset(3) + offsetof(HistoryRecord, check), &torn, 1);
+    ok = historyHolds(path, 13, 19, "torn tail") && ok;
+
+    // Wrap cut short after the oldest slot (4) was cleared, before start
+    // moved. The lost reading (20) is taken again first, filling slot 3.
+    {
+        HistoryLog log;
+        log.open(path, HISTORY_CAPACITY);
+        log.append(stampedRecord(20));
+    }
+    HistoryRecord cleared;
+    std::memset(&cleared, 0, sizeof(cleared));
+    patchHistory(path, slotOffset(4), &cleared, sizeof(cleared));
+    ok = historyHolds(path, 14, 20, "cleared oldest") && ok;
+
+    // Wrap cut short after start moved, with the new record (21) written to
+    // the freed slot 4 but not counted: it is the newest, not the oldest
+    uint32_t start = 5;
+    count = 7;
+    HistoryRecord newest = stampedRecord(21);
+    patchHistory(path, slotOffset(4), &newest, sizeof(newest));
+    patchHistory(path, startOffset, &start, sizeof(start));
+    patchHistory(path, countOffset, &count, sizeof(count));
+    ok = historyHolds(path, 14, 21, "uncounted wrap") && ok;
+
+    // A corrupt capacity: the file is recreated at its own size, not grown to match
+    uint32_t capacity = 0x7FFFFFFF;
+    patchHistory(path, 12, &capacity, sizeof(capacity));
+    {
+        HistoryLog log;
+        struct stat info;
+        bool reopened = log.open(path, HISTORY_CAPACITY);
+        if (!reopened || log.count() != 0 || stat(path.c_str(), &info) != 0 ||
+            info.st_size != slotOffset(HISTORY_CAPACITY)) {
+            std::cerr << "History: corrupt capacity was not rejected" << std::endl;
+            ok = false;
+        }
+    }
+    unlink(path.c_str());
+
+    std::cout << "History log crash recovery: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+// A discharge (or charge) along a straight line: one sample every stepMs,
+// moving one percent each time
+void addLinearSamples(DrainModel& model, uint64_t startMs, uint64_t stepMs, int percent, int step,
+                      int samples, bool charging) {
+    for (int i = 0; i < samples; i++) {
+        BatterySample sample;
+        sample.timeMs = startMs + (uint64_t)i * stepMs;
+        sample.percent = (uint8_t)(percent + i * step);
+        sample.charging = charging;
+        model.add(sample);
+    }
+}
+
+bool nearMs(uint64_t ms, uint64_t expectedMs) {
+    return ms + 1000 >= expectedMs && ms <= expectedMs + 1000;
+}
+
+// SampleRing wrap-around, full and empty, and a producer/consumer thread pair
+// that must see every sample once, in order; DrainModel estimates on a known
+// linear discharge and charge, and none from too few samples
+bool benchSampleHistory() {
+    bool ok = true;
+    auto check = [&](bool condition, const char* what) {
+        if (!condition) {
+            std::cerr << "Sample history: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    SampleRing<uint32_t, 8> ring;
+    uint32_t value = 0;
+    check(ring.size() == 0 && !ring.pop(value), "new ring not empty");
+    for (uint32_t i = 0; i < 8; i++) {
+        check(ring.push(i), "push into a ring with room failed");
+    }
+    check(ring.size() == 8 && !ring.push(8) && ring.droppedCount() == 1, "full ring took a push");
+    for (uint32_t i = 0; i < 3; i++) {
+        check(ring.pop(value) && value == i, "pop out of order");
+    }
+    for (uint32_t i = 8; i < 11; i++) {
+        check(ring.push(i), "push after a pop failed");  // Wraps into slots 0..2
+    }
+    for (uint32_t i = 3; i < 11; i++) {
+        check(ring.pop(value) && value == i, "pop out of order across the wrap");
+    }
+    check(ring.size() == 0 && !ring.pop(value), "drained ring not empty");
+    for (uint32_t i = 0; i < 1000; i++) {
+        check(ring.push(i) && ring.pop(value) && value == i, "item lost over many wraps");
+    }
+
+    // Producer retries on full, as a lossless producer would; the consumer
+    // checks each sample is the next one and arrived whole
+    const uint64_t total = 1000000;
+    SampleRing<BatterySample, 64> samples;
+    std::thread producer([&]() {
+        for (uint64_t i = 0; i < total; i++) {
+            BatterySample sample;
+            sample.timeMs = i;
+            sample.percent = (uint8_t)(i % 101);
+            sample.latencyUs = (uint32_t)(i * 3);
+            while (!samples.push(sample)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+    uint64_t received = 0;
+    bool inOrder = true;
+    while (received < total) {
+        BatterySample sample;
+        if (!samples.pop(sample)) {
+            std::this_thread::yield();
+            continue;
+        }
+        inOrder = inOrder && sample.timeMs == received && sample.percent == received % 101 &&
+                  sample.latencyUs == (uint32_t)(received * 3);
+        received++;
+    }
+    producer.join();
+    BatterySample extra;
+    check(inOrder && !samples.pop(extra), "producer/consumer pair lost or reordered samples");
+
+    // Too few samples: no estimate
+    DrainModel model;
+    uint64_t ms = 0;
+    check(!model.timeToEmptyMs(ms) && !model.timeToFullMs(ms), "estimate from no samples");
+    addLinearSamples(model, 0, 360000, 80, 0, 1, false);
+    check(model.slopePercentPerHour() == 0.0 && !model.timeToEmptyMs(ms), "estimate from one sample");
+
+    // -1% every 6 minutes (10%/h), 80% down to 71%: 7.1 h left
+    model.reset();
+    addLinearSamples(model, 1700000000000ULL, 360000, 80, -1, 10, false);
+    check(model.slopePercentPerHour() > -10.001 && model.slopePercentPerHour() < -9.999, "wrong discharge slope");
+    check(model.timeToEmptyMs(ms) && nearMs(ms, 7100ULL * 3600), "wrong time to empty");
+    check(!model.timeToFullMs(ms), "time to full while discharging");
+
+    // Plugged in: the first charging sample starts over, so again no estimate
+    addLinearSamples(model, 1700003600000ULL, 180000, 71, 1, 1, true);
+    check(model.count() == 1 && !model.timeToFullMs(ms) && !model.timeToEmptyMs(ms),
+          "estimate right after a charging flip");
+
+    // +1% every 3 minutes (20%/h), 71% up to 80%: 1 h to full
+    addLinearSamples(model, 1700003780000ULL, 180000, 72, 1, 9, true);
+    check(model.timeToFullMs(ms) && nearMs(ms, 1000ULL * 3600), "wrong time to full");
+    check(!model.timeToEmptyMs(ms), "time to empty while charging");
+
+    // A window's worth of flat readings: not moving, no estimate
+    addLinearSamples(model, 1700010000000ULL, 60000, 90, 0, (int)DrainModel::CAPACITY, true);
+    check(!model.timeToFullMs(ms), "estimate from a flat line");
+
+    std::cout << "Sample ring and drain model: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+// MenuBarState as the app's title cache relies on it: every reading has its
+// own slot below READING_STATES, the tint follows the 20 % / 40 % thresholds,
+// equal states render the same title, and different readings do not
+bool benchMenuBarState() {
+    bool ok = true;
+    auto check = [&](bool condition, const char* what) {
+        if (!condition) {
+            std::cerr << "Menu bar state: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    std::vector<bool> used(MenuBarState::READING_STATES, false);
+    std::vector<std::string> titles;
+    for (unsigned percent = 0; percent <= 100; percent++) {
+        for (bool charging : {false, true}) {
+            MenuBarState state = MenuBarState::reading((uint8_t)percent, charging);
+            size_t index = state.readingIndex();
+            check(index < MenuBarState::READING_STATES && !used[index], "reading index out of range or shared");
+            if (index < used.size()) {
+                used[index] = true;
+            }
+
+            MenuBarState::Tint expected = percent <= 20 ? MenuBarState::TintRed :
+                                          percent <= 40 ? MenuBarState::TintYellow : MenuBarState::TintGreen;
+            check(state.tint() == expected, "wrong tint for a reading");
+
+            char title[64];
+            state.formatTitle(title, sizeof(title), false);
+            titles.push_back(title);
+        }
+        check(MenuBarState::stale((uint8_t)percent).tint() == MenuBarState::TintGray, "stale reading not gray");
+    }
+    check(std::count(used.begin(), used.end(), true) == (long)MenuBarState::READING_STATES,
+          "reading slots left unused");
+    std::sort(titles.begin(), titles.end());
+    check(std::unique(titles.begin(), titles.end()) == titles.end(), "two readings share a title");
+
+    // Out-of-range percent clamps to the 100 % state and its slot
+    check(MenuBarState::reading(150, true) == MenuBarState::reading(100, true) &&
+          MenuBarState::reading(150, true).readingIndex() == MenuBarState::READING_STATES - 1,
+          "reading above 100 % not clamped");
+    check(MenuBarState::of(MenuBarState::Error).tint() == MenuBarState::TintGray &&
+          MenuBarState::of(MenuBarState::Connecting).tint() == MenuBarState::TintNone &&
+          MenuBarState::of(MenuBarState::NotFound).tint() == MenuBarState::TintNone &&
+          MenuBarState::of(MenuBarState::Disconnected).tint() == MenuBarState::TintNone,
+          "wrong tint for a status");
+
+    // Equal states, built separately, format identically; unequal ones compare unequal
+    std::vector<MenuBarState> states;
+    for (MenuBarState::Kind kind : {MenuBarState::Connecting, MenuBarState::NotFound,
+                                    MenuBarState::Disconnected, MenuBarState::Error}) {
+        states.push_back(MenuBarState::of(kind));
+    }
+    for (unsigned percent = 0; percent <= 100; percent += 5) {
+        states.push_back(MenuBarState::reading((uint8_t)percent, false));
+        states.push_back(MenuBarState::reading((uint8_t)percent, true));
+        states.push_back(MenuBarState::stale((uint8_t)percent));
+    }
+    for (size_t i = 0; i < states.size(); i++) {
+        const MenuBarState& state = states[i];
+        MenuBarState copy = state.kind == MenuBarState::Reading ? MenuBarState::reading(state.percent, state.charging) :
+                            state.kind == MenuBarState::Stale ? MenuBarState::stale(state.percent) :
+                            MenuBarState::of(state.kind);
+        for (bool withEmoji : {false, true}) {
+            char first[64];
+            char second[64];
+            state.formatTitle(first, sizeof(first), withEmoji);
+            copy.formatTitle(second, sizeof(second), withEmoji);
+            check(copy == state && std::strcmp(first, second) == 0, "equal states format differently");
+        }
+        for (size_t j = i + 1; j < states.size(); j++) {
+            check(state != states[j], "different states compare equal");
+        }
+    }
+
+    std::cout << "Menu bar states: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+// A synthetic day against PollScheduler: 14 h of discharge at 6 %/h from
+// full, then the charger at 30 %/h and idle at 100 % until midnight. Polls
+// must stay within the policy bounds, land about 1 % apart while the level
+// moves, tighten below the low-battery threshold and back off once full.
+bool benchPollDay() {
+    const uint64_t hourMs = 3600000;
+    const uint64_t unplugMs = 14 * hourMs;
+    PollSchedulePolicy policy;
+    PollScheduler scheduler(policy);
+
+    bool ok = true;
+    auto check = [&](bool condition, const char* what) {
+        if (!condition) {
+            std::cerr << "Poll day: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    uint32_t polls = 0;
+    uint32_t steadyPolls = 0;
+    int steadyFirst = -1;
+    int steadyLast = -1;
+    uint32_t longestWhenFull = 0;
+    uint8_t lastPercent = 0;
+    for (uint64_t clockMs = 0; clockMs < 24 * hourMs; ) {
+        double hours = (double)clockMs / hourMs;
+        bool charging = clockMs >= unplugMs;
+        double level = charging ? std::min(100.0, 16.0 + 30.0 * (hours - 14.0)) : 100.0 - 6.0 * hours;
+        uint8_t percent = (uint8_t)level;  // The device reports whole percent
+
+        scheduler.addSample(clockMs, percent, charging);
+        uint32_t intervalMs = scheduler.nextIntervalMs();
+        polls++;
+
+        check(intervalMs >= policy.minIntervalMs && intervalMs <= policy.maxIntervalMs, "interval out of bounds");
+        if (!charging && hours >= 2.0 && percent > policy.lowBatteryPercent) {
+            // 6 %/h: 1 % every 10 minutes
+            check(intervalMs >= 480000 && intervalMs <= 720000, "discharge interval off 1 % per poll");
+            steadyFirst = steadyFirst < 0 ? percent : steadyFirst;
+            steadyLast = percent;
+            steadyPolls++;
+        }
+        if (!charging && percent <= policy.lowBatteryPercent) {
+            check(intervalMs <= policy.lowBatteryMaxIntervalMs, "no tightening below the low-battery threshold");
+        }
+        if (charging && scheduler.sampleCount() >= 5 && percent < 100) {
+            // 30 %/h: 1 % every 2 minutes, once a few readings settle the fit
+            check(intervalMs >= 90000 && intervalMs <= 150000, "charge interval off 1 % per poll");
+        }
+        if (charging && percent == 100 && lastPercent == 100) {
+            longestWhenFull = std::max(longestWhenFull, intervalMs);
+        }
+        lastPercent = percent;
+        clockMs += intervalMs;
+    }
+
+    double percentPerPoll = steadyPolls > 1 ? (double)(steadyFirst - steadyLast) / (steadyPolls - 1) : 0.0;
+    check(percentPerPoll >= 0.8 && percentPerPoll <= 1.25, "discharge polls not ~1 % apart");
+    check(longestWhenFull == policy.maxIntervalMs, "full battery did not back off to maxIntervalMs");
+    // ~80 at 10 min, ~20 at 2 min below 20 %, ~85 at 2 min on the charger, ~30 at 15 min when full
+    check(polls >= 180 && polls <= 280, "unexpected poll count for the day");
+
+    std::cout << "Poll schedule over a synthetic day: " << polls << " polls (fixed 30 s: "
+              << 24 * hourMs / 30000 << "), " << percentPerPoll << " % per poll while discharging" << std::endl;
+    return ok;
+}
+
+// Runs the attempt that is due and fails it at the furthest phase reached;
+// returns the delay until the retry (clock moved to the attempt's time)
+uint64_t failDueAttempt(ConnectionStateMachine& connection, uint64_t& clockMs, ConnectionState reached) {
+    clockMs = connection.nextAttemptAtMs();
+    if (!connection.beginAttemptIfDue(clockMs)) {
+        return UINT64_MAX;
+    }
+    connection.onAttemptFinished(reached, clockMs);
+    return connection.nextAttemptAtMs() - clockMs;
+}
+
+// Retry timing of ConnectionStateMachine on a virtual clock: immediate first
+// attempt, doubling backoff up to maxRetryMs, jitter within its band and
+// reproducible per seed, the short retry once a device was found, giving up
+// after giveUpAfterMs, cancel() while an attempt runs, and a loss during one
+bool benchConnectionRetries() {
+    bool ok = true;
+    auto check = [&](bool condition, const char* what) {
+        if (!condition) {
+            std::cerr << "Connection retries: " << what << std::endl;
+            ok = false;
+        }
+    };
+
+    ConnectionRetryPolicy exact;
+    exact.jitterPercent = 0;
+    const ConnectionState nothingFound = ConnectionState::Enumerating;
+
+    // First attempt at once, then 250, 500, ... capped at 10 s
+    ConnectionStateMachine backoff(exact);
+    uint64_t clockMs = 1000;
+    backoff.onDeviceMatched(clockMs);
+    check(backoff.hasPendingAttempt() && backoff.nextAttemptAtMs() == clockMs, "first attempt not immediate");
+    check(!backoff.beginAttemptIfDue(clockMs - 1), "attempt started early");
+    uint64_t expectedMs = exact.firstRetryMs;
+    for (int i = 0; i < 10; i++) {
+        check(failDueAttempt(backoff, clockMs, nothingFound) == expectedMs, "backoff did not double up to the cap");
+        expectedMs = std::min<uint64_t>(expectedMs * 2, exact.maxRetryMs);
+    }
+    check(backoff.attempts() == 10 && expectedMs == exact.maxRetryMs, "backoff never reached maxRetryMs");
+
+    // Found but not opened (or not switched): short retry, backoff left where it was
+    ConnectionStateMachine settling(exact);
+    clockMs = 0;
+    settling.onDeviceMatched(clockMs);
+    check(failDueAttempt(settling, clockMs, nothingFound) == 250 &&
+          failDueAttempt(settling, clockMs, nothingFound) == 500 &&
+          failDueAttempt(settling, clockMs, ConnectionState::Opening) == exact.firstRetryMs &&
+          failDueAttempt(settling, clockMs, ConnectionState::ModeSwitching) == exact.firstRetryMs &&
+          failDueAttempt(settling, clockMs, nothingFound) == 1000,
+          "Opening/ModeSwitching did not retry at firstRetryMs");
+
+    // Jitter: every delay within +/- jitterPercent of its base, not all on it,
+    // and the same seed gives the same schedule
+    ConnectionRetryPolicy jittered;
+    ConnectionStateMachine first(jittered, 42);
+    ConnectionStateMachine second(jittered, 42);
+    uint64_t firstClockMs = 0;
+    uint64_t secondClockMs = 0;
+    first.onDeviceMatched(0);
+    second.onDeviceMatched(0);
+    uint64_t baseMs = jittered.firstRetryMs;
+    bool spread = false;
+    for (int i = 0; i < 64; i++) {
+        uint64_t delayMs = failDueAttempt(first, firstClockMs, nothingFound);
+        uint64_t bandMs = baseMs * jittered.jitterPercent / 100;
+        check(delayMs >= baseMs - bandMs && delayMs <= baseMs + bandMs, "jitter outside its band");
+        check(failDueAttempt(second, secondClockMs, nothingFound) == delayMs, "same seed, different schedule");
+        spread = spread || delayMs != baseMs;
+        baseMs = std::min<uint64_t>(baseMs * 2, jittered.maxRetryMs);
+    }
+    check(spread, "jitter never moved a delay");
+
+    // Gives up (reports not found) once giveUpAfterMs has passed, keeps retrying,
+    // and a new match starts over
+    ConnectionStateMachine patient(exact);
+    clockMs = 0;
+    patient.onDeviceMatched(clockMs);
+    while (clockMs < exact.giveUpAfterMs) {
+        check(!patient.gaveUp(), "gave up early");
+        failDueAttempt(patient, clockMs, nothingFound);
+    }
+    check(patient.gaveUp() && patient.hasPendingAttempt(), "did not give up after giveUpAfterMs");
+    patient.onDeviceMatched(clockMs);
+    check(!patient.gaveUp() && patient.nextAttemptAtMs() == clockMs, "a new match did not start over");
+
+    // cancel() while an attempt runs: its failure schedules nothing, a success still lands
+    ConnectionStateMachine quitting(exact);
+    quitting.onDeviceMatched(0);
+    quitting.beginAttemptIfDue(0);
+    uint64_t generation = quitting.generation();
+    quitting.cancel();
+    quitting.onAttemptFinished(nothingFound, 10);
+    check(!quitting.hasPendingAttempt() && !quitting.beginAttemptIfDue(UINT64_MAX / 2) &&
+          quitting.generation() != generation && quitting.state() == ConnectionState::Disconnected,
+          "cancel() did not suppress the retry");
+    quitting.onDeviceMatched(20);
+    quitting.beginAttemptIfDue(20);
+    quitting.cancel();
+    quitting.onAttemptFinished(ConnectionState::Ready, 30);
+    check(quitting.state() == ConnectionState::Ready && !quitting.hasPendingAttempt(),
+          "an attempt finishing after cancel() was lost");
+
+    // Lost while an attempt runs: a Ready outcome is for a device that is gone,
+    // so the machine starts over at once instead of reporting Ready
+    ConnectionStateMachine unplugged(exact);
+    unplugged.onDeviceMatched(0);
+    unplugged.beginAttemptIfDue(0);
+    generation = unplugged.generation();
+    unplugged.onDeviceLost(5);
+    check(unplugged.attemptInFlight() && !unplugged.hasPendingAttempt(), "loss during an attempt started another");
+    unplugged.onAttemptFinished(ConnectionState::Ready, 10);
+    check(unplugged.state() == ConnectionState::Disconnected && unplugged.hasPendingAttempt() &&
+          unplugged.nextAttemptAtMs() == 10 && unplugged.generation() != generation,
+          "Ready after a loss during the attempt");
+    check(unplugged.beginAttemptIfDue(10), "no attempt after the lost one");
+    unplugged.onAttemptFinished(ConnectionState::Ready, 20);
+    check(unplugged.state() == ConnectionState::Ready, "the attempt after a loss did not connect");
+
+    std::cout << "Connection retry timing: " << (ok ? "ok" : "FAILED") << std::endl;
+    return ok;
+}
+
+// A receiver that stops answering mid-request: the watchdog must abort the
+// stuck send at 1.5 times the transfer timeout, the rest of the refresh must
+// fail at once, and a reconnect (clearDegraded) must bring the readings back
+bool benchWatchdog() {
+    const uint32_t timeoutMs = 50;
+    const uint32_t hungRefreshes = 5;
+
+    SimulatedRazerDevice device;
+    device.setBatteryRaw(0xB3);
+    TransferWatchdog watchdog;
+    WatchdogTransport transport(&device, &watchdog);
+    transport.setTransferTimeoutMs(timeoutMs);
+    RazerProtocol protocol(&transport);
+    transport.setStats(&protocol.transferStats());
+
+    const RazerCommand commands[] = {RazerProtocol::CMD_BATTERY, RazerProtocol::CMD_CHARGING};
+    bool ok = true;
+    double worstMs = 0;
+    double failFastMs = 0;
+    for (uint32_t i = 0; i < hungRefreshes; i++) {
+        device.setHangs(1);
+        RazerSnapshot snapshot;
+        auto start = std::chrono::steady_clock::now();
+        bool answered = protocol.queryAll(commands, 2, snapshot);
+        worstMs = std::max(worstMs, millisSince(start));
+
+        bool degraded = transport.isDegraded();
+        start = std::chrono::steady_clock::now();
+        answered = protocol.queryAll(commands, 2, snapshot) || answered;
+        failFastMs = std::max(failFastMs, millisSince(start));
+        if (answered || !degraded) {
+            std::cerr << "Hung refresh " << i << " was not cut short by the watchdog" << std::endl;
+            ok = false;
+        }
+
+        transport.clearDegraded();
+        if (!protocol.queryAll(commands, 2, snapshot) || !snapshot.batteryValid) {
+            std::cerr << "No reading after clearing the degraded link" << std::endl;
+            ok = false;
+        }
+    }
+
+    const TransferStats& stats = protocol.transferStats();
+    std::cout << "Transfer watchdog (" << timeoutMs << " ms timeout, " << hungRefreshes << " hung refreshes)"
+              << std::endl;
+    std::cout << "  worst hung refresh: " << worstMs << " ms, next refresh while degraded: " << failFastMs
+              << " ms" << std::endl;
+    std::cout << "  timeouts " << stats.timeouts() << ", watchdog aborts " << stats.watchdogAborts() << std::endl;
+    if (stats.timeouts() != hungRefreshes || stats.watchdogAborts() != hungRefreshes ||
+        watchdog.aborts() != hungRefreshes) {
+        std::cerr << "Watchdog counters do not match the hung refreshes" << std::endl;
+        ok = false;
+    }
+    // One deadline (1.5 x timeout) plus scheduling slack, never one per command
+    if (worstMs > timeoutMs * 1.5 + 40 || failFastMs > 5) {
+        std::cerr << "A hung refresh took longer than one watchdog deadline" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+#ifdef __linux__
+// mkdir -p, then the file
+bool writeFakeFile(const std::string& path, const std::string& text) {
+    for (size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+        mkdir(path.substr(0, slash).c_str(), 0755);
+    }
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+    bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+    return fclose(file) == 0 && ok;
+}
+
+// One USB interface with a HID device and its hidraw node, laid out like sysfs
+bool addFakeHidraw(const std::string& root, const std::string& usbDevice, uint8_t interfaceNumber,
+                   const char* hidId, const char* hidraw) {
+    char interfaceName[16];
+    snprintf(interfaceName, sizeof(interfaceName), ":1.%u", interfaceNumber);
+    char number[8];
+    snprintf(number, sizeof(number), "%02x\n", interfaceNumber);
+    std::string usbInterface = usbDevice + "/" + usbDevice.substr(usbDevice.rfind('/') + 1) + interfaceName;
+    std::string hid = usbInterface + "/" + hidId + "." + (hidraw + 6);
+    std::string node = hid + "/hidraw/" + hidraw;
+
+    std::string hidBusId(hidId, 4);
+    std::string uevent = "DRIVER=hid-generic\nHID_ID=" + hidBusId + ":0000" + std::string(hidId + 5, 4) + ":0000" +
+                         std::string(hidId + 10, 4) + "\nHID_NAME=Fake\n";
+    return writeFakeFile(root + usbInterface + "/bInterfaceNumber", number) &&
+           writeFakeFile(root + hid + "/uevent", uevent) &&
+           writeFakeFile(root + node + "/dev", "243:0\n") &&
+           symlink("../..", (root + node + "/device").c_str()) == 0 &&
+           writeFakeFile(root + "/class/hidraw/.keep", "") &&
+           symlink((".." + std::string("/..") + node).c_str(), (root + "/class/hidraw/" + hidraw).c_str()) == 0;
+}
+
+int removeFakeEntry(const char* path, const struct stat*, int, struct FTW*) {
+    return remove(path);
+}
+
+// Feature report ioctls of the fake hidraw node, answered by a simulated mouse
+SimulatedRazerDevice* fakeHidrawDevice = nullptr;
+
+int fakeHidrawIoctl(int, unsigned long request, void* argument) {
+    uint8_t* buffer = static_cast<uint8_t*>(argument);
+    if (request == HIDIOCSFEATURE(91)) {
+        return fakeHidrawDevice->sendReport(buffer + 1) ? 91 : -1;
+    }
+    if (request == HIDIOCGFEATURE(91)) {
+        return fakeHidrawDevice->readResponse(buffer + 1, 90) ? 91 : -1;
+    }
+    errno = ENOTTY;
+    return -1;
+}
+
+// Kernel uevent datagram: NUL-terminated header and KEY=value fields
+std::string ueventMessage(const std::vector<std::string>& fields) {
+    std::string message;
+    for (const std::string& field : fields) {
+        message += field;
+        message += '\0';
+    }
+    return message;
+}
+
+void sendUevent(int fd, const std::vector<std::string>& fields) {
+    std::string message = ueventMessage(fields);
+    if (send(fd, message.data(), message.size(), 0) != (ssize_t)message.size()) {
+        std::cerr << "Cannot write the fake uevent stream" << std::endl;
+    }
+}
+
+void collectDeviceEvent(void* context, const DeviceEvent& event) {
+    static_cast<std::vector<DeviceEvent>*>(context)->push_back(event);
+}
+
+// The Linux backend without a mouse: sysfs enumeration over a fake tree, the
+// hidraw feature report path against a simulated device (events through a
+// socket standing in for the node), and hotplug from a fake uevent stream
+bool benchHidraw() {
+    bool ok = true;
+    std::string root = "/tmp/razer-bench-" + std::to_string(getpid()) + "-sys";
+    const std::string pci = "/devices/pci0000:00/0000:00:14.0/usb1";
+    bool built = writeFakeFile(root + "/dev/hidraw0", "") && writeFakeFile(root + "/dev/hidraw2", "") &&
+                 writeFakeFile(root + "/dev/hidraw3", "") && writeFakeFile(root + "/dev/hidraw4", "") &&
+                 writeFakeFile(root + pci + "/1-3/1-3.1/serial", "PM2137H03201234\n") &&
+                 addFakeHidraw(root, pci + "/1-2", 0, "0003:1532:00A6", "hidraw0") &&       // Dongle, mouse input
+                 addFakeHidraw(root, pci + "/1-2", 2, "0003:1532:00A6", "hidraw2") &&       // Dongle, control
+                 addFakeHidraw(root, pci + "/1-3/1-3.1", 2, "0003:1532:00A5", "hidraw3") && // Cable behind a hub
+                 addFakeHidraw(root, pci + "/1-4", 0, "0003:046D:C52B", "hidraw4");         // Another vendor
+    std::vector<HidrawNode> nodes;
+    HidrawDevices::list(nodes, root, root + "/dev");
+    auto start = std::chrono::steady_clock::now();
+    const uint32_t listings = 1000;
+    for (uint32_t i = 0; i < listings; i++) {
+        HidrawDevices::list(nodes, root, root + "/dev");
+    }
+    double usPerListing = millisSince(start) * 1000.0 / listings;
+    nftw(root.c_str(), removeFakeEntry, 16, FTW_DEPTH | FTW_PHYS);
+
+    if (!built || nodes.size() != 3 ||
+        nodes[0].pid != 0x00A6 || nodes[0].interfaceNumber != 0 || nodes[0].locationId != 0x01200000 ||
+        nodes[1].pid != 0x00A6 || nodes[1].interfaceNumber != 2 || nodes[1].devNode != root + "/dev/hidraw2" ||
+        !nodes[1].serial.empty() ||
+        nodes[2].pid != 0x00A5 || nodes[2].locationId != 0x01310000 || nodes[2].serial != "PM2137H03201234") {
+        std::cerr << "Fake sysfs tree enumerated wrong: " << nodes.size() << " Razer nodes" << std::endl;
+        ok = false;
+    }
+
+    // Feature reports through the ioctl path; event reports through read()
+    SimulatedRazerDevice device;
+    device.setBatteryRaw(0xB3);
+    fakeHidrawDevice = &device;
+    int node[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, node) != 0) {
+        return false;
+    }
+    HidrawTransport transport(fakeHidrawIoctl);
+    transport.setDevice(node[0]);
+    RazerProtocol protocol(&transport);
+    std::mutex eventMutex;
+    std::condition_variable eventArrived;
+    RazerSnapshot events;
+    protocol.setEventHandler([&](const RazerEvent& event) {
+        std::lock_guard<std::mutex> lock(eventMutex);
+        RazerProtocol::applyEvent(event, events);
+        eventArrived.notify_all();
+    });
+    bool listening = protocol.startEvents();
+
+    const RazerCommand commands[] = {RazerProtocol::CMD_BATTERY, RazerProtocol::CMD_CHARGING};
+    const uint32_t queries = 200;
+    RazerSnapshot snapshot;
+    start = std::chrono::steady_clock::now();
+    bool answered = true;
+    for (uint32_t i = 0; i < queries; i++) {
+        answered = protocol.queryAll(commands, 2, snapshot) && answered;
+    }
+    double usPerQuery = millisSince(start) * 1000.0 / queries;
+
+    const uint8_t charging[16] = {RazerEventParser::REPORT_ID, RazerEventParser::TYPE_CHARGING, 0x01};
+    bool delivered = send(node[1], charging, sizeof(charging), 0) == (ssize_t)sizeof(charging);
+    {
+        std::unique_lock<std::mutex> lock(eventMutex);
+        delivered = eventArrived.wait_for(lock, std::chrono::seconds(1), [&]() { return events.chargingValid; }) &&
+                    delivered && events.isCharging;
+    }
+    protocol.stopEvents();
+    close(node[0]);
+    close(node[1]);
+    fakeHidrawDevice = nullptr;
+
+    if (!answered || !snapshot.batteryValid || snapshot.batteryPercent != 70 || !listening || !delivered) {
+        std::cerr << "hidraw transport lost a report: battery " << (unsigned)snapshot.batteryPercent
+                  << "%, event " << (delivered ? "delivered" : "missing") << std::endl;
+        ok = false;
+    }
+
+    // Hotplug: only whole USB devices of VID 1532 become events
+    int stream[2];
+    if (socketpair(AF_UNIX, SOCK_DGRAM, 0, stream) != 0) {
+        return false;
+    }
+    std::vector<DeviceEvent> changes;
+    RazerDeviceMonitor monitor;
+    monitor.startMonitoring(collectDeviceEvent, &changes, stream[0]);
+    const std::string dongle = pci + "/1-2";
+    sendUevent(stream[1], {"add@" + dongle, "ACTION=add", "DEVPATH=" + dongle, "SUBSYSTEM=usb",
+                           "DEVTYPE=usb_device", "PRODUCT=1532/a6/200", "BUSNUM=001", "DEVNUM=007", "SEQNUM=4100"});
+    sendUevent(stream[1], {"add@" + dongle + "/1-2:1.2", "ACTION=add", "DEVPATH=" + dongle + "/1-2:1.2",
+                           "SUBSYSTEM=usb", "DEVTYPE=usb_interface", "PRODUCT=1532/a6/200", "SEQNUM=4101"});
+    sendUevent(stream[1], {"add@" + dongle + "/1-2:1.2/0003:1532:00A6.0003/hidraw/hidraw2", "ACTION=add",
+                           "SUBSYSTEM=hidraw", "DEVNAME=hidraw2", "SEQNUM=4102"});
+    sendUevent(stream[1], {"libudev", "ACTION=add", "SUBSYSTEM=usb", "DEVTYPE=usb_device", "PRODUCT=1532/a6/200"});
+    sendUevent(stream[1], {"add@" + pci + "/1-4", "ACTION=add", "DEVPATH=" + pci + "/1-4", "SUBSYSTEM=usb",
+                           "DEVTYPE=usb_device", "PRODUCT=46d/c52b/1211", "SEQNUM=4103"});
+    sendUevent(stream[1], {"remove@" + dongle, "ACTION=remove", "DEVPATH=" + dongle, "SUBSYSTEM=usb",
+                           "DEVTYPE=usb_device", "PRODUCT=1532/a6/200", "SEQNUM=4104"});
+
+    epoll_event ready;
+    bool woke = epoll_wait(monitor.fileDescriptor(), &ready, 1, 1000) == 1;
+    monitor.dispatch();
+    monitor.stopMonitoring();
+    close(stream[1]);
+
+    if (!woke || changes.size() != 2 || !changes[0].added || changes[0].pid != 0x00A6 ||
+        changes[0].locationId != 0x01200000 || changes[1].added || changes[1].locationId != 0x01200000 ||
+        classifyDeviceEvent(changes[0], false, 0, 0) != DeviceEventAction::Reconnect ||
+        classifyDeviceEvent(changes[1], true, 0x00A6, 0x01200000) != DeviceEventAction::Reconnect) {
+        std::cerr << "Fake uevent stream produced " << changes.size() << " device events" << std::endl;
+        ok = false;
+    }
+
+    std::string uevent = ueventMessage({"add@" + dongle, "ACTION=add", "DEVPATH=" + dongle, "SUBSYSTEM=usb",
+                                        "DEVTYPE=usb_device", "PRODUCT=1532/a6/200", "SEQNUM=4105"});
+    DeviceEvent parsed;
+    double nsPerUevent = nanosPerOp([&](uint32_t) {
+        sink = HidrawDevices::parseUevent(uevent.data(), uevent.size(), parsed) ? 1 : 0;
+    });
+
+    std::cout << "Linux hidraw backend (fake sysfs tree and uevent stream)" << std::endl;
+    std::cout << "  sysfs enumeration: " << usPerListing << " us (" << nodes.size() << " Razer nodes)" << std::endl;
+    std::cout << "  query cycle over hidraw ioctls: " << usPerQuery << " us" << std::endl;
+    printRow("uevent parse", nsPerUevent);
+    return ok;
+}
+#endif
+
+// The regression suite: median, p99 and allocations per op for the paths every
+// refresh runs, from report bytes up to the published status. The query and
+// reconnect cases talk to a simulated device answering after latencyUs.
+bool benchSuite(const BenchOptions& options, uint32_t latencyUs) {
+    BenchSuite suite(options);
+    std::cout << "Suite (" << options.samples << " samples, device latency " << latencyUs << " us)" << std::endl;
+
+    const RazerCommand commands[] = {
+        RazerProtocol::CMD_BATTERY,
+        RazerProtocol::CMD_CHARGING,
+        RazerProtocol::CMD_DPI,
+        RazerProtocol::CMD_FIRMWARE
+    };
+    suite.run("build request + checksum", [&](uint64_t i) {
+        RazerReport report = RazerProtocol::requestFor(commands[i & 3]);
+        report.setTransactionId(0x1F);
+        report.bytes[RazerReportLayout::ARGS] = (uint8_t)i;
+        RazerProtocol::calculateChecksum(report.bytes);
+        sink = report.bytes[RazerReportLayout::CHECKSUM];
+    });
+
+    RazerReport answer = RazerReportBuilder()
+        .status(0x02)
+        .transactionId(0x1F)
+        .command(RazerProtocol::CMD_BATTERY)
+        .arg(1, 0xB3)
+        .build();
+    suite.run("verify checksum + parse response", [&](uint64_t i) {
+        answer.bytes[RazerReportLayout::RESERVED] = (uint8_t)i;
+        sink = (uint8_t)(RazerProtocol::verifyChecksum(answer.data()) + parseView(answer.data()));
+    });
+
+    // Supported and unsupported PIDs mixed, as the hotplug enumeration sees them
+    uint16_t pids[64];
+    for (size_t i = 0; i < 64; i++) {
+        pids[i] = i % 2 == 0 ? RAZER_SUPPORTED_DEVICES[i / 2 % RAZER_NUM_SUPPORTED_DEVICES].wirelessPid
+                             : (uint16_t)(0x0100 + i * 37);
+    }
+    suite.run("PID lookup", [&](uint64_t i) {
+        RazerDeviceMatch match = RazerDeviceTable::find(pids[i & 63]);
+        sink = match.device != nullptr ? match.tableIndex : 0xFF;
+    });
+
+    SimulatedRazerDevice device;
+    SimulatedCommandConfig timing;
+    timing.latencyUs = latencyUs;
+    device.setDefaultCommand(timing);
+    device.setBatteryRaw(0xB3);
+    RazerProtocol protocol(&device);
+    const RazerCommand refresh[] = {RazerProtocol::CMD_BATTERY, RazerProtocol::CMD_CHARGING};
+    bool queriesOk = true;
+    suite.run("query cycle (battery + charging)", [&](uint64_t) {
+        RazerSnapshot snapshot;
+        queriesOk = protocol.queryAll(refresh, 2, snapshot) && snapshot.batteryValid && queriesOk;
+    });
+
+    // Unplug and re-plug: the device comes back in normal mode and the connect
+    // path of RazerDevice::openDevice runs again (minus the IOKit enumeration)
+    const uint16_t pid = RAZER_SUPPORTED_DEVICES[0].wirelessPid;
+    ConnectionStateMachine connection;
+    uint64_t clockMs = 0;
+    bool reconnectOk = true;
+    protocol.setEventHandler([](const RazerEvent&) {});
+    suite.run("reconnect after hotplug", [&](uint64_t) {
+        protocol.stopEvents();
+        device.setOpen(false);
+        device.setDeviceMode(0x00);
+        connection.onDeviceLost(clockMs);
+
+        clockMs += 1000;
+        device.setOpen(true);
+        connection.onDeviceMatched(clockMs);
+        if (!connection.beginAttemptIfDue(clockMs)) {
+            reconnectOk = false;
+            return;
+        }
+        RazerDeviceMatch match = RazerDeviceTable::find(pid);
+        protocol.setProfile(RazerDeviceTable::profileFor(*match.device));
+        uint8_t mode = 0;
+        bool ready = (protocol.queryDeviceMode(mode) && mode == RazerProtocol::DRIVER_MODE) ||
+                     protocol.setDeviceMode(RazerProtocol::DRIVER_MODE, 0x00);
+        protocol.startEvents();
+        connection.onAttemptFinished(ready ? ConnectionState::Ready : ConnectionState::ModeSwitching, clockMs);
+        reconnectOk = reconnectOk && ready && connection.state() == ConnectionState::Ready;
+    });
+    protocol.stopEvents();
+
+    PollScheduler scheduler;
+    uint32_t intervalSum = 0;
+    suite.run("poll schedule (sample + next interval)", [&](uint64_t i) {
+        if (i % 64 == 0) {
+            scheduler.reset();
+        }
+        scheduler.addSample(i * 300000, (uint8_t)(100 - i % 64), false);
+        intervalSum += scheduler.nextIntervalMs();
+    });
+    sink = (uint8_t)intervalSum;
+
+    // What every refresh result costs before the menu bar / socket sees it
+    StatusServer server;
+    DrainModel model;
+    DeviceStatus status;
+    status.id = 1;
+    status.pid = pid;
+    status.name = RAZER_SUPPORTED_DEVICES[0].name;
+    DeviceJobResult result;
+    result.connected = true;
+    result.ok = true;
+    result.pid = pid;
+    result.snapshot.batteryValid = true;
+    result.snapshot.chargingValid = true;
+    suite.run("status update + publish", [&](uint64_t i) {
+        uint8_t percent = (uint8_t)(100 - i % 100);
+        if (percent == 100) {
+            model.reset();
+        }
+        BatterySample sample;
+        sample.timeMs = 1760600000000ull + i * 60000;
+        sample.percent = percent;
+        model.add(sample);
+        result.snapshot.batteryPercent = percent;
+        updateDeviceStatus(status, result, model, sample.timeMs);
+        server.publish(status);
+    });
+
+    bool ok = queriesOk && reconnectOk;
+    if (!queriesOk) {
+        std::cerr << "Query cycle against the simulated device failed" << std::endl;
+    }
+    if (!reconnectOk) {
+        std::cerr << "Reconnect after hotplug did not reach Ready" << std::endl;
+    }
+    // The per-report paths must stay allocation free
+    for (const BenchResult& measured : suite.results()) {
+        bool hot = measured.name == "build request + checksum" ||
+                   measured.name == "verify checksum + parse response" || measured.name == "PID lookup";
+        if (hot && measured.allocsPerOp != 0) {
+            std::cerr << measured.name << " allocates " << measured.allocsPerOp << " times per op" << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+// One simulated mouse for the discovery sweep: refuses unknown commands with
+// 0x05 like the real ones, plus one slow command in class 0x0F
+struct DiscoverySubject {
+    SimulatedRazerDevice device;
+    uint8_t transactionId;
+
+    explicit DiscoverySubject(uint8_t id) : device(id), transactionId(id) {
+        device.setTransactionId(id);
+        device.setUnknownStatus(0x05);
+        SimulatedCommandConfig slow;
+        slow.latencyUs = 12000;  // Beyond the first deadline: answered on a retry
+        device.setCommand(0x0F, 0x80, slow);
+    }
+};
+
+bool checkCapabilities(const RazerCapabilities& capabilities, uint8_t transactionId) {
+    const uint16_t expected[] = {0x0081, 0x0084, 0x0485, 0x0780, 0x0783, 0x0784, 0x0F80};
+    bool ok = capabilities.transactionId == transactionId &&
+              capabilities.commands.size() == sizeof(expected) / sizeof(expected[0]);
+    for (uint16_t command : expected) {
+        ok = ok && capabilities.supports((uint8_t)(command >> 8), (uint8_t)command);
+    }
+    if (!ok) {
+        std::cerr << "Discovered " << capabilities.commands.size() << " commands on transaction 0x" << std::hex
+                  << (int)capabilities.transactionId << ", expected 0x" << (int)transactionId << std::dec << std::endl;
+    }
+    return ok;
+}
+
+// Transfers of the first battery + charging query after connect with profile
+uint32_t firstQueryTransfers(SimulatedRazerDevice& device, const RazerProtocolProfile& profile) {
+    RazerProtocol protocol(&device);
+    protocol.setProfile(profile);
+    const RazerCommand batch[] = {RazerProtocol::CMD_BATTERY, RazerProtocol::CMD_CHARGING};
+    RazerSnapshot snapshot;
+    bool ok = protocol.queryAll(batch, 2, snapshot) && snapshot.batteryValid && snapshot.chargingValid;
+    return ok ? snapshot.transfers : 0;
+}
+
+// Maps the capability files of a dongle and its cable at startup, then checks
+// that the first query after connect needs no fallback probe
+bool benchCapabilityFiles(const std::string& dir, const RazerCapabilities& dongle) {
+    // The Mamba Wireless dongle is listed on 0x3F; this one answers on 0x1F
+    RazerCapabilities mamba = dongle;
+    mamba.pid = 0x0072;
+    mamba.describe(RazerDeviceTable::find(0x0072));
+
+    // Its cable refuses the battery get: full and charging whenever connected
+    RazerCapabilities cable;
+    cable.pid = 0x0073;
+    cable.describe(RazerDeviceTable::find(0x0073));
+    std::vector<DiscoveryRecord> records(2);
+    records[0] = {DISCOVERY_COMMAND, 0x1F, 0x00, 0x81, 0x00, 0x02, DISCOVERY_HAS_DATA, 1, 3000};
+    records[1] = {DISCOVERY_COMMAND, 0x1F, 0x07, 0x80, 0x04, 0x00, 0, 1, 3000};
+    cable.merge(records);
+
+    bool ok = CapabilityDatabase::save(dir, mamba) && CapabilityDatabase::save(dir, cable);
+    CapabilityDatabase database;
+    auto start = std::chrono::steady_clock::now();
+    ok = database.loadDirectory(dir) && database.size() == 3 && ok;
+    double loadMs = millisSince(start);
+
+    const int lookups = 1000000;
+    size_t hits = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookups; i++) {
+        hits += database.find((uint16_t)(0x0072 + (i & 1))) != nullptr ? 1 : 0;
+    }
+    double nsPerLookup = millisSince(start) * 1000000.0 / lookups;
+
+    const RazerCapabilityView* dongleView = database.find(0x00A6);
+    const RazerCapabilityView* mambaView = database.find(0x0072);
+    const RazerCapabilityView* cableView = database.find(0x0073);
+    ok = hits == (size_t)lookups && dongleView != nullptr && mambaView != nullptr && cableView != nullptr && ok;
+    if (!ok) {
+        std::cerr << "Capability files did not map" << std::endl;
+        return false;
+    }
+    std::cout << "  capability files: " << dongleView->size() << " commands in "
+              << sizeof(RazerCapabilityHeader) + dongleView->size() * sizeof(RazerCapability) << " bytes, "
+              << database.size() << " mapped in " << loadMs << " ms, " << nsPerLookup << " ns per lookup"
+              << std::endl;
+
+    SimulatedRazerDevice device;
+    device.setTransactionId(0x1F);
+    RazerProtocolProfile guessed = RazerDeviceTable::profileFor(*RazerDeviceTable::find(0x0072).device);
+    RazerProtocolProfile known = guessed;
+    mambaView->applyTo(known);
+    uint32_t guessedTransfers = firstQueryTransfers(device, guessed);
+    uint32_t knownTransfers = firstQueryTransfers(device, known);
+    std::cout << "  first query after connect: " << guessedTransfers << " transfers from the table, "
+              << knownTransfers << " from the capability file" << std::endl;
+    if (knownTransfers != 2 || guessedTransfers <= knownTransfers || !mambaView->isWireless() ||
+        known.notSupportedMeansWired) {
+        std::cerr << "Capability file did not replace the transaction ID probe" << std::endl;
+        ok = false;
+    }
+
+    const RazerCommand refresh[] = {RazerProtocol::CMD_BATTERY, RazerProtocol::CMD_CHARGING,
+                                    RazerProtocol::CMD_IDLE_TIME, RazerProtocol::CMD_FIRMWARE};
+    RazerCommand batch[4];
+    RazerSnapshot snapshot;
+    size_t cableCount = cableView->planBatch(refresh, 4, batch, 4, snapshot);
+    bool cableAnswered = cableCount == 1 && batch[0].cmdId == RazerProtocol::CMD_FIRMWARE.cmdId &&
+                         snapshot.batteryValid && snapshot.batteryPercent == 100 &&
+                         snapshot.chargingValid && snapshot.isCharging;
+    RazerSnapshot dongleSnapshot;
+    size_t dongleCount = dongleView->planBatch(refresh, 4, batch, 4, dongleSnapshot);
+    std::cout << "  refresh batch: " << dongleCount << " of 4 commands on the dongle, " << cableCount
+              << " on the cable" << std::endl;
+    if (!cableAnswered || cableView->isWireless() || cableView->hasBattery() || dongleCount != 4 ||
+        dongleSnapshot.batteryValid) {
+        std::cerr << "Capability file did not plan the refresh batch" << std::endl;
+        ok = false;
+    }
+
+    unlink((dir + "/" + CapabilityDatabase::fileName(0x0072)).c_str());
+    unlink((dir + "/" + CapabilityDatabase::fileName(0x0073)).c_str());
+    return ok;
+}
+
+// Sweeps three simulated mice (transaction IDs 0x1F, 0x3F, 0xFF) at once, then
+// interrupts a sweep, resumes it from its checkpoint and round-trips the
+// capability file
+bool benchDiscovery() {
+    DiscoveryOptions options;
+    options.firstClass = 0x00;
+    options.lastClass = 0x0F;
+    options.firstDeadlineUs = 5000;
+    const uint8_t transactionIds[] = {0x1F, 0x3F, 0xFF};
+    std::string dir = "/tmp/razer-bench-caps-" + std::to_string(getpid());
+    mkdir(dir.c_str(), 0755);
+
+    std::vector<std::unique_ptr<DiscoverySubject>> subjects;
+    std::vector<std::unique_ptr<DiscoveryEngine>> engines;
+    std::vector<double> sweepMs(3);
+    std::vector<std::thread> threads;
+    std::atomic<bool> completed(true);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 3; i++) {
+        subjects.emplace_back(new DiscoverySubject(transactionIds[i]));
+        engines.emplace_back(new DiscoveryEngine());
+        threads.emplace_back([&, i]() {
+            auto own = std::chrono::steady_clock::now();
+            if (!engines[i]->run(subjects[i]->device, options)) {
+                completed = false;
+            }
+            sweepMs[i] = millisSince(own);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double parallelMs = millisSince(start);
+
+    bool ok = completed.load();
+    uint64_t probes = 0;
+    uint64_t retried = 0;
+    size_t skipped = 0;
+    for (size_t i = 0; i < 3; i++) {
+        RazerCapabilities capabilities;
+        capabilities.pid = (uint16_t)(0x00A6 + i);
+        capabilities.merge(engines[i]->records());
+        ok = checkCapabilities(capabilities, transactionIds[i]) && ok;
+        probes += engines[i]->probesSent();
+        for (const DiscoveryRecord& record : engines[i]->records()) {
+            retried += record.attempts > 1 ? 1 : 0;
+            skipped += record.kind == DISCOVERY_SKIP_CLASS ? 1 : 0;
+        }
+    }
+    double serialMs = sweepMs[0] + sweepMs[1] + sweepMs[2];
+    std::cout << "Discovery (classes 0x00-0x0F, ids 0x80-0xFF, all transaction IDs)" << std::endl;
+    std::cout << "  3 devices in parallel: " << parallelMs << " ms (" << serialMs << " ms of sweeps, "
+              << probes / 3 << " probes per device, " << (probes != 0 ? serialMs * 1000.0 / probes : 0.0)
+              << " us/probe)" << std::endl;
+    std::cout << "  classes skipped after 16 x 0x05: " << skipped / 3 << " per device, busy retries: "
+              << retried << std::endl;
+    if (skipped != 3 * 12 || retried < 3) {
+        std::cerr << "Expected 12 skipped classes and a retried slow command per device" << std::endl;
+        ok = false;
+    }
+
+    // Interrupted after 300 probes, resumed by a new engine from the checkpoint
+    std::string checkpoint = dir + "/discover.ckpt";
+    DiscoverySubject subject(0x1F);
+    uint64_t firstRun = 0;
+    {
+        DiscoveryEngine interrupted;
+        DiscoveryOptions partial = options;
+        partial.maxProbes = 300;
+        ok = interrupted.openCheckpoint(checkpoint, 0x00A6) && !interrupted.run(subject.device, partial) && ok;
+        firstRun = interrupted.probesSent();
+    }
+    DiscoveryEngine resumed;
+    ok = resumed.openCheckpoint(checkpoint, 0x00A6) && resumed.run(subject.device, options) && ok;
+    RazerCapabilities capabilities;
+    capabilities.pid = 0x00A6;
+    capabilities.merge(resumed.records());
+    ok = checkCapabilities(capabilities, 0x1F) && ok;
+    std::cout << "  resumed after " << resumed.resumedRecords() << " checkpointed probes: "
+              << firstRun + resumed.probesSent() << " probes in total" << std::endl;
+    if (resumed.resumedRecords() == 0 || firstRun + resumed.probesSent() > probes / 3 + 8) {
+        std::cerr << "Resume repeated finished probes" << std::endl;
+        ok = false;
+    }
+    DiscoveryEngine wrongPid;
+    if (wrongPid.openCheckpoint(checkpoint, 0x007D)) {
+        std::cerr << "Checkpoint of another PID was accepted" << std::endl;
+        ok = false;
+    }
+    unlink(checkpoint.c_str());
+
+    capabilities.describe(RazerDeviceTable::find(0x00A6));
+    RazerCapabilities loaded;
+    ok = CapabilityDatabase::save(dir, capabilities) &&
+         CapabilityDatabase::load(dir + "/" + CapabilityDatabase::fileName(0x00A6), loaded) &&
+         checkCapabilities(loaded, 0x1F) && loaded.flags == CAPABILITY_WIRELESS && ok;
+    ok = benchCapabilityFiles(dir, capabilities) && ok;
+    unlink((dir + "/" + CapabilityDatabase::fileName(0x00A6)).c_str());
+    rmdir(dir.c_str());
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    BenchOptions options;
+    uint32_t latencyUs = 0;
+    bool suiteOnly = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--suite") == 0) {
+            suiteOnly = true;
+        } else if (std::strcmp(argv[i], "--latency") == 0 && i + 1 < argc) {
+            latencyUs = (uint32_t)std::max(0, atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc) {
+            options.samples = (uint32_t)std::max(1, atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--suite] [--latency US] [--samples N] [--filter NAME]" << std::endl;
+            return 2;
+        }
+    }
+    if (suiteOnly) {
+        return benchSuite(options, latencyUs) ? 0 : 1;
+    }
+
+    const RazerCommand commands[] = {
+        RazerProtocol::CMD_BATTERY,
+        RazerProtocol::CMD_CHARGING,
+        RazerProtocol::CMD_DPI,
+        RazerProtocol::CMD_FIRMWARE
+    };
+    const uint32_t commandCount = sizeof(commands) / sizeof(commands[0]);
+
+    std::cout << "Build request (" << ITERATIONS << " iterations)" << std::endl;
+    printRow("legacy memset + runtime checksum", nanosPerOp([&](uint32_t i) {
+        uint8_t report[90];
+        buildLegacy(report, 0x1F, commands[i % commandCount]);
+        sink = report[88];
+    }));
+    printRow("RazerProtocol::requestFor template", nanosPerOp([&](uint32_t i) {
+        RazerReport report = RazerProtocol::requestFor(commands[i % commandCount]);
+        report.setTransactionId(0x1F);
+        sink = report.bytes[RazerReportLayout::CHECKSUM];
+    }));
+
+    // A realistic answer to parse: DPI 800/800 with data-ready status
+    RazerReport response = RazerReportBuilder()
+        .status(0x02)
+        .transactionId(0x1F)
+        .command(RazerProtocol::CMD_DPI)
+        .arg(1, 0x03).arg(2, 0x20).arg(3, 0x03).arg(4, 0x20)
+        .build();
+
+    std::cout << "Parse response (" << ITERATIONS << " iterations)" << std::endl;
+    printRow("legacy copy + offsets", nanosPerOp([&](uint32_t i) {
+        response.bytes[RazerReportLayout::RESERVED] = (uint8_t)i;
+        sink = (uint8_t)parseLegacy(response.data());
+    }));
+    printRow("RazerResponseView", nanosPerOp([&](uint32_t i) {
+        response.bytes[RazerReportLayout::RESERVED] = (uint8_t)i;
+        sink = (uint8_t)parseView(response.data());
+    }));
+
+    // Both paths must produce the same wire bytes
+    for (uint32_t i = 0; i < commandCount; i++) {
+        uint8_t legacy[90];
+        buildLegacy(legacy, 0x3F, commands[i]);
+        RazerReport report = RazerProtocol::requestFor(commands[i]);
+        report.setTransactionId(0x3F);
+        if (std::memcmp(legacy, report.data(), sizeof(legacy)) != 0) {
+            std::cerr << "Mismatch for command " << i << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "Wire bytes identical for all " << commandCount << " commands" << std::endl;
+
+    bool ok = benchSuite(options, latencyUs);
+    ok = benchParallelRefresh() && ok;
+    ok = benchStatusQuery() && ok;
+    ok = benchSharedStatus() && ok;
+    ok = benchEventDispatch() && ok;
+    ok = benchTransferStats() && ok;
+    ok = benchTraceReplay() && ok;
+    ok = benchMenuBarState() && ok;
+    ok = benchPollDay() && ok;
+    ok = benchSampleHistory() && ok;
+    ok = benchConnectionRetries() && ok;
+    ok = benchHistoryLog() && ok;
+    ok = benchWatchdog() && ok;
+#ifdef __linux__
+    ok = benchHidraw() && ok;
+#endif
+    ok = benchDiscovery() && ok;
+    return ok ? 0 : 1;
+}
@@ -3,80 +3,151 @@
 
 #include <cstdint>
 #include <string>
+#ifdef __APPLE__
 #include <CoreFoundation/CoreFoundation.h>
 #include <IOKit/IOKitLib.h>
 #include <IOKit/usb/IOUSBLib.h>
 #include <IOKit/IOCFPlugIn.h>
+#include "IOKitTransport.hpp"
+#else
+#include "HidrawTransport.hpp"
+#endif
+#include "TransferWatchdog.hpp"
+#include "RazerProtocol.hpp"
+#include "RazerTrace.hpp"
+#include "RazerDeviceTable.hpp"
+#include "DeviceEvents.hpp"
+#include "ConnectionStateMachine.hpp"
 
-// Callback type for device change events
-typedef void (*DeviceCallback)(void* context);
-
-// Supported Razer wireless mouse device information
-struct RazerSupportedDevice {
-    uint16_t wirelessPid;
-    uint16_t wiredPid;
-    const char* name;
-};
+class CapabilityDatabase;
+struct RazerCapabilityView;
 
+// One Razer mouse (or its dongle) and the protocol session on it. The
+// protocol logic here is portable; finding and opening interface 2 is per
+// platform: IOKit in RazerDeviceIOKit.cpp, hidraw in RazerDeviceLinux.cpp.
 class RazerDevice {
 public:
     RazerDevice();
     ~RazerDevice();
     
-    bool connect();
+    // Opens the supported device with this PID at this USB location (0 = any;
+    // with several candidates the earliest table entry wins, wireless first)
+    bool connect(uint16_t pid = 0, uint32_t locationId = 0);
     void disconnect();
     bool queryBattery(uint8_t& batteryPercent);
     bool queryChargingStatus(bool& isCharging);
-    bool isConnected() const { return usbInterface_ != nullptr; }
     
-    // Hotplug monitoring
-    void startMonitoring(DeviceCallback callback, void* context);
-    void stopMonitoring();
+    // Batch query: runs commands back to back into one snapshot (see RazerProtocol::queryAll)
+    bool queryAll(const RazerCommand* commands, size_t count, RazerSnapshot& snapshot);
+    bool isConnected() const { return transport_.isOpen(); }
+    
+    // Open device identity, used to classify hotplug events (0 when disconnected)
+    uint16_t connectedPid() const { return connectedPid_; }
+    uint32_t connectedLocationId() const { return connectedLocationId_; }
+    
+    // Furthest phase the last connect() reached (Ready when connected)
+    ConnectionState connectPhase() const { return connectPhase_; }
+    
+    // Cheap liveness probe: one command round trip on the open interface
+    bool isAlive();
+    
+    // A transfer ran into its deadline (or the watchdog aborted it) since the
+    // last connect; every transfer fails at once until the device is
+    // disconnected and connected again
+    bool isDegraded() const { return watchdog_.isDegraded(); }
+    
+    // Event reports from the interrupt pipe, started on every connect. The
+    // handler runs on the main run loop (the hidraw reader thread on Linux),
+    // not the worker; set it before connect().
+    void setEventHandler(RazerProtocol::EventHandler handler) { protocol_.setEventHandler(handler); }
+    bool eventsActive() const { return protocol_.eventsActive(); }
+    
+    // Learned command turnaround for this device (0 until the first response)
+    uint32_t typicalTurnaroundUs() const { return protocol_.typicalTurnaroundUs(); }
+    
+    // Transaction ID the device currently answers on
+    uint8_t transactionId() const { return protocol_.profile().transactionId; }
+    
+    // Per-phase / per-command latency histograms, kept across reconnects.
+    // Recorded on the worker; safe to export from any thread.
+    const TransferStats& transferStats() const { return protocol_.transferStats(); }
+    
+    // Report transport of the open device, for tools that send their own
+    // commands (RazerDiscover). Worker thread only, like every command.
+    RazerTransport* transport() const { return protocol_.transport(); }
+    
+    // Capabilities found by RazerDiscover, shared by every instance. Set once
+    // before the first connect. A PID listed there connects with the file's
+    // transaction ID, response layout, link type and turnaround instead of the
+    // table's guesses, and refreshes skip the commands it does not answer.
+    static void setCapabilities(const CapabilityDatabase* capabilities) { capabilities_ = capabilities; }
+    
+    // Records every report to and from the device (and each connect's protocol
+    // profile) into a RazerTrace file, for replay without the mouse. Call before
+    // the first connect or from the worker: not while a command is in flight.
+    bool startTrace(const std::string& path);
+    void stopTrace();
+    
+#ifdef __APPLE__
+    // IOKit registry properties of a USB device service (0 if missing)
+    static uint16_t getProductId(io_service_t device);
+    static uint32_t getLocationId(io_service_t device);
+#endif
 
 private:
-    static constexpr uint16_t VENDOR_ID = 0x1532;
+    static constexpr uint16_t VENDOR_ID = RazerDeviceTable::VENDOR_ID;
     static constexpr uint16_t PRODUCT_ID_DONGLE = 0x00A6;  // Wireless Dongle
     static constexpr uint16_t PRODUCT_ID_WIRED = 0x00A5;   // Wired Mouse (Charging)
-    static constexpr size_t REPORT_SIZE = 90;
-    static constexpr uint8_t TARGET_INTERFACE = 2;  // Interface 2 for control
-    
-    // USB HID Request types
-    static constexpr uint8_t USB_TYPE_CLASS = 0x01 << 5;
-    static constexpr uint8_t USB_RECIP_INTERFACE = 0x01;
-    static constexpr uint8_t USB_DIR_OUT = 0x00;
-    static constexpr uint8_t USB_DIR_IN = 0x80;
-    static constexpr uint8_t HID_REQ_SET_REPORT = 0x09;
-    static constexpr uint8_t HID_REQ_GET_REPORT = 0x01;
-    
-    IOUSBInterfaceInterface** usbInterface_;
+    static constexpr uint8_t TARGET_INTERFACE = RazerDeviceTable::CONTROL_INTERFACE;  // Interface 2 for control
+    
+#ifdef __APPLE__
+    IOUSBInterfaceInterface182** usbInterface_;
     io_service_t interfaceService_;
+#else
+    int hidrawFd_;  // Interface 2's /dev/hidrawN
+#endif
     
     // Wired vs. Wireless detection
     bool isDongle_;  // true = Wireless (Dongle), false = Wired (Direct USB)
     std::string deviceName_;  // Human-readable device name
-    std::string getDeviceName(io_service_t device);
     std::string getDeviceNameByPid(uint16_t pid);
+#ifdef __APPLE__
+    std::string getDeviceName(io_service_t device);
+#endif
     
-    // Supported devices list
-    static const RazerSupportedDevice SUPPORTED_DEVICES[];
-    static const size_t NUM_SUPPORTED_DEVICES;
+    // Report protocol runs over IOKit control transfers on usbInterface_
+    // (hidraw feature reports on Linux), each under a deadline backed by the
+    // shared TransferWatchdog
+#ifdef __APPLE__
+    IOKitTransport transport_;
+#else
+    HidrawTransport transport_;
+#endif
+    WatchdogTransport watchdog_;
+    RazerTraceWriter trace_;
+    TracingTransport tracing_;  // Wraps watchdog_ while a trace is open
+    RazerProtocol protocol_;
+    uint16_t profilePid_;  // PID the current protocol profile was learned on
+    const RazerCapabilityView* knownCapabilities_;  // Entry of the open PID in capabilities_, if any
+    uint16_t connectedPid_;
+    uint32_t connectedLocationId_;
+    ConnectionState connectPhase_;
     
-    // IOKit notification members
-    IONotificationPortRef notificationPort_;
-    io_iterator_t addedIter_;
-    io_iterator_t removedIter_;
-    DeviceCallback callback_;
-    void* callbackContext_;
+    static const CapabilityDatabase* capabilities_;
     
-    void calculateChecksum(uint8_t* report);
-    bool sendReport(const uint8_t* report);
-    bool readResponse(uint8_t* buffer, size_t bufferSize);
+    // Per platform: enumerate, pick the preferred match, identifyDevice(),
+    // open interface 2 into transport_ and finishConnect()
+    bool openDevice(uint16_t pid, uint32_t locationId);
+    void closeDevice();  // Releases what openDevice() opened
+#ifdef __APPLE__
     bool findInterface2(io_service_t device);
-    bool setDeviceMode(uint8_t mode, uint8_t param);
+#endif
     
-    // Static callbacks for IOKit
-    static void deviceAddedCallback(void* refCon, io_iterator_t iterator);
-    static void deviceRemovedCallback(void* refCon, io_iterator_t iterator);
+    // Portable halves of a connect: identity, profile and link type of the
+    // chosen device, then the session on its opened interface
+    void identifyDevice(const RazerDeviceMatch& match, uint16_t pid, uint32_t locationId);
+    void finishConnect();
+    void ensureDriverMode();
 };
 
 #endif // RAZER_DEVICE_HPP
@@ -0,0 +1,246 @@
+/**
+ * RazerDeviceIOKit.cpp - Device lookup and Interface 2 access via IOKit
+ *
+ * RazerDevice's macOS half: picks the supported USB device through the
+ * registry, opens its Interface 2 for IOKitTransport and reads the registry
+ * properties the connect path and RazerDeviceMonitor need.
+ */
+
+#include "RazerDevice.hpp"
+#include <iostream>
+#include <string>
+
+std::string RazerDevice::getDeviceName(io_service_t device) {
+    std::string name = "Unknown";
+    CFStringRef deviceName = (CFStringRef)IORegistryEntryCreateCFProperty(
+        device,
+        CFSTR("USB Product Name"),
+        kCFAllocatorDefault,
+        0
+    );
+    
+    if (deviceName) {
+        char buf[256];
+        if (CFStringGetCString(deviceName, buf, sizeof(buf), kCFStringEncodingUTF8)) {
+            name = buf;
+        }
+        CFRelease(deviceName);
+    }
+    return name;
+}
+
+uint32_t RazerDevice::getLocationId(io_service_t device) {
+    uint32_t locationId = 0;
+    CFNumberRef locationRef = (CFNumberRef)IORegistryEntryCreateCFProperty(
+        device,
+        CFSTR(kUSBDevicePropertyLocationID),
+        kCFAllocatorDefault,
+        0
+    );
+    
+    if (locationRef) {
+        CFNumberGetValue(locationRef, kCFNumberSInt32Type, &locationId);
+        CFRelease(locationRef);
+    }
+    return locationId;
+}
+
+uint16_t RazerDevice::getProductId(io_service_t device) {
+    uint16_t pid = 0;
+    CFNumberRef pidRef = (CFNumberRef)IORegistryEntryCreateCFProperty(
+        device,
+        CFSTR(kUSBProductID),
+        kCFAllocatorDefault,
+        0
+    );
+    
+    if (pidRef) {
+        int value = 0;
+        if (CFNumberGetValue(pidRef, kCFNumberIntType, &value)) {
+            pid = (uint16_t)value;
+        }
+        CFRelease(pidRef);
+    }
+    return pid;
+}
+
+bool RazerDevice::findInterface2(io_service_t device) {
+    // Create iterator for device's interfaces
+    io_iterator_t interfaceIterator;
+    IOUSBFindInterfaceRequest request;
+    request.bInterfaceClass = kIOUSBFindInterfaceDontCare;
+    request.bInterfaceSubClass = kIOUSBFindInterfaceDontCare;
+    request.bInterfaceProtocol = kIOUSBFindInterfaceDontCare;
+    request.bAlternateSetting = kIOUSBFindInterfaceDontCare;
+    
+    // We need to open the device first to iterate interfaces
+    IOCFPlugInInterface** plugInInterface = nullptr;
+    SInt32 score;
+    kern_return_t kr = IOCreatePlugInInterfaceForService(device, kIOUSBDeviceUserClientTypeID,
+                                                          kIOCFPlugInInterfaceID, &plugInInterface, &score);
+    if (kr != KERN_SUCCESS || plugInInterface == nullptr) {
+        std::cerr << "Failed to create device plugin interface" << std::endl;
+        return false;
+    }
+    
+    IOUSBDeviceInterface** deviceInterface = nullptr;
+    HRESULT hr = (*plugInInterface)->QueryInterface(plugInInterface,
+                    CFUUIDGetUUIDBytes(kIOUSBDeviceInterfaceID),
+                    (LPVOID*)&deviceInterface);
+    (*plugInInterface)->Release(plugInInterface);
+    
+    if (hr != S_OK || deviceInterface == nullptr) {
+        std::cerr << "Failed to get device interface" << std::endl;
+        return false;
+    }
+    
+    // Open device to iterate interfaces
+    kr = (*deviceInterface)->USBDeviceOpen(deviceInterface);
+    // Note: Device might already be open by system - this is OK, we proceed anyway
+    
+    // Create interface iterator
+    kr = (*deviceInterface)->CreateInterfaceIterator(deviceInterface, &request, &interfaceIterator);
+    if (kr != kIOReturnSuccess) {
+        std::cerr << "Failed to create interface iterator" << std::endl;
+        (*deviceInterface)->USBDeviceClose(deviceInterface);
+        (*deviceInterface)->Release(deviceInterface);
+        return false;
+    }
+    
+    // Iterate through interfaces to find Interface 2
+    io_service_t usbInterfaceRef;
+    bool found = false;
+    
+    while ((usbInterfaceRef = IOIteratorNext(interfaceIterator)) != 0) {
+        IOCFPlugInInterface** interfacePlugIn = nullptr;
+        SInt32 interfaceScore;
+        
+        kr = IOCreatePlugInInterfaceForService(usbInterfaceRef, kIOUSBInterfaceUserClientTypeID,
+                                                kIOCFPlugInInterfaceID, &interfacePlugIn, &interfaceScore);
+        
+        if (kr == KERN_SUCCESS && interfacePlugIn != nullptr) {
+            // 1.8.2: the first version with ControlRequestTO
+            IOUSBInterfaceInterface182** interface = nullptr;
+            hr = (*interfacePlugIn)->QueryInterface(interfacePlugIn,
+                        CFUUIDGetUUIDBytes(kIOUSBInterfaceInterfaceID182),
+                        (LPVOID*)&interface);
+            (*interfacePlugIn)->Release(interfacePlugIn);
+            
+            if (hr == S_OK && interface != nullptr) {
+                UInt8 interfaceNumber;
+                (*interface)->GetInterfaceNumber(interface, &interfaceNumber);
+                
+                if (interfaceNumber == TARGET_INTERFACE) {
+                    // Open Interface 2 (vendor-specific control interface)
+                    kr = (*interface)->USBInterfaceOpen(interface);
+                    if (kr == kIOReturnSuccess || kr == kIOReturnExclusiveAccess) {
+                        // Success or exclusive access (we can still send control requests)
+                        usbInterface_ = interface;
+                        interfaceService_ = usbInterfaceRef;
+                        found = true;
+                    } else {
+                        (*interface)->Release(interface);
+                    }
+                    break;
+                } else {
+                    (*interface)->Release(interface);
+                }
+            }
+        }
+        
+        if (!found) {
+            IOObjectRelease(usbInterfaceRef);
+        }
+    }
+    
+    IOObjectRelease(interfaceIterator);
+    
+    // Close device (we'll use the interface directly)
+    (*deviceInterface)->USBDeviceClose(deviceInterface);
+    (*deviceInterface)->Release(deviceInterface);
+    
+    return found;
+}
+
+bool RazerDevice::openDevice(uint16_t pid, uint32_t locationId) {
+    connectPhase_ = ConnectionState::Enumerating;
+    
+    // One VID-only enumeration pass, each PID resolved through the constexpr index
+    CFMutableDictionaryRef matchingDict = IOServiceMatching(kIOUSBDeviceClassName);
+    if (matchingDict == nullptr) {
+        return false;
+    }
+    
+    int vid = VENDOR_ID;
+    CFNumberRef vidRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &vid);
+    CFDictionarySetValue(matchingDict, CFSTR(kUSBVendorID), vidRef);
+    CFRelease(vidRef);
+    
+    io_iterator_t iterator;
+    kern_return_t kr = IOServiceGetMatchingServices(kIOMainPortDefault, matchingDict, &iterator);
+    if (kr != KERN_SUCCESS) {
+        return false;
+    }
+    
+    // Prefer the earliest table entry, and its wireless PID over the wired one
+    io_service_t deviceService = 0;
+    RazerDeviceMatch best = {nullptr, false, 0};
+    uint16_t bestPid = 0;
+    io_service_t candidate;
+    
+    while ((candidate = IOIteratorNext(iterator)) != 0) {
+        uint16_t candidatePid = getProductId(candidate);
+        RazerDeviceMatch match = RazerDeviceTable::find(candidatePid);
+        
+        // Pinned to one device (multi-device registry): skip everything else
+        bool wanted = (pid == 0 || candidatePid == pid) &&
+                      (locationId == 0 || getLocationId(candidate) == locationId);
+        
+        bool better = wanted && match.device != nullptr &&
+            (best.device == nullptr || match.tableIndex < best.tableIndex ||
+             (match.tableIndex == best.tableIndex && match.isWireless && !best.isWireless));
+        
+        if (better) {
+            if (deviceService != 0) {
+                IOObjectRelease(deviceService);
+            }
+            deviceService = candidate;
+            best = match;
+            bestPid = candidatePid;
+        } else {
+            IOObjectRelease(candidate);
+        }
+    }
+    IOObjectRelease(iterator);
+    
+    if (deviceService == 0) {
+        return false;  // Device not found
+    }
+    
+    identifyDevice(best, bestPid, getLocationId(deviceService));
+    
+    // Find and open Interface 2
+    connectPhase_ = ConnectionState::Opening;
+    bool success = findInterface2(deviceService);
+    IOObjectRelease(deviceService);
+    
+    if (success) {
+        transport_.setInterface(usbInterface_);
+        finishConnect();
+    }
+    
+    return success;
+}
+
+void RazerDevice::closeDevice() {
+    transport_.setInterface(nullptr);
+    if (usbInterface_ != nullptr) {
+        (*usbInterface_)->USBInterfaceClose(usbInterface_);
+        (*usbInterface_)->Release(usbInterface_);
+        usbInterface_ = nullptr;
+    }
+    if (interfaceService_ != 0) {
+        IOObjectRelease(interfaceService_);
+        interfaceService_ = 0;
+    }
+}
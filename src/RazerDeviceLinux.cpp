@@ -0,0 +1,74 @@
+/**
+ * RazerDeviceLinux.cpp - Device lookup and Interface 2 access via hidraw
+ *
+ * RazerDevice's Linux half: picks the supported device among the Razer hidraw
+ * nodes sysfs lists (HidrawDevices) and opens Interface 2's node for
+ * HidrawTransport. Opening needs read/write access to /dev/hidrawN, normally
+ * granted by a udev rule for VID 1532.
+ */
+
+#include "RazerDevice.hpp"
+#include "HidrawDevices.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+bool RazerDevice::openDevice(uint16_t pid, uint32_t locationId) {
+    connectPhase_ = ConnectionState::Enumerating;
+
+    std::vector<HidrawNode> nodes;
+    HidrawDevices::list(nodes);
+
+    // Prefer the earliest table entry, and its wireless PID over the wired one
+    const HidrawNode* best = nullptr;
+    RazerDeviceMatch bestMatch = {nullptr, false, 0};
+    for (const HidrawNode& node : nodes) {
+        if (node.interfaceNumber != TARGET_INTERFACE) {
+            continue;
+        }
+        RazerDeviceMatch match = RazerDeviceTable::find(node.pid);
+
+        // Pinned to one device (multi-device registry): skip everything else
+        bool wanted = (pid == 0 || node.pid == pid) && (locationId == 0 || node.locationId == locationId);
+
+        bool better = wanted && match.device != nullptr &&
+            (bestMatch.device == nullptr || match.tableIndex < bestMatch.tableIndex ||
+             (match.tableIndex == bestMatch.tableIndex && match.isWireless && !bestMatch.isWireless));
+        if (better) {
+            best = &node;
+            bestMatch = match;
+        }
+    }
+
+    if (best == nullptr) {
+        return false;  // Device not found
+    }
+
+    identifyDevice(bestMatch, best->pid, best->locationId);
+
+    // Open Interface 2's node
+    connectPhase_ = ConnectionState::Opening;
+    int fd = open(best->devNode.c_str(), O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Failed to open " << best->devNode << ": " << strerror(errno)
+                  << (errno == EACCES ? " (no udev rule for VID 1532?)" : "") << std::endl;
+        return false;
+    }
+
+    hidrawFd_ = fd;
+    transport_.setDevice(fd);
+    finishConnect();
+    return true;
+}
+
+void RazerDevice::closeDevice() {
+    transport_.setDevice(-1);
+    if (hidrawFd_ >= 0) {
+        close(hidrawFd_);
+        hidrawFd_ = -1;
+    }
+}
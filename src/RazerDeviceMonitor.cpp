@@ -0,0 +1,176 @@
+#include "RazerDeviceMonitor.hpp"
+#include "RazerDevice.hpp"
+#include <iostream>
+
+RazerDeviceMonitor::RazerDeviceMonitor()
+    : notificationPort_(nullptr),
+      addedIter_(0),
+      removedIter_(0),
+      callback_(nullptr),
+      callbackContext_(nullptr) {
+}
+
+RazerDeviceMonitor::~RazerDeviceMonitor() {
+    stopMonitoring();
+}
+
+CFMutableDictionaryRef RazerDeviceMonitor::createMatchingDictionary() {
+    // NOTE: We only match on VID (not PID) to detect both Dongle and Wired PIDs
+    CFMutableDictionaryRef matchingDict = IOServiceMatching(kIOUSBDeviceClassName);
+    if (!matchingDict) {
+        return nullptr;
+    }
+
+    int vid = VENDOR_ID;
+    CFNumberRef vidRef = CFNumberCreate(kCFAllocatorDefault, kCFNumberIntType, &vid);
+    CFDictionarySetValue(matchingDict, CFSTR(kUSBVendorID), vidRef);
+    CFRelease(vidRef);
+    return matchingDict;
+}
+
+void RazerDeviceMonitor::presentDevices(std::vector<DeviceEvent>& devices) {
+    devices.clear();
+
+    CFMutableDictionaryRef matchingDict = createMatchingDictionary();
+    if (matchingDict == nullptr) {
+        return;
+    }
+
+    io_iterator_t iterator;
+    kern_return_t kr = IOServiceGetMatchingServices(kIOMainPortDefault, matchingDict, &iterator);
+    if (kr != KERN_SUCCESS) {
+        return;
+    }
+
+    io_service_t device;
+    while ((device = IOIteratorNext(iterator)) != 0) {
+        DeviceEvent event;
+        event.added = true;
+        event.pid = RazerDevice::getProductId(device);
+        event.locationId = RazerDevice::getLocationId(device);
+        IOObjectRelease(device);
+
+        if (RazerDeviceTable::isSupported(event.pid)) {
+            devices.push_back(event);
+        }
+    }
+    IOObjectRelease(iterator);
+
+    sortByConnectPreference(devices);
+}
+
+void RazerDeviceMonitor::startMonitoring(DeviceCallback callback, void* context) {
+    if (notificationPort_ != nullptr) {
+        return; // Already monitoring
+    }
+
+    callback_ = callback;
+    callbackContext_ = context;
+
+    // Create notification port
+    notificationPort_ = IONotificationPortCreate(kIOMainPortDefault);
+    if (!notificationPort_) {
+        std::cerr << "Failed to create IONotificationPort" << std::endl;
+        return;
+    }
+
+    // Add to run loop
+    CFRunLoopSourceRef runLoopSource = IONotificationPortGetRunLoopSource(notificationPort_);
+    CFRunLoopAddSource(CFRunLoopGetMain(), runLoopSource, kCFRunLoopDefaultMode);
+
+    // Monitor all Razer devices (VID only)
+    CFMutableDictionaryRef matchingDict = createMatchingDictionary();
+    if (!matchingDict) {
+        std::cerr << "Failed to create matching dictionary" << std::endl;
+        // Cleanup notification port on error
+        IONotificationPortDestroy(notificationPort_);
+        notificationPort_ = nullptr;
+        return;
+    }
+
+    // Register for device added (retain dict for second use)
+    CFRetain(matchingDict);
+
+    kern_return_t kr = IOServiceAddMatchingNotification(
+        notificationPort_,
+        kIOFirstMatchNotification,
+        matchingDict,
+        deviceAddedCallback,
+        (void*)this,
+        &addedIter_
+    );
+
+    if (kr != KERN_SUCCESS) {
+        std::cerr << "Failed to register for device added: " << std::hex << kr << std::dec << std::endl;
+    } else {
+        // Drain iterator to arm notification (current devices come from presentDevices)
+        drainIterator(addedIter_);
+    }
+
+    // Register for device removed
+    kr = IOServiceAddMatchingNotification(
+        notificationPort_,
+        kIOTerminatedNotification,
+        matchingDict,
+        deviceRemovedCallback,
+        (void*)this,
+        &removedIter_
+    );
+
+    if (kr != KERN_SUCCESS) {
+        std::cerr << "Failed to register for device removed: " << std::hex << kr << std::dec << std::endl;
+    } else {
+        // Drain iterator to arm notification
+        drainIterator(removedIter_);
+    }
+}
+
+void RazerDeviceMonitor::stopMonitoring() {
+    if (addedIter_) {
+        IOObjectRelease(addedIter_);
+        addedIter_ = 0;
+    }
+    if (removedIter_) {
+        IOObjectRelease(removedIter_);
+        removedIter_ = 0;
+    }
+    if (notificationPort_) {
+        IONotificationPortDestroy(notificationPort_);
+        notificationPort_ = nullptr;
+    }
+    callback_ = nullptr;
+    callbackContext_ = nullptr;
+}
+
+void RazerDeviceMonitor::drainIterator(io_iterator_t iterator) {
+    io_service_t device;
+    while ((device = IOIteratorNext(iterator))) {
+        IOObjectRelease(device);
+    }
+}
+
+void RazerDeviceMonitor::notifyDevices(io_iterator_t iterator, bool added) {
+    io_service_t device;
+
+    while ((device = IOIteratorNext(iterator))) {
+        DeviceEvent event;
+        event.added = added;
+        event.pid = RazerDevice::getProductId(device);
+        event.locationId = RazerDevice::getLocationId(device);
+        IOObjectRelease(device);
+
+        if (callback_) {
+            callback_(callbackContext_, event);
+        }
+    }
+}
+
+void RazerDeviceMonitor::deviceAddedCallback(void* refCon, io_iterator_t iterator) {
+    RazerDeviceMonitor* self = (RazerDeviceMonitor*)refCon;
+    self->notifyDevices(iterator, true);
+}
+
+void RazerDeviceMonitor::deviceRemovedCallback(void* refCon, io_iterator_t iterator) {
+    RazerDeviceMonitor* self = (RazerDeviceMonitor*)refCon;
+    self->notifyDevices(iterator, false);
+}
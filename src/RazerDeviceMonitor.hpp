@@ -0,0 +1,74 @@
+#ifndef RAZER_DEVICE_MONITOR_HPP
+#define RAZER_DEVICE_MONITOR_HPP
+
+#include <cstdint>
+#include <vector>
+#ifdef __APPLE__
+#include <CoreFoundation/CoreFoundation.h>
+#include <IOKit/IOKitLib.h>
+#include <IOKit/usb/IOUSBLib.h>
+#endif
+#include "DeviceEvents.hpp"
+#include "RazerDeviceTable.hpp"
+
+// Callback type for device change events (one call per added/removed Razer device)
+typedef void (*DeviceCallback)(void* context, const DeviceEvent& event);
+
+// USB discovery for every Razer device on the bus, independent of any open
+// RazerDevice: one snapshot of what is attached now, plus hotplug
+// notifications for what changes afterwards. IOKit on macOS
+// (RazerDeviceMonitor.cpp); sysfs and a netlink uevent socket on Linux
+// (RazerDeviceMonitorLinux.cpp).
+class RazerDeviceMonitor {
+public:
+    RazerDeviceMonitor();
+    ~RazerDeviceMonitor();
+
+    // Supported devices attached right now (added = true), ordered the way
+    // RazerDevice::connect() prefers them: earliest table entry first, wireless
+    // PID before the wired one
+    static void presentDevices(std::vector<DeviceEvent>& devices);
+
+    // Reports changes only; devices already attached are left to presentDevices()
+    void startMonitoring(DeviceCallback callback, void* context);
+    void stopMonitoring();
+
+#ifndef __APPLE__
+    // Same, reading kernel uevent datagrams from ueventFd instead of a new
+    // netlink socket (a socketpair carrying a fake stream in tests). Takes
+    // ownership of the descriptor.
+    bool startMonitoring(DeviceCallback callback, void* context, int ueventFd);
+
+    // There is no run loop to deliver on: the owner's loop waits for this
+    // epoll descriptor to become readable and calls dispatch(), which runs the
+    // callback on that thread for every pending change. -1 when stopped.
+    int fileDescriptor() const { return epollFd_; }
+    void dispatch();
+#endif
+
+private:
+    static constexpr uint16_t VENDOR_ID = RazerDeviceTable::VENDOR_ID;
+
+#ifdef __APPLE__
+    IONotificationPortRef notificationPort_;
+    io_iterator_t addedIter_;
+    io_iterator_t removedIter_;
+#else
+    int epollFd_;
+    int ueventFd_;
+#endif
+    DeviceCallback callback_;
+    void* callbackContext_;
+
+#ifdef __APPLE__
+    void notifyDevices(io_iterator_t iterator, bool added);
+    static CFMutableDictionaryRef createMatchingDictionary();
+    static void drainIterator(io_iterator_t iterator);
+
+    // Static callbacks for IOKit
+    static void deviceAddedCallback(void* refCon, io_iterator_t iterator);
+    static void deviceRemovedCallback(void* refCon, io_iterator_t iterator);
+#endif
+};
+
+#endif // RAZER_DEVICE_MONITOR_HPP
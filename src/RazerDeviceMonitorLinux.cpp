@@ -0,0 +1,153 @@
+/**
+ * RazerDeviceMonitorLinux.cpp - Razer USB discovery and hotplug on Linux
+ *
+ * What is attached comes from sysfs (HidrawDevices::list). Changes come from
+ * the kernel's uevent broadcast on a NETLINK_KOBJECT_UEVENT socket, in place
+ * of IOKit's IONotificationPort: the socket sits in an epoll set the owner's
+ * loop waits on, and dispatch() turns the USB device add/remove events of VID
+ * 0x1532 into DeviceEvents.
+ */
+
+#include "RazerDeviceMonitor.hpp"
+#include "HidrawDevices.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <linux/netlink.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+RazerDeviceMonitor::RazerDeviceMonitor()
+    : epollFd_(-1),
+      ueventFd_(-1),
+      callback_(nullptr),
+      callbackContext_(nullptr) {
+}
+
+RazerDeviceMonitor::~RazerDeviceMonitor() {
+    stopMonitoring();
+}
+
+void RazerDeviceMonitor::presentDevices(std::vector<DeviceEvent>& devices) {
+    devices.clear();
+
+    // One node per USB device: the interface RazerDevice opens
+    std::vector<HidrawNode> nodes;
+    HidrawDevices::list(nodes);
+    for (const HidrawNode& node : nodes) {
+        if (node.interfaceNumber != RazerDeviceTable::CONTROL_INTERFACE || !RazerDeviceTable::isSupported(node.pid)) {
+            continue;
+        }
+        DeviceEvent event;
+        event.added = true;
+        event.pid = node.pid;
+        event.locationId = node.locationId;
+        devices.push_back(event);
+    }
+
+    sortByConnectPreference(devices);
+}
+
+void RazerDeviceMonitor::startMonitoring(DeviceCallback callback, void* context) {
+    if (epollFd_ >= 0) {
+        return; // Already monitoring
+    }
+
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if (fd < 0) {
+        std::cerr << "Failed to open the uevent socket: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    // Group 1: the kernel's own events (udev re-broadcasts its processed copies on 2)
+    sockaddr_nl address;
+    std::memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = 1;
+    if (bind(fd, (sockaddr*)&address, sizeof(address)) != 0) {
+        std::cerr << "Failed to bind the uevent socket: " << strerror(errno) << std::endl;
+        close(fd);
+        return;
+    }
+
+    startMonitoring(callback, context, fd);
+}
+
+bool RazerDeviceMonitor::startMonitoring(DeviceCallback callback, void* context, int ueventFd) {
+    if (epollFd_ >= 0) {
+        close(ueventFd);
+        return false; // Already monitoring
+    }
+
+    // dispatch() drains the socket until it would block
+    int flags = fcntl(ueventFd, F_GETFL);
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event watch;
+    std::memset(&watch, 0, sizeof(watch));
+    watch.events = EPOLLIN;
+    watch.data.fd = ueventFd;
+    if (flags < 0 || fcntl(ueventFd, F_SETFL, flags | O_NONBLOCK) != 0 || epollFd_ < 0 ||
+        epoll_ctl(epollFd_, EPOLL_CTL_ADD, ueventFd, &watch) != 0) {
+        std::cerr << "Failed to watch the uevent socket: " << strerror(errno) << std::endl;
+        close(ueventFd);
+        if (epollFd_ >= 0) {
+            close(epollFd_);
+            epollFd_ = -1;
+        }
+        return false;
+    }
+
+    ueventFd_ = ueventFd;
+    callback_ = callback;
+    callbackContext_ = context;
+    return true;
+}
+
+void RazerDeviceMonitor::stopMonitoring() {
+    if (ueventFd_ >= 0) {
+        close(ueventFd_);
+        ueventFd_ = -1;
+    }
+    if (epollFd_ >= 0) {
+        close(epollFd_);
+        epollFd_ = -1;
+    }
+    callback_ = nullptr;
+    callbackContext_ = nullptr;
+}
+
+void RazerDeviceMonitor::dispatch() {
+    char message[8192];
+    while (ueventFd_ >= 0) {
+        sockaddr_storage sender;
+        socklen_t senderLength = sizeof(sender);
+        std::memset(&sender, 0, sizeof(sender));
+        ssize_t length = recvfrom(ueventFd_, message, sizeof(message), 0, (sockaddr*)&sender, &senderLength);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                // Missed changes are caught by the next presentDevices() or reconnect attempt
+                std::cerr << "Uevent queue overflowed: some device changes were lost" << std::endl;
+                continue;
+            }
+            return;  // EAGAIN: drained
+        }
+        if (length == 0) {
+            return;
+        }
+
+        // Only the kernel (port 0) sends these; anything else could be forged
+        if (sender.ss_family == AF_NETLINK && ((sockaddr_nl*)&sender)->nl_pid != 0) {
+            continue;
+        }
+
+        DeviceEvent event;
+        if (HidrawDevices::parseUevent(message, (size_t)length, event) && callback_ != nullptr) {
+            callback_(callbackContext_, event);
+        }
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef RAZER_DEVICE_TABLE_HPP
+#define RAZER_DEVICE_TABLE_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "RazerProtocol.hpp"
+
+// Supported Razer wireless mouse device information, including the protocol
+// parameters used to seed RazerProtocolProfile for that model
+struct RazerSupportedDevice {
+    uint16_t wirelessPid;
+    uint16_t wiredPid;
+    const char* name;
+    uint8_t transactionId;  // 0x1F newer wireless, 0x3F / 0xFF older models
+    uint8_t batteryOffset;  // Response byte holding the 0-255 battery level
+};
+
+// Result of a PID lookup: the model and which of its two PIDs matched
+struct RazerDeviceMatch {
+    const RazerSupportedDevice* device;
+    bool isWireless;
+    uint8_t tableIndex;  // Position in the table (lower = preferred when several match)
+};
+
+// List of supported Razer wireless mice (from OpenRazer)
+// Transaction IDs seed the protocol profile; a wrong guess only costs one re-probe
+inline constexpr RazerSupportedDevice RAZER_SUPPORTED_DEVICES[] = {
+    {0x00A6, 0x00A5, "Razer Viper V2 Pro", 0x1F, 9},
+    {0x007D, 0x007C, "Razer DeathAdder V2 Pro", 0x3F, 9},
+    {0x007B, 0x007A, "Razer Viper Ultimate", 0x3F, 9},
+    {0x0088, 0x0086, "Razer Basilisk Ultimate", 0x1F, 9},
+    {0x0090, 0x008F, "Razer Naga Pro", 0x1F, 9},
+    {0x00B7, 0x00B6, "Razer DeathAdder V3 Pro", 0x1F, 9},
+    {0x00AB, 0x00AA, "Razer Basilisk V3 Pro", 0x1F, 9},
+    {0x00B0, 0x00AF, "Razer Cobra Pro", 0x1F, 9},
+    {0x00A8, 0x00A7, "Razer Naga V2 Pro", 0x1F, 9},
+    {0x00BF, 0x00BE, "Razer DeathAdder V4 Pro", 0x1F, 9},
+    {0x00C1, 0x00C0, "Razer Viper V3 Pro", 0x1F, 9},
+    {0x0072, 0x0073, "Razer Mamba Wireless", 0x3F, 9},
+    {0x006F, 0x0070, "Razer Lancehead Wireless", 0x3F, 9},
+    {0x0094, 0x0095, "Razer Orochi V2", 0x1F, 9},
+    {0x003F, 0x003E, "Razer Naga Epic Chroma", 0xFF, 9},
+    {0x0045, 0x0044, "Razer Mamba", 0xFF, 9},
+    {0x005A, 0x0059, "Razer Lancehead", 0x3F, 9},
+    {0x0025, 0x0024, "Razer Mamba 2012", 0xFF, 9},
+    {0x001F, 0x0000, "Razer Naga Epic", 0xFF, 9}
+};
+inline constexpr size_t RAZER_NUM_SUPPORTED_DEVICES =
+    sizeof(RAZER_SUPPORTED_DEVICES) / sizeof(RAZER_SUPPORTED_DEVICES[0]);
+
+// All supported PIDs are below 0x100, so the index is a flat 256-entry array
+inline constexpr size_t RAZER_PID_INDEX_SIZE = 0x100;
+
+// Slot + 1 (0 = unsupported); slot = tableIndex * 2 + (wired ? 1 : 0)
+constexpr std::array<uint8_t, RAZER_PID_INDEX_SIZE> buildRazerPidIndex() {
+    std::array<uint8_t, RAZER_PID_INDEX_SIZE> index{};
+    for (size_t i = 0; i < RAZER_NUM_SUPPORTED_DEVICES; i++) {
+        index[RAZER_SUPPORTED_DEVICES[i].wirelessPid] = (uint8_t)(i * 2 + 1);
+        if (RAZER_SUPPORTED_DEVICES[i].wiredPid != 0) {
+            index[RAZER_SUPPORTED_DEVICES[i].wiredPid] = (uint8_t)(i * 2 + 2);
+        }
+    }
+    return index;
+}
+
+// Every PID must fit the flat index and appear only once
+constexpr bool razerPidTableIsIndexable() {
+    if (RAZER_NUM_SUPPORTED_DEVICES * 2 >= 0xFF) {
+        return false;
+    }
+    for (size_t i = 0; i < RAZER_NUM_SUPPORTED_DEVICES; i++) {
+        const uint16_t pids[2] = {RAZER_SUPPORTED_DEVICES[i].wirelessPid, RAZER_SUPPORTED_DEVICES[i].wiredPid};
+        if (pids[0] == 0 || pids[0] == pids[1]) {
+            return false;
+        }
+        for (uint16_t pid : pids) {
+            if (pid >= RAZER_PID_INDEX_SIZE) {
+                return false;
+            }
+            for (size_t j = 0; pid != 0 && j < RAZER_NUM_SUPPORTED_DEVICES; j++) {
+                if (j != i && (RAZER_SUPPORTED_DEVICES[j].wirelessPid == pid ||
+                               RAZER_SUPPORTED_DEVICES[j].wiredPid == pid)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static_assert(razerPidTableIsIndexable(), "Supported PIDs must be unique and below 0x100");
+
+inline constexpr std::array<uint8_t, RAZER_PID_INDEX_SIZE> RAZER_PID_INDEX = buildRazerPidIndex();
+
+// Compile-time PID -> descriptor lookup; one bounds check and one load
+// regardless of how many models are listed.
+class RazerDeviceTable {
+public:
+    static constexpr uint16_t VENDOR_ID = 0x1532;
+    static constexpr uint8_t CONTROL_INTERFACE = 2;  // USB interface the feature reports go to
+    static constexpr size_t COUNT = RAZER_NUM_SUPPORTED_DEVICES;
+
+    static constexpr const RazerSupportedDevice& at(size_t i) { return RAZER_SUPPORTED_DEVICES[i]; }
+
+    static constexpr RazerDeviceMatch find(uint16_t pid) {
+        if (pid >= RAZER_PID_INDEX_SIZE || RAZER_PID_INDEX[pid] == 0) {
+            return RazerDeviceMatch{nullptr, false, 0};
+        }
+        uint8_t slot = (uint8_t)(RAZER_PID_INDEX[pid] - 1);
+        return RazerDeviceMatch{&RAZER_SUPPORTED_DEVICES[slot / 2], (slot % 2) == 0, (uint8_t)(slot / 2)};
+    }
+
+    static constexpr bool isSupported(uint16_t pid) { return find(pid).device != nullptr; }
+
+    static RazerProtocolProfile profileFor(const RazerSupportedDevice& device) {
+        RazerProtocolProfile profile;
+        profile.transactionId = device.transactionId;
+        profile.batteryOffset = device.batteryOffset;
+        return profile;
+    }
+};
+
+static_assert(RazerDeviceTable::find(0x00A6).isWireless, "PID index must resolve the Viper V2 Pro dongle");
+static_assert(!RazerDeviceTable::find(0x00A5).isWireless, "PID index must resolve the Viper V2 Pro cable");
+static_assert(!RazerDeviceTable::isSupported(0x0000), "PID 0 marks a missing wired PID");
+
+#endif // RAZER_DEVICE_TABLE_HPP
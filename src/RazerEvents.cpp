@@ -0,0 +1,34 @@
+#include "RazerEvents.hpp"
+
+bool RazerEventParser::parse(const uint8_t* data, size_t length, RazerEvent& event) {
+    event = RazerEvent();
+    if (data == nullptr || length < 2 || data[0] != REPORT_ID) {
+        return false;
+    }
+
+    event.type = data[1];
+    switch (event.type) {
+        case TYPE_DPI:
+            if (length >= 6) {
+                event.kind = RazerEventKind::Dpi;
+                event.dpiX = (uint16_t)(data[2] << 8 | data[3]);
+                event.dpiY = (uint16_t)(data[4] << 8 | data[5]);
+            }
+            break;
+        case TYPE_BATTERY:
+            if (length >= 3) {
+                event.kind = RazerEventKind::Battery;
+                event.batteryPercent = (uint8_t)((data[2] * 100) / 255);  // Same scaling as queries
+            }
+            break;
+        case TYPE_CHARGING:
+            if (length >= 3) {
+                event.kind = RazerEventKind::Charging;
+                event.isCharging = data[2] == 0x01;
+            }
+            break;
+        default:
+            break;
+    }
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef RAZER_EVENTS_HPP
+#define RAZER_EVENTS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// What an unsolicited report on the interrupt IN pipe said
+enum class RazerEventKind : uint8_t {
+    Unknown,   // Recognised as a Razer event, but no known payload: refresh to learn more
+    Battery,
+    Charging,
+    Dpi
+};
+
+struct RazerEvent {
+    RazerEventKind kind = RazerEventKind::Unknown;
+    uint8_t type = 0;             // Raw event type byte
+    uint8_t batteryPercent = 0;   // Battery
+    bool isCharging = false;      // Charging
+    uint16_t dpiX = 0;            // Dpi
+    uint16_t dpiY = 0;
+};
+
+// Event reports pushed by the device without a request. They carry report ID
+// 0x05 and an event type in byte 1; the payload follows from byte 2:
+//
+//   type  payload
+//   0x09  DPI X (big endian, bytes 2-3), DPI Y (bytes 4-5)
+//   0x0A  battery level 0-255 (byte 2)
+//   0x0B  charging flag (byte 2, 0x01 = on charger)
+//
+// Any other type still means the device state changed, so it is reported as
+// Unknown and the caller refreshes over control transfers: the change then
+// shows up within one round trip instead of at the next poll.
+class RazerEventParser {
+public:
+    static constexpr uint8_t REPORT_ID = 0x05;
+    static constexpr uint8_t TYPE_DPI = 0x09;
+    static constexpr uint8_t TYPE_BATTERY = 0x0A;
+    static constexpr uint8_t TYPE_CHARGING = 0x0B;
+
+    // False for anything that is not an event report (e.g. ordinary input)
+    static bool parse(const uint8_t* data, size_t length, RazerEvent& event);
+};
+
+#endif // RAZER_EVENTS_HPP
@@ -0,0 +1,400 @@
+/**
+ * RazerProtocol.cpp - Razer HID report protocol (transport independent)
+ * 
+ * PROTOCOL DETAILS (discovered via librazermacos analysis):
+ * - Transaction ID: 0x1F (Wireless protocol, works for Viper V2 Pro)
+ * - Command Class: 0x07 (Power/Battery)
+ * - Command ID: 0x80 (Get Battery Level)
+ * - Data Size: 0x02
+ * - Battery Data: Response byte 9 (0-255 scale, map to 0-100%)
+ * - Valid Status: 0x00 (Success) OR 0x02 (Busy with data ready)
+ * 
+ * Report Structure (90 bytes):
+ * [0]     Status: 0x00 = New Command
+ * [1]     Transaction ID: 0x1F for wireless
+ * [2-4]   Reserved
+ * [5]     Data Size: 0x02
+ * [6]     Command Class: 0x07 = Power
+ * [7]     Command ID: 0x80 = Get Battery
+ * [8-87]  Arguments (battery at byte 9)
+ * [88]    Checksum (XOR of bytes 2-87)
+ * [89]    Reserved
+ */
+
+#include "RazerProtocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+// Request templates for the fixed commands, checksum computed by the compiler
+constexpr RazerReport REQUEST_TEMPLATES[] = {
+    RazerReportBuilder().command(RazerProtocol::CMD_BATTERY).build(),
+    RazerReportBuilder().command(RazerProtocol::CMD_CHARGING).build(),
+    RazerReportBuilder().command(RazerProtocol::CMD_IDLE_TIME).build(),
+    RazerReportBuilder().command(RazerProtocol::CMD_FIRMWARE).build(),
+    RazerReportBuilder().command(RazerProtocol::CMD_DPI).build(),
+    RazerReportBuilder().command(RazerProtocol::CMD_DEVICE_MODE).build(),
+};
+
+static_assert(REQUEST_TEMPLATES[0].bytes[RazerReportLayout::CHECKSUM] == (0x02 ^ 0x07 ^ 0x80),
+              "battery template checksum must be folded at compile time");
+
+} // namespace
+
+RazerProtocol::RazerProtocol(RazerTransport* transport)
+    : transport_(transport),
+      sendCount_(0),
+      eventsActive_(false),
+      eventCount_(0) {
+}
+
+bool RazerProtocol::startEvents() {
+    stopEvents();
+    eventsActive_ = transport_ != nullptr && transport_->startEvents(this);
+    return eventsActive_;
+}
+
+void RazerProtocol::stopEvents() {
+    if (eventsActive_) {
+        transport_->stopEvents();
+        eventsActive_ = false;
+    }
+}
+
+void RazerProtocol::onEventReport(const uint8_t* data, size_t length) {
+    RazerEvent event;
+    if (!RazerEventParser::parse(data, length, event)) {
+        return;  // Not an event report
+    }
+    eventCount_++;
+    if (eventHandler_) {
+        eventHandler_(event);
+    }
+}
+
+bool RazerProtocol::applyEvent(const RazerEvent& event, RazerSnapshot& snapshot) {
+    switch (event.kind) {
+        case RazerEventKind::Battery:
+            snapshot.batteryValid = true;
+            snapshot.batteryPercent = event.batteryPercent;
+            return true;
+        case RazerEventKind::Charging:
+            snapshot.chargingValid = true;
+            snapshot.isCharging = event.isCharging;
+            return true;
+        case RazerEventKind::Dpi:
+            snapshot.dpiValid = true;
+            snapshot.dpiX = event.dpiX;
+            snapshot.dpiY = event.dpiY;
+            return true;
+        case RazerEventKind::Unknown:
+            break;
+    }
+    return false;
+}
+
+void RazerProtocol::calculateChecksum(uint8_t* report) {
+    // XOR bytes 2 through 87 (indices 2-87) - matches librazermacos
+    report[RazerReportLayout::CHECKSUM] = razerChecksum(report);
+}
+
+bool RazerProtocol::verifyChecksum(const uint8_t* report) {
+    return RazerResponseView(report).checksumValid();
+}
+
+RazerReport RazerProtocol::requestFor(const RazerCommand& command) {
+    for (const RazerReport& candidate : REQUEST_TEMPLATES) {
+        const uint8_t* bytes = candidate.bytes;
+        if (bytes[RazerReportLayout::COMMAND_CLASS] == command.cmdClass &&
+            bytes[RazerReportLayout::COMMAND_ID] == command.cmdId &&
+            bytes[RazerReportLayout::DATA_SIZE] == command.dataSize &&
+            bytes[RazerReportLayout::ARGS] == command.arg0) {
+            return candidate;
+        }
+    }
+    return RazerReportBuilder().command(command).build();
+}
+
+bool RazerProtocol::transact(const RazerReport& request, uint8_t* response) {
+    const uint8_t* report = request.data();
+    if (transport_ == nullptr) {
+        return false;
+    }
+    uint8_t cmdClass = report[RazerReportLayout::COMMAND_CLASS];
+    uint8_t cmdId = report[RazerReportLayout::COMMAND_ID];
+    
+    uint64_t startNs = TransferStats::nowNs();
+    bool sent = transport_->sendReport(report);
+    uint64_t sentNs = TransferStats::nowNs();
+    stats_.recordPhase(TransferPhase::Send, TransferStats::elapsedUs(startNs, sentNs));
+    if (!sent) {
+        stats_.recordCommand(cmdClass, cmdId, TransferStats::elapsedUs(startNs, sentNs), false, 0);
+        return false;
+    }
+    sendCount_++;
+    
+    std::memset(response, 0, REPORT_SIZE);
+    
+    RazerTransport* transport = transport_;
+    TransferStats* stats = &stats_;
+    ResponseWaiter::Result result = responseWaiter_.wait(
+        report, response, REPORT_SIZE,
+        [transport, stats](uint8_t* buffer, size_t bufferSize) {
+            uint64_t readNs = TransferStats::nowNs();
+            bool ok = transport->readResponse(buffer, bufferSize);
+            stats->recordPhase(TransferPhase::Read, TransferStats::elapsedUs(readNs, TransferStats::nowNs()));
+            return ok;
+        });
+    uint64_t doneNs = TransferStats::nowNs();
+    stats_.recordPhase(TransferPhase::Wait, TransferStats::elapsedUs(sentNs, doneNs));
+    
+    bool answered = result == ResponseWaiter::Result::Ready && verifyChecksum(response);
+    stats_.recordCommand(cmdClass, cmdId, TransferStats::elapsedUs(startNs, doneNs), answered, response[0]);
+    
+    if (result == ResponseWaiter::Result::TimedOut) {
+        std::cerr << "Command 0x" << std::hex << (int)cmdClass << "/0x" << (int)cmdId
+                  << std::dec << " timed out after " << responseWaiter_.lastReadCount()
+                  << " reads" << std::endl;
+        return false;
+    }
+    if (result != ResponseWaiter::Result::Ready) {
+        return false;
+    }
+    
+    if (!answered) {
+        std::cerr << "Response checksum mismatch for command 0x" << std::hex
+                  << (int)cmdClass << "/0x" << (int)cmdId << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool RazerProtocol::ping() {
+    if (transport_ == nullptr || !transport_->isOpen()) {
+        return false;
+    }
+    
+    // Any definite answer proves the interface and the device are alive;
+    // no transaction ID re-probing here, a dead link should fail fast
+    RazerReport report = requestFor(CMD_FIRMWARE);
+    report.setTransactionId(profile_.transactionId);
+    
+    uint8_t response[REPORT_SIZE];
+    return transact(report, response);
+}
+
+bool RazerProtocol::setDeviceMode(uint8_t mode, uint8_t param) {
+    // Set Device Mode command - switches device to Driver Mode (0x03)
+    // This enables battery queries on wireless Razer devices
+    if (transport_ == nullptr || !transport_->isOpen()) {
+        return false;
+    }
+    
+    // Class 0x00 (Device), ID 0x04 (Set Mode); args[0] = mode, args[1] = param
+    RazerReport report = RazerReportBuilder()
+        .transactionId(profile_.transactionId)
+        .command({0x00, 0x04, 0x02, mode})
+        .arg(1, param)
+        .build();
+    
+    // The device only acknowledges once the mode switch has been processed,
+    // so waiting for the response replaces the old fixed 100ms + 300ms sleeps
+    uint64_t startNs = TransferStats::nowNs();
+    uint8_t response[REPORT_SIZE];
+    
+    // Accept Status 0x00 (Success) or 0x02 (Busy/Acknowledged)
+    bool ok = transact(report, response) && (response[0] == 0x00 || response[0] == 0x02);
+    stats_.recordModeSwitch(TransferStats::elapsedUs(startNs, TransferStats::nowNs()), ok);
+    return ok;
+}
+
+bool RazerProtocol::queryDeviceMode(uint8_t& mode) {
+    if (transport_ == nullptr || !transport_->isOpen()) {
+        return false;
+    }
+    
+    RazerReport report;
+    uint8_t response[REPORT_SIZE];
+    // 0x04/0x05 are final answers here too: the caller just sets the mode
+    if (!runQuery(CMD_DEVICE_MODE, report, response, acceptAnswered) || !isDataStatus(response[0])) {
+        return false;
+    }
+    
+    mode = RazerResponseView(response).arg(0);  // args[0]: Mode, args[1]: Param
+    return true;
+}
+
+bool RazerProtocol::isDataStatus(uint8_t status) {
+    // Status 0x00 or 0x02 = Success with data
+    return status == 0x00 || status == 0x02;
+}
+
+bool RazerProtocol::acceptBattery(const RazerProtocolProfile& profile, const uint8_t* response) {
+    if (isDataStatus(response[0])) {
+        return response[profile.batteryOffset] > 0;
+    }
+    return response[0] == 0x04 && profile.notSupportedMeansWired;
+}
+
+bool RazerProtocol::acceptCharging(const RazerProtocolProfile& profile, const uint8_t* response) {
+    return isDataStatus(response[0]) || (response[0] == 0x04 && profile.notSupportedMeansWired);
+}
+
+bool RazerProtocol::acceptAnswered(const RazerProtocolProfile& profile, const uint8_t* response) {
+    (void)profile;
+    // Optional telemetry: any definite answer (data, 0x04, 0x05) is final,
+    // so unsupported commands do not trigger transaction ID re-probing
+    return isDataStatus(response[0]) || response[0] == 0x04 || response[0] == 0x05;
+}
+
+RazerProtocol::ResponseCheck RazerProtocol::checkFor(const RazerCommand& command) {
+    if (command.cmdClass == CMD_BATTERY.cmdClass && command.cmdId == CMD_BATTERY.cmdId) {
+        return acceptBattery;
+    }
+    if (command.cmdClass == CMD_CHARGING.cmdClass && command.cmdId == CMD_CHARGING.cmdId) {
+        return acceptCharging;
+    }
+    return acceptAnswered;
+}
+
+bool RazerProtocol::runQuery(const RazerCommand& command, RazerReport& report, uint8_t* response,
+                             ResponseCheck accept) {
+    report = requestFor(command);
+    report.setTransactionId(profile_.transactionId);
+    
+    // Steady state: the cached transaction ID answers in a single transfer
+    if (transact(report, response) && accept(profile_, response)) {
+        profile_.verified = true;
+        profile_.successStatus = response[0];
+        return true;
+    }
+    
+    // Profile failed - re-probe the other known transaction IDs and keep the winner
+    const uint8_t transIds[] = {0x1F, 0xFF, 0x3F};
+    uint8_t failedId = profile_.transactionId;
+    uint64_t retryNs = TransferStats::nowNs();
+    
+    for (uint8_t transId : transIds) {
+        if (transId == failedId) {
+            continue;
+        }
+        
+        // Transaction ID is outside the checksummed range - no re-sealing needed
+        report.setTransactionId(transId);
+        
+        if (transact(report, response) && accept(profile_, response)) {
+            std::cout << "Transaction ID 0x" << std::hex << (int)failedId << " failed, using 0x"
+                      << (int)transId << std::dec << std::endl;
+            profile_.transactionId = transId;
+            profile_.verified = true;
+            profile_.successStatus = response[0];
+            stats_.recordPhase(TransferPhase::Retry, TransferStats::elapsedUs(retryNs, TransferStats::nowNs()));
+            return true;
+        }
+    }
+    
+    stats_.recordPhase(TransferPhase::Retry, TransferStats::elapsedUs(retryNs, TransferStats::nowNs()));
+    profile_.verified = false;
+    return false;
+}
+
+bool RazerProtocol::decodeResponse(const RazerCommand& command, const uint8_t* response,
+                                   RazerSnapshot& snapshot) const {
+    RazerResponseView view(response);
+    uint8_t status = view.status();
+    
+    if (command.cmdClass == CMD_BATTERY.cmdClass && command.cmdId == CMD_BATTERY.cmdId) {
+        // Status 0x04 = Wired mode (command not supported = charging via cable)
+        uint32_t scaled = (view.byteAt(profile_.batteryOffset) * 100u) / profile_.batteryFullScale;
+        snapshot.batteryPercent = (status == 0x04) ? 100 : (uint8_t)std::min(scaled, 100u);
+        snapshot.batteryValid = true;
+        return true;
+    }
+    if (command.cmdClass == CMD_CHARGING.cmdClass && command.cmdId == CMD_CHARGING.cmdId) {
+        // Charging status is in Byte 11 (index 11) per debug analysis
+        snapshot.isCharging = (status == 0x04) || view.byteAt(profile_.chargingOffset) == 0x01;
+        snapshot.chargingValid = true;
+        return true;
+    }
+    if (!isDataStatus(status)) {
+        return false;  // Optional command not supported by this device
+    }
+    if (command.cmdClass == CMD_DPI.cmdClass && command.cmdId == CMD_DPI.cmdId) {
+        snapshot.dpiX = view.argU16(1);
+        snapshot.dpiY = view.argU16(3);
+        snapshot.dpiValid = true;
+    } else if (command.cmdClass == CMD_FIRMWARE.cmdClass && command.cmdId == CMD_FIRMWARE.cmdId) {
+        snapshot.firmwareMajor = view.arg(0);
+        snapshot.firmwareMinor = view.arg(1);
+        snapshot.firmwareValid = true;
+    } else if (command.cmdClass == CMD_IDLE_TIME.cmdClass && command.cmdId == CMD_IDLE_TIME.cmdId) {
+        snapshot.idleTimeSeconds = view.argU16(0);
+        snapshot.idleTimeValid = true;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool RazerProtocol::queryAll(const RazerCommand* commands, size_t count, RazerSnapshot& snapshot) {
+    if (transport_ == nullptr || !transport_->isOpen()) {
+        return false;
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    uint32_t sendsBefore = sendCount_;
+    bool anyData = false;
+    
+    // One request/response pair for the whole batch
+    RazerReport report;
+    uint8_t response[REPORT_SIZE];
+    
+    for (size_t i = 0; i < count; i++) {
+        if (runQuery(commands[i], report, response, checkFor(commands[i]))) {
+            anyData = decodeResponse(commands[i], response, snapshot) || anyData;
+        }
+    }
+    
+    snapshot.transfers = sendCount_ - sendsBefore;
+    snapshot.elapsedUs = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    return anyData;
+}
+
+bool RazerProtocol::queryBattery(uint8_t& batteryPercent) {
+    // Query battery level (Class 0x07, Command 0x80) using the cached profile
+    
+    if (transport_ == nullptr || !transport_->isOpen()) {
+        return false;
+    }
+    
+    RazerSnapshot snapshot;
+    if (!queryAll(&CMD_BATTERY, 1, snapshot)) {
+        batteryPercent = 0;
+        return false;
+    }
+    
+    batteryPercent = snapshot.batteryPercent;
+    return true;
+}
+
+bool RazerProtocol::queryChargingStatus(bool& isCharging) {
+    // Query charging status using Command 0x84 (per librazermacos)
+    
+    if (transport_ == nullptr || !transport_->isOpen()) {
+        isCharging = false;
+        return false;
+    }
+    
+    RazerSnapshot snapshot;
+    if (!queryAll(&CMD_CHARGING, 1, snapshot)) {
+        isCharging = false;
+        return false;
+    }
+    
+    isCharging = snapshot.isCharging;
+    return true;
+}
@@ -0,0 +1,155 @@
+#ifndef RAZER_PROTOCOL_HPP
+#define RAZER_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include "RazerEvents.hpp"
+#include "RazerReport.hpp"
+#include "RazerTransport.hpp"
+#include "ResponseWaiter.hpp"
+#include "TransferStats.hpp"
+
+// What worked for a device: which transaction ID it answers and where the data
+// sits in the response. Seeded from the supported device table (or the PID's
+// capability file) at connect time, reused for every query and only re-probed
+// after a query fails.
+struct RazerProtocolProfile {
+    uint8_t transactionId = 0x1F;       // 0x1F newer wireless, 0x3F / 0xFF older models
+    uint8_t batteryOffset = 9;          // Response byte holding the raw battery level
+    uint8_t batteryFullScale = 255;     // Raw battery level that means 100%
+    uint8_t chargingOffset = 11;        // Response byte holding 0x01 while charging
+    bool notSupportedMeansWired = true; // Status 0x04 = wired (assume 100% / charging)
+    uint8_t successStatus = 0x00;       // Status the device last answered with (0x00 or 0x02)
+    bool verified = false;              // Last query with this profile succeeded
+};
+
+// Everything one refresh learned about the device. Fields are only meaningful
+// when the matching *Valid flag is set.
+struct RazerSnapshot {
+    bool batteryValid = false;
+    uint8_t batteryPercent = 0;
+    bool chargingValid = false;
+    bool isCharging = false;
+    bool dpiValid = false;
+    uint16_t dpiX = 0;
+    uint16_t dpiY = 0;
+    bool firmwareValid = false;
+    uint8_t firmwareMajor = 0;
+    uint8_t firmwareMinor = 0;
+    bool idleTimeValid = false;
+    uint16_t idleTimeSeconds = 0;
+    uint32_t transfers = 0;   // SET_REPORT calls issued for this snapshot
+    uint32_t elapsedUs = 0;   // Wall time spent on the whole batch
+};
+
+// Platform-independent Razer 90-byte report protocol (battery, charging, mode).
+// All device I/O goes through a RazerTransport, so this class has no IOKit
+// dependency and can be driven by SimulatedRazerDevice on any POSIX system.
+// It is also the event sink: interrupt reports are parsed here and handed to
+// the event handler.
+class RazerProtocol : public RazerEventSink {
+public:
+    // Called on the transport's event thread for every parsed event report
+    typedef std::function<void(const RazerEvent& event)> EventHandler;
+
+    static constexpr size_t REPORT_SIZE = RazerReportLayout::SIZE;
+
+    // Known query commands (class, id, data size, args[0])
+    static constexpr RazerCommand CMD_BATTERY = {0x07, 0x80, 0x02, 0x00};
+    static constexpr RazerCommand CMD_CHARGING = {0x07, 0x84, 0x02, 0x00};
+    static constexpr RazerCommand CMD_IDLE_TIME = {0x07, 0x83, 0x02, 0x00};
+    static constexpr RazerCommand CMD_FIRMWARE = {0x00, 0x81, 0x02, 0x00};
+    static constexpr RazerCommand CMD_DPI = {0x04, 0x85, 0x07, 0x01};  // args[0]: VARSTORE
+    static constexpr RazerCommand CMD_DEVICE_MODE = {0x00, 0x84, 0x02, 0x00};
+    
+    static constexpr uint8_t DRIVER_MODE = 0x03;  // Device mode that enables battery queries
+
+    explicit RazerProtocol(RazerTransport* transport = nullptr);
+
+    void setTransport(RazerTransport* transport) { transport_ = transport; }
+    RazerTransport* transport() const { return transport_; }
+
+    bool queryBattery(uint8_t& batteryPercent);
+    bool queryChargingStatus(bool& isCharging);
+    bool setDeviceMode(uint8_t mode, uint8_t param);
+    
+    // Reads the current device mode (args[0] of get-mode 0x00/0x84)
+    bool queryDeviceMode(uint8_t& mode);
+
+    // Liveness probe: true if the device answers one firmware query at all
+    bool ping();
+
+    // Set the handler before startEvents(); it must not be changed while active
+    void setEventHandler(EventHandler handler) { eventHandler_ = handler; }
+    bool startEvents();
+    void stopEvents();
+    bool eventsActive() const { return eventsActive_; }
+    uint64_t eventCount() const { return eventCount_; }
+
+    // RazerEventSink
+    void onEventReport(const uint8_t* data, size_t length) override;
+
+    // Folds a Battery / Charging / Dpi event into snapshot; false for events that
+    // carry no state (refresh over control transfers instead)
+    static bool applyEvent(const RazerEvent& event, RazerSnapshot& snapshot);
+
+    // Runs all commands back to back into one snapshot. The device holds a single
+    // report buffer, so commands cannot overlap on the wire; instead the batch
+    // reuses one request buffer, issues each SET_REPORT as soon as the previous
+    // answer is read and waits only the learned turnaround per command.
+    // Returns true if at least one command produced data.
+    bool queryAll(const RazerCommand* commands, size_t count, RazerSnapshot& snapshot);
+
+    void setProfile(const RazerProtocolProfile& profile) { profile_ = profile; }
+    const RazerProtocolProfile& profile() const { return profile_; }
+
+    // Learned command turnaround for this device (0 until the first response)
+    uint32_t typicalTurnaroundUs() const { return responseWaiter_.typicalTurnaroundUs(); }
+    const ResponseWaiter& responseWaiter() const { return responseWaiter_; }
+    // Replaces the wait timing (and forgets the learned turnaround)
+    void setResponseWaitPolicy(const ResponseWaitPolicy& policy) { responseWaiter_ = ResponseWaiter(policy); }
+    // Turnaround known in advance (capability file): the first read is timed
+    // on it instead of the policy minimum
+    void seedTurnaroundUs(uint32_t turnaroundUs) { responseWaiter_.seedTurnaroundUs(turnaroundUs); }
+
+    // Latency histograms and status counts of every transfer on this protocol.
+    // Recorded on the thread issuing commands; readable from any thread.
+    const TransferStats& transferStats() const { return stats_; }
+    TransferStats& transferStats() { return stats_; }
+
+    // Request report for a command: a copy of the compile-time template for the
+    // known commands above, built at runtime for anything else
+    static RazerReport requestFor(const RazerCommand& command);
+
+    static void calculateChecksum(uint8_t* report);
+    static bool verifyChecksum(const uint8_t* report);
+
+private:
+    RazerTransport* transport_;
+
+    // Adaptive GET_REPORT polling (replaces fixed sleeps between send and read)
+    ResponseWaiter responseWaiter_;
+
+    RazerProtocolProfile profile_;
+    uint32_t sendCount_;  // SET_REPORT calls issued, for per-batch transfer counts
+    TransferStats stats_;
+
+    EventHandler eventHandler_;
+    bool eventsActive_;
+    uint64_t eventCount_;  // Event thread only
+
+    typedef bool (*ResponseCheck)(const RazerProtocolProfile& profile, const uint8_t* response);
+
+    bool transact(const RazerReport& report, uint8_t* response);
+    bool runQuery(const RazerCommand& command, RazerReport& report, uint8_t* response, ResponseCheck accept);
+    bool decodeResponse(const RazerCommand& command, const uint8_t* response, RazerSnapshot& snapshot) const;
+
+    static bool isDataStatus(uint8_t status);
+    static bool acceptBattery(const RazerProtocolProfile& profile, const uint8_t* response);
+    static bool acceptCharging(const RazerProtocolProfile& profile, const uint8_t* response);
+    static bool acceptAnswered(const RazerProtocolProfile& profile, const uint8_t* response);
+    static ResponseCheck checkFor(const RazerCommand& command);
+};
+
+#endif // RAZER_PROTOCOL_HPP
@@ -0,0 +1,128 @@
+#ifndef RAZER_REPORT_HPP
+#define RAZER_REPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// One Razer query command: class/id, request data size and first argument byte
+struct RazerCommand {
+    uint8_t cmdClass;
+    uint8_t cmdId;
+    uint8_t dataSize;
+    uint8_t arg0;
+};
+
+// Byte layout of the 90-byte Razer feature report (without the HID report ID)
+namespace RazerReportLayout {
+    constexpr size_t SIZE = 90;
+    constexpr size_t STATUS = 0;           // 0x00 new command / 0x01 busy / 0x02 data ready ...
+    constexpr size_t TRANSACTION_ID = 1;   // 0x1F newer wireless, 0x3F / 0xFF older models
+    constexpr size_t REMAINING_PACKETS = 2;  // 2 bytes, big endian
+    constexpr size_t PROTOCOL_TYPE = 4;
+    constexpr size_t DATA_SIZE = 5;
+    constexpr size_t COMMAND_CLASS = 6;
+    constexpr size_t COMMAND_ID = 7;
+    constexpr size_t ARGS = 8;             // 80 argument bytes
+    constexpr size_t ARGS_SIZE = 80;
+    constexpr size_t CHECKSUM = 88;        // XOR of bytes 2-87
+    constexpr size_t RESERVED = 89;
+
+    constexpr size_t CHECKSUM_FIRST = 2;
+    constexpr size_t CHECKSUM_END = 88;
+}
+
+constexpr uint8_t razerChecksum(const uint8_t* bytes) {
+    uint8_t checksum = 0;
+    for (size_t i = RazerReportLayout::CHECKSUM_FIRST; i < RazerReportLayout::CHECKSUM_END; ++i) {
+        checksum ^= bytes[i];
+    }
+    return checksum;
+}
+
+// A complete request report. Literal type, so fixed commands are built (checksum
+// included) at compile time and a query only copies the template.
+struct RazerReport {
+    uint8_t bytes[RazerReportLayout::SIZE] = {};
+
+    constexpr uint8_t* data() { return bytes; }
+    constexpr const uint8_t* data() const { return bytes; }
+
+    // Status and transaction ID are outside the checksummed range
+    constexpr void setStatus(uint8_t status) { bytes[RazerReportLayout::STATUS] = status; }
+    constexpr void setTransactionId(uint8_t transactionId) {
+        bytes[RazerReportLayout::TRANSACTION_ID] = transactionId;
+    }
+    constexpr void seal() { bytes[RazerReportLayout::CHECKSUM] = razerChecksum(bytes); }
+    constexpr bool checksumValid() const {
+        return bytes[RazerReportLayout::CHECKSUM] == razerChecksum(bytes);
+    }
+};
+
+// Fluent compile-time builder: RazerReportBuilder().command(CMD).arg(1, x).build()
+class RazerReportBuilder {
+public:
+    constexpr RazerReportBuilder& status(uint8_t value) {
+        report_.bytes[RazerReportLayout::STATUS] = value;
+        return *this;
+    }
+    constexpr RazerReportBuilder& transactionId(uint8_t value) {
+        report_.bytes[RazerReportLayout::TRANSACTION_ID] = value;
+        return *this;
+    }
+    constexpr RazerReportBuilder& command(const RazerCommand& command) {
+        report_.bytes[RazerReportLayout::DATA_SIZE] = command.dataSize;
+        report_.bytes[RazerReportLayout::COMMAND_CLASS] = command.cmdClass;
+        report_.bytes[RazerReportLayout::COMMAND_ID] = command.cmdId;
+        report_.bytes[RazerReportLayout::ARGS] = command.arg0;
+        return *this;
+    }
+    constexpr RazerReportBuilder& arg(size_t index, uint8_t value) {
+        report_.bytes[RazerReportLayout::ARGS + index] = value;
+        return *this;
+    }
+    constexpr RazerReport build() const {
+        RazerReport report = report_;
+        report.seal();
+        return report;
+    }
+
+private:
+    RazerReport report_;
+};
+
+// Zero-copy view of a report read back from the device. Does not own the bytes;
+// valid only while the buffer it points into is.
+class RazerResponseView {
+public:
+    constexpr explicit RazerResponseView(const uint8_t* bytes) : bytes_(bytes) {}
+
+    constexpr uint8_t status() const { return bytes_[RazerReportLayout::STATUS]; }
+    constexpr uint8_t transactionId() const { return bytes_[RazerReportLayout::TRANSACTION_ID]; }
+    constexpr uint8_t dataSize() const { return bytes_[RazerReportLayout::DATA_SIZE]; }
+    constexpr uint8_t commandClass() const { return bytes_[RazerReportLayout::COMMAND_CLASS]; }
+    constexpr uint8_t commandId() const { return bytes_[RazerReportLayout::COMMAND_ID]; }
+    constexpr uint8_t arg(size_t index) const { return bytes_[RazerReportLayout::ARGS + index]; }
+    constexpr uint16_t argU16(size_t index) const {
+        return (uint16_t)((arg(index) << 8) | arg(index + 1));  // Big endian
+    }
+    constexpr uint8_t byteAt(size_t offset) const { return bytes_[offset]; }
+    constexpr const uint8_t* args() const { return bytes_ + RazerReportLayout::ARGS; }
+    constexpr const uint8_t* data() const { return bytes_; }
+
+    constexpr bool checksumValid() const {
+        return bytes_[RazerReportLayout::CHECKSUM] == razerChecksum(bytes_);
+    }
+    constexpr bool isCommand(const RazerCommand& command) const {
+        return commandClass() == command.cmdClass && commandId() == command.cmdId;
+    }
+    // Device has echoed the class/id of the given request
+    constexpr bool echoes(const uint8_t* request) const {
+        return commandClass() == request[RazerReportLayout::COMMAND_CLASS] &&
+               commandId() == request[RazerReportLayout::COMMAND_ID];
+    }
+
+private:
+    const uint8_t* bytes_;
+};
+
+#endif // RAZER_REPORT_HPP
@@ -0,0 +1,244 @@
+#include "RazerTrace.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+constexpr char MAGIC[8] = {'R', 'Z', 'T', 'R', 'A', 'C', 'E', '1'};
+constexpr uint32_t VERSION = 1;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordHeaderSize;
+    uint64_t startWallMs;   // Wall clock (Unix ms) when the file was opened
+    uint8_t padding[8];
+};
+static_assert(sizeof(TraceHeader) == 32, "Trace header must stay 32 bytes on disk");
+
+uint64_t steadyNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t wallClockMs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+RazerTraceWriter::RazerTraceWriter()
+    : file_(nullptr),
+      lastNs_(0),
+      records_(0) {
+}
+
+RazerTraceWriter::~RazerTraceWriter() {
+    close();
+}
+
+bool RazerTraceWriter::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ != nullptr) {
+        return false;
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Trace: cannot create " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    TraceHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.recordHeaderSize = sizeof(RazerTraceRecordHeader);
+    header.startWallMs = wallClockMs();
+    if (fwrite(&header, sizeof(header), 1, file) != 1 || fflush(file) != 0) {
+        fclose(file);
+        return false;
+    }
+
+    file_ = file;
+    lastNs_ = 0;
+    records_ = 0;
+    return true;
+}
+
+void RazerTraceWriter::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ != nullptr) {
+        fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool RazerTraceWriter::isOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_ != nullptr;
+}
+
+uint64_t RazerTraceWriter::recordCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_;
+}
+
+void RazerTraceWriter::append(RazerTraceKind kind, bool ok, const uint8_t* data, size_t length) {
+    uint64_t now = steadyNs();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_ == nullptr) {
+        return;
+    }
+
+    RazerTraceRecordHeader record;
+    uint64_t deltaUs = (records_ == 0 || now < lastNs_) ? 0 : (now - lastNs_) / 1000;
+    record.deltaUs = deltaUs > UINT32_MAX ? UINT32_MAX : (uint32_t)deltaUs;
+    record.kind = kind;
+    record.flags = ok ? TRACE_FLAG_OK : 0;
+    record.length = (uint16_t)(length > UINT16_MAX ? UINT16_MAX : length);
+    lastNs_ = now;
+
+    // One write per record: USB transfers take milliseconds, a flush microseconds
+    if (fwrite(&record, sizeof(record), 1, file_) != 1 ||
+        (record.length != 0 && fwrite(data, record.length, 1, file_) != 1) ||
+        fflush(file_) != 0) {
+        std::cerr << "Trace: write failed, stopping capture" << std::endl;
+        fclose(file_);
+        file_ = nullptr;
+        return;
+    }
+    records_++;
+}
+
+void RazerTraceWriter::appendProfile(uint16_t pid, const RazerProtocolProfile& profile) {
+    RazerTraceProfile record;
+    record.pid = pid;
+    record.transactionId = profile.transactionId;
+    record.batteryOffset = profile.batteryOffset;
+    record.chargingOffset = profile.chargingOffset;
+    record.notSupportedMeansWired = profile.notSupportedMeansWired ? 1 : 0;
+    record.batteryFullScale = profile.batteryFullScale;
+    record.reserved = 0;
+    append(TRACE_PROFILE, true, reinterpret_cast<const uint8_t*>(&record), sizeof(record));
+}
+
+RazerTraceReader::RazerTraceReader()
+    : startWallMs_(0) {
+}
+
+bool RazerTraceReader::load(const std::string& path) {
+    bytes_.clear();
+    records_.clear();
+    startWallMs_ = 0;
+
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        bytes_.insert(bytes_.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    TraceHeader header;
+    if (bytes_.size() < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, bytes_.data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION ||
+        header.recordHeaderSize != sizeof(RazerTraceRecordHeader)) {
+        return false;
+    }
+    startWallMs_ = header.startWallMs;
+
+    // Nearly every record is a full report: one allocation for the index
+    records_.reserve((bytes_.size() - sizeof(header)) / (sizeof(RazerTraceRecordHeader) + RazerProtocol::REPORT_SIZE) + 1);
+    size_t offset = sizeof(header);
+    uint64_t timeUs = 0;
+    while (offset + sizeof(RazerTraceRecordHeader) <= bytes_.size()) {
+        RazerTraceRecordHeader stored;
+        std::memcpy(&stored, bytes_.data() + offset, sizeof(stored));
+        offset += sizeof(stored);
+        if (offset + stored.length > bytes_.size()) {
+            break;  // Torn tail
+        }
+
+        timeUs += stored.deltaUs;
+        RazerTraceRecord record;
+        record.timeUs = timeUs;
+        record.kind = stored.kind;
+        record.ok = (stored.flags & TRACE_FLAG_OK) != 0;
+        record.length = stored.length;
+        record.data = bytes_.data() + offset;  // bytes_ no longer grows
+        records_.push_back(record);
+        offset += stored.length;
+    }
+    return true;
+}
+
+bool RazerTraceReader::readProfile(const RazerTraceRecord& record, uint16_t& pid, RazerProtocolProfile& profile) {
+    // Older traces stop after notSupportedMeansWired
+    if (record.kind != TRACE_PROFILE || record.length < offsetof(RazerTraceProfile, batteryFullScale)) {
+        return false;
+    }
+    RazerTraceProfile stored;
+    std::memset(&stored, 0, sizeof(stored));
+    std::memcpy(&stored, record.data, std::min<size_t>(record.length, sizeof(stored)));
+    pid = stored.pid;
+    profile = RazerProtocolProfile();
+    profile.transactionId = stored.transactionId;
+    profile.batteryOffset = stored.batteryOffset;
+    profile.chargingOffset = stored.chargingOffset;
+    profile.notSupportedMeansWired = stored.notSupportedMeansWired != 0;
+    if (stored.batteryFullScale != 0) {
+        profile.batteryFullScale = stored.batteryFullScale;
+    }
+    return true;
+}
+
+TracingTransport::TracingTransport(RazerTransport* inner, RazerTraceWriter* writer)
+    : inner_(inner),
+      writer_(writer),
+      sink_(nullptr) {
+}
+
+bool TracingTransport::sendReport(const uint8_t* report) {
+    bool ok = inner_->sendReport(report);
+    writer_->append(TRACE_SEND, ok, report, RazerProtocol::REPORT_SIZE);
+    return ok;
+}
+
+bool TracingTransport::readResponse(uint8_t* buffer, size_t bufferSize) {
+    bool ok = inner_->readResponse(buffer, bufferSize);
+    writer_->append(TRACE_READ, ok, buffer, ok ? RazerProtocol::REPORT_SIZE : 0);
+    return ok;
+}
+
+bool TracingTransport::startEvents(RazerEventSink* sink) {
+    sink_ = sink;
+    if (!inner_->startEvents(this)) {
+        sink_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void TracingTransport::stopEvents() {
+    inner_->stopEvents();  // No more onEventReport calls after this
+    sink_ = nullptr;
+}
+
+void TracingTransport::onEventReport(const uint8_t* data, size_t length) {
+    writer_->append(TRACE_EVENT, true, data, length);
+    if (sink_ != nullptr) {
+        sink_->onEventReport(data, length);
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef RAZER_TRACE_HPP
+#define RAZER_TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "RazerProtocol.hpp"
+#include "RazerTransport.hpp"
+
+// Binary capture of everything that crossed a RazerTransport, for replaying
+// protocol bugs and latency spikes without the mouse (see TraceReplay).
+//
+// Layout (little endian as laid out in memory): a 32-byte header (magic,
+// version, wall clock of the first record) followed by variable-length records,
+// each an 8-byte RazerTraceRecordHeader plus `length` payload bytes. Times are
+// deltas from the previous record, so a record costs 98 bytes for a 90-byte
+// report. A torn last record (crash mid-write) is dropped on load.
+enum RazerTraceKind : uint8_t {
+    TRACE_SEND = 1,     // SET_REPORT request (90 bytes)
+    TRACE_READ = 2,     // GET_REPORT answer (90 bytes, 0 if the read failed)
+    TRACE_EVENT = 3,    // Interrupt IN report (its own length)
+    TRACE_PROFILE = 4   // Protocol profile in effect from here on (RazerTraceProfile)
+};
+
+constexpr uint8_t TRACE_FLAG_OK = 0x01;  // Transport call succeeded
+
+struct RazerTraceRecordHeader {
+    uint32_t deltaUs;   // Since the previous record (saturated)
+    uint8_t kind;       // RazerTraceKind
+    uint8_t flags;      // TRACE_FLAG_*
+    uint16_t length;    // Payload bytes that follow
+};
+static_assert(sizeof(RazerTraceRecordHeader) == 8, "Trace record header must stay 8 bytes on disk");
+
+// TRACE_PROFILE payload: what the device was connected with
+struct RazerTraceProfile {
+    uint16_t pid;
+    uint8_t transactionId;
+    uint8_t batteryOffset;
+    uint8_t chargingOffset;
+    uint8_t notSupportedMeansWired;
+    uint8_t batteryFullScale;   // 0 in traces written before it was recorded (= 255)
+    uint8_t reserved;
+};
+static_assert(sizeof(RazerTraceProfile) == 8, "Trace profile must stay 8 bytes on disk");
+
+// One loaded record; data points into the reader's buffer
+struct RazerTraceRecord {
+    uint64_t timeUs;    // Since the first record
+    uint8_t kind;
+    bool ok;
+    uint16_t length;
+    const uint8_t* data;
+};
+
+// Appends records to a trace file. Any thread: the worker records transfers
+// while the run loop records events.
+class RazerTraceWriter {
+public:
+    RazerTraceWriter();
+    ~RazerTraceWriter();
+
+    RazerTraceWriter(const RazerTraceWriter&) = delete;
+    RazerTraceWriter& operator=(const RazerTraceWriter&) = delete;
+
+    // Truncates or creates the file and writes the header
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    // Each record is flushed to the file, so a crash loses at most the one being written
+    void append(RazerTraceKind kind, bool ok, const uint8_t* data, size_t length);
+    void appendProfile(uint16_t pid, const RazerProtocolProfile& profile);
+
+    uint64_t recordCount() const;
+
+private:
+    mutable std::mutex mutex_;
+    FILE* file_;
+    uint64_t lastNs_;
+    uint64_t records_;
+};
+
+// Loads a whole trace into memory
+class RazerTraceReader {
+public:
+    RazerTraceReader();
+
+    RazerTraceReader(const RazerTraceReader&) = delete;
+    RazerTraceReader& operator=(const RazerTraceReader&) = delete;
+
+    // False if missing or not a trace; a torn tail is dropped, not an error
+    bool load(const std::string& path);
+
+    const std::vector<RazerTraceRecord>& records() const { return records_; }
+    uint64_t startWallMs() const { return startWallMs_; }
+    uint64_t durationUs() const { return records_.empty() ? 0 : records_.back().timeUs; }
+
+    static bool readProfile(const RazerTraceRecord& record, uint16_t& pid, RazerProtocolProfile& profile);
+
+private:
+    std::vector<uint8_t> bytes_;
+    std::vector<RazerTraceRecord> records_;
+    uint64_t startWallMs_;
+};
+
+// RazerTransport decorator that records every report passing through the
+// wrapped transport (and every event report it delivers) into a writer.
+class TracingTransport : public RazerTransport, private RazerEventSink {
+public:
+    TracingTransport(RazerTransport* inner, RazerTraceWriter* writer);
+
+    // RazerTransport
+    bool sendReport(const uint8_t* report) override;
+    bool readResponse(uint8_t* buffer, size_t bufferSize) override;
+    bool isOpen() const override { return inner_->isOpen(); }
+    bool startEvents(RazerEventSink* sink) override;
+    void stopEvents() override;
+    void setTransferTimeoutMs(uint32_t timeoutMs) override { inner_->setTransferTimeoutMs(timeoutMs); }
+    void abortTransfer() override { inner_->abortTransfer(); }
+
+private:
+    RazerTransport* inner_;
+    RazerTraceWriter* writer_;
+    RazerEventSink* sink_;
+
+    // RazerEventSink
+    void onEventReport(const uint8_t* data, size_t length) override;
+};
+
+#endif // RAZER_TRACE_HPP
@@ -0,0 +1,47 @@
+#ifndef RAZER_TRANSPORT_HPP
+#define RAZER_TRANSPORT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// Receives unsolicited reports from a device's interrupt IN pipe
+class RazerEventSink {
+public:
+    virtual ~RazerEventSink() {}
+    virtual void onEventReport(const uint8_t* data, size_t length) = 0;
+};
+
+// Moves one 90-byte Razer feature report to or from a device.
+//
+// RazerProtocol only talks to this interface, so the same query logic runs
+// against IOKit (IOKitTransport) or the in-process SimulatedRazerDevice.
+class RazerTransport {
+public:
+    virtual ~RazerTransport() {}
+
+    // SET_REPORT: report is REPORT_SIZE bytes
+    virtual bool sendReport(const uint8_t* report) = 0;
+
+    // GET_REPORT: fills at least REPORT_SIZE bytes of buffer
+    virtual bool readResponse(uint8_t* buffer, size_t bufferSize) = 0;
+
+    virtual bool isOpen() const = 0;
+
+    // Starts delivering interrupt IN reports to sink, on the transport's own
+    // event thread, until stopEvents(). False if the transport has no event
+    // pipe (the caller keeps polling).
+    virtual bool startEvents(RazerEventSink* sink) { (void)sink; return false; }
+
+    // Once this returns the sink is no longer called
+    virtual void stopEvents() {}
+
+    // Deadline for each following send or read, for transports that can give
+    // up on a request themselves (0 = none)
+    virtual void setTransferTimeoutMs(uint32_t timeoutMs) { (void)timeoutMs; }
+
+    // Called from another thread (TransferWatchdog) while a send or read is
+    // stuck: make it return false soon. No-op where nothing can be aborted.
+    virtual void abortTransfer() {}
+};
+
+#endif // RAZER_TRANSPORT_HPP
@@ -0,0 +1,89 @@
+#include "ResponseWaiter.hpp"
+#include "RazerReport.hpp"
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+
+namespace {
+
+uint32_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    auto delta = std::chrono::steady_clock::now() - start;
+    return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(delta).count();
+}
+
+} // namespace
+
+ResponseWaiter::ResponseWaiter(const ResponseWaitPolicy& policy)
+    : policy_(policy),
+      turnaroundUs_(0),
+      lastTurnaroundUs_(0),
+      lastReadCount_(0) {
+}
+
+void ResponseWaiter::reset() {
+    turnaroundUs_ = 0;
+    lastTurnaroundUs_ = 0;
+    lastReadCount_ = 0;
+}
+
+bool ResponseWaiter::isPending(const uint8_t* request, const uint8_t* response) {
+    RazerResponseView view(response);
+    if (view.status() == 0x01) {
+        return true;  // Busy
+    }
+    // Byte 6/7 echo the command class/id once the device has processed the request
+    return !view.echoes(request);
+}
+
+uint32_t ResponseWaiter::initialDelayUs() const {
+    if (turnaroundUs_ == 0) {
+        return policy_.minInitialDelayUs;
+    }
+    // Aim slightly below the typical turnaround so the estimate can shrink again
+    // when the device gets faster; a miss only costs one short backoff step.
+    uint32_t delay = turnaroundUs_ - turnaroundUs_ / 4;
+    return std::min(std::max(delay, policy_.minInitialDelayUs), policy_.maxInitialDelayUs);
+}
+
+void ResponseWaiter::learn(uint32_t sampleUs) {
+    lastTurnaroundUs_ = sampleUs;
+    if (turnaroundUs_ == 0) {
+        turnaroundUs_ = sampleUs;
+    } else {
+        turnaroundUs_ = (turnaroundUs_ * 7 + sampleUs) / 8;  // EWMA, alpha = 1/8
+    }
+}
+
+ResponseWaiter::Result ResponseWaiter::wait(const uint8_t* request, uint8_t* response,
+                                            size_t responseSize, const ReadFunction& read) {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t backoffUs = policy_.firstBackoffUs;
+    lastReadCount_ = 0;
+
+    uint32_t delayUs = initialDelayUs();
+    if (delayUs != 0) {
+        usleep(delayUs);
+    }
+
+    while (true) {
+        lastReadCount_++;
+        if (!read(response, responseSize)) {
+            return Result::ReadError;
+        }
+        if (!isPending(request, response)) {
+            learn(elapsedUs(start));
+            return Result::Ready;
+        }
+
+        uint32_t elapsed = elapsedUs(start);
+        if (elapsed >= policy_.deadlineUs) {
+            // Count the full deadline so the next first read starts later
+            learn(policy_.deadlineUs);
+            return Result::TimedOut;
+        }
+        if (backoffUs != 0) {
+            usleep(std::min(backoffUs, policy_.deadlineUs - elapsed));
+        }
+        backoffUs = std::min(backoffUs * 2, policy_.maxBackoffUs);
+    }
+}
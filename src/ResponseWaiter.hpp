@@ -0,0 +1,63 @@
+#ifndef RESPONSE_WAITER_HPP
+#define RESPONSE_WAITER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Timing knobs for waiting on a Razer GET_REPORT response (all microseconds)
+struct ResponseWaitPolicy {
+    uint32_t minInitialDelayUs = 2000;    // Never read back sooner than this
+    uint32_t maxInitialDelayUs = 100000;  // Cap for the learned first-read delay
+    uint32_t firstBackoffUs = 1000;       // Sleep after the first pending read
+    uint32_t maxBackoffUs = 25000;        // Backoff doubles up to this value
+    uint32_t deadlineUs = 500000;         // Hard limit for one command
+};
+
+// Polls GET_REPORT after a SET_REPORT until the device has answered the command.
+//
+// Replaces the fixed usleep(100000) between sendReport and readResponse: the first
+// read happens after the device's learned typical turnaround, later reads back off
+// exponentially, and the whole wait is bounded by a hard deadline.
+class ResponseWaiter {
+public:
+    enum class Result {
+        Ready,      // Response for our command is in the buffer
+        ReadError,  // Transport failed to read
+        TimedOut    // Device was still busy when the deadline passed
+    };
+
+    typedef std::function<bool(uint8_t* buffer, size_t bufferSize)> ReadFunction;
+
+    explicit ResponseWaiter(const ResponseWaitPolicy& policy = ResponseWaitPolicy());
+
+    // request: the report just sent (used to match the echoed class/id)
+    Result wait(const uint8_t* request, uint8_t* response, size_t responseSize,
+                const ReadFunction& read);
+
+    // A response is pending while the device reports busy (0x01) or has not yet
+    // echoed our command class/id. Status 0x02 with the echo present is "busy with
+    // data ready" on these devices and is treated as answered.
+    static bool isPending(const uint8_t* request, const uint8_t* response);
+
+    uint32_t typicalTurnaroundUs() const { return turnaroundUs_; }
+    uint32_t lastTurnaroundUs() const { return lastTurnaroundUs_; }
+    uint32_t lastReadCount() const { return lastReadCount_; }
+    const ResponseWaitPolicy& policy() const { return policy_; }
+    // Deadline for the following waits; the learned turnaround is kept
+    void setDeadlineUs(uint32_t deadlineUs) { policy_.deadlineUs = deadlineUs; }
+    // Starts the estimate from a known turnaround; replaces the learned one
+    void seedTurnaroundUs(uint32_t turnaroundUs) { turnaroundUs_ = turnaroundUs; }
+    void reset();
+
+private:
+    ResponseWaitPolicy policy_;
+    uint32_t turnaroundUs_;      // EWMA of observed turnaround, 0 = not learned yet
+    uint32_t lastTurnaroundUs_;
+    uint32_t lastReadCount_;
+
+    uint32_t initialDelayUs() const;
+    void learn(uint32_t sampleUs);
+};
+
+#endif // RESPONSE_WAITER_HPP
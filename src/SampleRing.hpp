@@ -0,0 +1,66 @@
+#ifndef SAMPLE_RING_HPP
+#define SAMPLE_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-capacity single-producer / single-consumer ring buffer.
+//
+// One thread calls push() (the device worker), one other thread calls pop()
+// (the main thread). No locks and no allocation after construction: storage is
+// an inline array and the two indices live on separate cache lines so producer
+// and consumer do not false-share. When full, push() drops the new item and
+// counts it - the consumer drains often enough that this only happens if the UI
+// stalls, and keeping the older, contiguous history is more useful then.
+template <typename T, size_t Capacity>
+class SampleRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                  "SampleRing capacity must be a power of two");
+
+public:
+    SampleRing() : head_(0), tail_(0), dropped_(0) {}
+
+    SampleRing(const SampleRing&) = delete;
+    SampleRing& operator=(const SampleRing&) = delete;
+
+    // Producer thread only
+    bool push(const T& item) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == Capacity) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items_[head & (Capacity - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only
+    bool pop(T& item) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = items_[tail & (Capacity - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with push/pop
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+    static constexpr size_t capacity() { return Capacity; }
+    uint64_t droppedCount() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    alignas(CACHE_LINE) std::atomic<size_t> head_;  // Written by the producer
+    alignas(CACHE_LINE) std::atomic<size_t> tail_;  // Written by the consumer
+    alignas(CACHE_LINE) std::atomic<uint64_t> dropped_;
+    T items_[Capacity];
+};
+
+#endif // SAMPLE_RING_HPP
@@ -0,0 +1,327 @@
+#include "SharedStatus.hpp"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char MAGIC[8] = {'R', 'Z', 'S', 'T', 'A', 'T', '0', '1'};
+constexpr uint32_t VERSION = 1;
+constexpr size_t WORDS = sizeof(SharedDeviceSnapshot) / sizeof(uint64_t);
+constexpr size_t MAX_DEVICES = SharedStatusWriter::MAX_DEVICES;
+constexpr int SPIN_ATTEMPTS = 64;        // Then yield: the writer may be preempted mid-record
+constexpr int MAX_READ_ATTEMPTS = 1000;  // A writer that died mid-record leaves it odd
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordCount;
+    uint32_t recordSize;
+    std::atomic<int32_t> writerPid;     // 0 once the writer closed the segment
+    std::atomic<uint64_t> generation;   // Bumped after every record store
+    uint8_t padding[32];
+};
+
+// Own cache line(s) per record, so writing one device does not disturb readers of another
+struct alignas(64) SegmentRecord {
+    std::atomic<uint64_t> sequence;     // Odd while the writer is inside
+    std::atomic<uint64_t> words[WORDS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared atomics must not need a lock");
+static_assert(std::atomic<int32_t>::is_always_lock_free, "Shared atomics must not need a lock");
+static_assert(sizeof(SegmentHeader) == 64, "Shared status header must stay 64 bytes");
+static_assert(sizeof(SegmentRecord) == 128, "Shared status record must stay 128 bytes");
+
+constexpr size_t SEGMENT_SIZE = sizeof(SegmentHeader) + MAX_DEVICES * sizeof(SegmentRecord);
+
+SegmentHeader* headerOf(const void* base) {
+    return static_cast<SegmentHeader*>(const_cast<void*>(base));
+}
+
+SegmentRecord* recordsOf(const void* base) {
+    return reinterpret_cast<SegmentRecord*>(static_cast<uint8_t*>(const_cast<void*>(base)) + sizeof(SegmentHeader));
+}
+
+bool isSegment(const void* base) {
+    const SegmentHeader* header = headerOf(base);
+    return std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+           header->version == VERSION &&
+           header->recordCount == MAX_DEVICES &&
+           header->recordSize == sizeof(SegmentRecord);
+}
+
+bool processAlive(int32_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// Read-only mapping of an existing segment, or nullptr
+const void* mapSegment(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    void* base = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= SEGMENT_SIZE) {
+        base = mmap(nullptr, SEGMENT_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);  // The mapping keeps the file alive
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    if (!isSegment(base)) {
+        munmap(base, SEGMENT_SIZE);
+        return nullptr;
+    }
+    return base;
+}
+
+} // namespace
+
+std::string defaultSharedStatusPath() {
+    const char* tmp = getenv("TMPDIR");
+    if (tmp != nullptr && tmp[0] != '\0') {
+        std::string dir(tmp);
+        if (dir.back() != '/') {
+            dir += '/';
+        }
+        return dir + "razer-battery.status";
+    }
+    return "/tmp/razer-battery-" + std::to_string(getuid()) + ".status";
+}
+
+SharedStatusWriter::SharedStatusWriter()
+    : base_(nullptr) {
+    std::memset(ids_, 0, sizeof(ids_));
+}
+
+SharedStatusWriter::~SharedStatusWriter() {
+    close();
+}
+
+bool SharedStatusWriter::open(const std::string& path) {
+    if (isOpen()) {
+        return false;
+    }
+
+    const void* existing = mapSegment(path);
+    if (existing != nullptr) {
+        int32_t pid = headerOf(existing)->writerPid.load(std::memory_order_acquire);
+        munmap(const_cast<void*>(existing), SEGMENT_SIZE);
+        if (pid != getpid() && processAlive(pid)) {
+            std::cerr << "Shared status: " << path << " is written by process " << pid << std::endl;
+            return false;
+        }
+    }
+
+    // Never shrink a file readers may have mapped (they would fault): replace it.
+    // Readers of the old file see a dead writer and reopen.
+    unlink(path.c_str());
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Shared status: cannot create " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, (off_t)SEGMENT_SIZE) == 0) {
+        base = mmap(nullptr, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        unlink(path.c_str());
+        return false;
+    }
+
+    // Fresh file is zero-filled: every record is unused with an even sequence
+    SegmentHeader* header = headerOf(base);
+    header->version = VERSION;
+    header->recordCount = MAX_DEVICES;
+    header->recordSize = sizeof(SegmentRecord);
+    header->writerPid.store(getpid(), std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+
+    path_ = path;
+    base_ = base;
+    std::memset(ids_, 0, sizeof(ids_));
+    return true;
+}
+
+void SharedStatusWriter::close() {
+    if (base_ == nullptr) {
+        return;
+    }
+    // Readers still mapping the file see no devices and no writer
+    SharedDeviceSnapshot empty;
+    std::memset(&empty, 0, sizeof(empty));
+    for (size_t i = 0; i < MAX_DEVICES; i++) {
+        if (ids_[i] != 0) {
+            store(i, empty);
+            ids_[i] = 0;
+        }
+    }
+    headerOf(base_)->writerPid.store(0, std::memory_order_release);
+
+    munmap(base_, SEGMENT_SIZE);
+    base_ = nullptr;
+    unlink(path_.c_str());
+}
+
+SharedDeviceSnapshot SharedStatusWriter::makeSnapshot(const DeviceStatus& status) {
+    SharedDeviceSnapshot snapshot;
+    std::memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.id = status.id;
+    snapshot.pid = status.pid;
+    snapshot.batteryPercent = status.batteryPercent;
+    snapshot.connected = status.connected;
+    snapshot.batteryValid = status.batteryValid;
+    snapshot.charging = status.charging;
+    snapshot.estimateValid = status.estimateValid;
+    snapshot.estimateToFull = status.estimateToFull;
+    snapshot.timeMs = status.timeMs;
+    snapshot.estimateMs = status.estimateMs;
+    std::strncpy(snapshot.name, status.name.c_str(), sizeof(snapshot.name) - 1);
+    return snapshot;
+}
+
+bool SharedStatusWriter::publish(const DeviceStatus& status) {
+    return publish(makeSnapshot(status));
+}
+
+bool SharedStatusWriter::publish(const SharedDeviceSnapshot& snapshot) {
+    if (base_ == nullptr || snapshot.id == 0) {
+        return false;
+    }
+
+    size_t index = MAX_DEVICES;
+    for (size_t i = 0; i < MAX_DEVICES; i++) {
+        if (ids_[i] == snapshot.id) {
+            index = i;
+            break;
+        }
+        if (ids_[i] == 0 && index == MAX_DEVICES) {
+            index = i;  // First free record, unless the id turns up later
+        }
+    }
+    if (index == MAX_DEVICES) {
+        return false;
+    }
+
+    ids_[index] = snapshot.id;
+    store(index, snapshot);
+    return true;
+}
+
+void SharedStatusWriter::remove(uint32_t id) {
+    if (base_ == nullptr || id == 0) {
+        return;
+    }
+    for (size_t i = 0; i < MAX_DEVICES; i++) {
+        if (ids_[i] == id) {
+            SharedDeviceSnapshot empty;
+            std::memset(&empty, 0, sizeof(empty));
+            store(i, empty);
+            ids_[i] = 0;
+        }
+    }
+}
+
+void SharedStatusWriter::store(size_t index, const SharedDeviceSnapshot& snapshot) {
+    uint64_t words[WORDS];
+    std::memcpy(words, &snapshot, sizeof(words));
+
+    SegmentRecord& record = recordsOf(base_)[index];
+    uint64_t sequence = record.sequence.load(std::memory_order_relaxed);
+    record.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);  // Odd sequence before any word
+    for (size_t i = 0; i < WORDS; i++) {
+        record.words[i].store(words[i], std::memory_order_relaxed);
+    }
+    record.sequence.store(sequence + 2, std::memory_order_release);
+
+    std::atomic<uint64_t>& generation = headerOf(base_)->generation;
+    generation.store(generation.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+SharedStatusReader::SharedStatusReader()
+    : base_(nullptr),
+      retries_(0) {
+}
+
+SharedStatusReader::~SharedStatusReader() {
+    close();
+}
+
+bool SharedStatusReader::open(const std::string& path) {
+    close();
+    base_ = mapSegment(path);
+    return base_ != nullptr;
+}
+
+void SharedStatusReader::close() {
+    if (base_ != nullptr) {
+        munmap(const_cast<void*>(base_), SEGMENT_SIZE);
+        base_ = nullptr;
+    }
+}
+
+uint64_t SharedStatusReader::generation() const {
+    if (base_ == nullptr) {
+        return 0;
+    }
+    return headerOf(base_)->generation.load(std::memory_order_acquire);
+}
+
+bool SharedStatusReader::writerAlive() const {
+    return base_ != nullptr && processAlive(headerOf(base_)->writerPid.load(std::memory_order_acquire));
+}
+
+size_t SharedStatusReader::read(SharedDeviceSnapshot* devices, size_t capacity) const {
+    if (base_ == nullptr) {
+        return 0;
+    }
+
+    size_t count = 0;
+    const SegmentRecord* records = recordsOf(base_);
+    for (size_t i = 0; i < MAX_DEVICES && count < capacity; i++) {
+        const SegmentRecord& record = records[i];
+        uint64_t words[WORDS];
+        bool consistent = false;
+
+        for (int attempt = 0; attempt < MAX_READ_ATTEMPTS && !consistent; attempt++) {
+            uint64_t before = record.sequence.load(std::memory_order_acquire);
+            if (before == 0) {
+                break;  // Never written
+            }
+            if ((before & 1) == 0) {
+                for (size_t w = 0; w < WORDS; w++) {
+                    words[w] = record.words[w].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);  // Words before the re-check
+                consistent = record.sequence.load(std::memory_order_relaxed) == before;
+            }
+            if (!consistent) {
+                retries_.fetch_add(1, std::memory_order_relaxed);
+                if (attempt >= SPIN_ATTEMPTS) {
+                    sched_yield();
+                }
+            }
+        }
+
+        if (consistent) {
+            std::memcpy(&devices[count], words, sizeof(words));
+            if (devices[count].id != 0) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,107 @@
+#ifndef SHARED_STATUS_HPP
+#define SHARED_STATUS_HPP
+
+#include "DeviceStatus.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// One device as stored in the shared segment: fixed size, no pointers, so a
+// reader copies it out without allocating
+struct SharedDeviceSnapshot {
+    uint32_t id;              // 0 = unused record
+    uint16_t pid;
+    uint8_t batteryPercent;
+    bool connected;
+    bool batteryValid;
+    bool charging;
+    bool estimateValid;
+    bool estimateToFull;
+    uint64_t timeMs;          // Wall clock (Unix ms) of the reading
+    uint64_t estimateMs;
+    char name[40];            // NUL-terminated, truncated if longer
+};
+static_assert(sizeof(SharedDeviceSnapshot) % sizeof(uint64_t) == 0, "Snapshot is copied as whole words");
+
+// Battery snapshots published in a small mmap'd file for readers in other
+// processes that poll many times a second (widgets, status bar plugins).
+//
+// Layout: a 64-byte header (magic, layout version, writer pid, generation)
+// followed by MAX_DEVICES 128-byte records. Each record is a seqlock: the
+// writer makes its sequence odd, stores the snapshot words, then makes it even
+// again. A reader copies the words between two sequence loads and retries if
+// they differ or are odd, so it never blocks the writer and normally makes no
+// syscall.
+// The header generation changes with every publish, letting a reader skip the
+// copy entirely when nothing changed.
+//
+// One writer per file. All shared fields are lock-free atomics, so the layout
+// works across processes; both ends must be the same architecture.
+class SharedStatusWriter {
+public:
+    static constexpr size_t MAX_DEVICES = 8;
+
+    SharedStatusWriter();
+    ~SharedStatusWriter();
+
+    SharedStatusWriter(const SharedStatusWriter&) = delete;
+    SharedStatusWriter& operator=(const SharedStatusWriter&) = delete;
+
+    // Creates (or resets) the file; false if another live process writes it
+    bool open(const std::string& path);
+    // Empties and removes the file
+    void close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    // Single writer thread. False once MAX_DEVICES other devices are published.
+    bool publish(const DeviceStatus& status);
+    bool publish(const SharedDeviceSnapshot& snapshot);
+    void remove(uint32_t id);
+
+    static SharedDeviceSnapshot makeSnapshot(const DeviceStatus& status);
+
+private:
+    std::string path_;
+    void* base_;
+    uint32_t ids_[MAX_DEVICES];  // Writer's copy of each record's id
+
+    void store(size_t index, const SharedDeviceSnapshot& snapshot);
+};
+
+class SharedStatusReader {
+public:
+    SharedStatusReader();
+    ~SharedStatusReader();
+
+    SharedStatusReader(const SharedStatusReader&) = delete;
+    SharedStatusReader& operator=(const SharedStatusReader&) = delete;
+
+    // Maps the file read-only; false if missing or not a status segment
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return base_ != nullptr; }
+
+    // Changes whenever anything was published or removed
+    uint64_t generation() const;
+
+    // Copies every published device into devices; returns the count. Each
+    // snapshot is internally consistent. No locks, and no syscalls unless a
+    // record stays mid-write for a while (then the reader yields between tries).
+    size_t read(SharedDeviceSnapshot* devices, size_t capacity) const;
+
+    // Whether the writing process still exists (one kill(pid, 0) syscall)
+    bool writerAlive() const;
+
+    // Retries caused by a concurrent write since open (contention metric)
+    uint64_t retries() const { return retries_.load(std::memory_order_relaxed); }
+
+private:
+    const void* base_;
+    mutable std::atomic<uint64_t> retries_;
+};
+
+// Default segment path: $TMPDIR/razer-battery.status, else /tmp/razer-battery-<uid>.status
+std::string defaultSharedStatusPath();
+
+#endif // SHARED_STATUS_HPP
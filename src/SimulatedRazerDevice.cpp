@@ -0,0 +1,192 @@
+#include "SimulatedRazerDevice.hpp"
+#include "RazerProtocol.hpp"
+#include "RazerReport.hpp"
+#include <cstring>
+#include <unistd.h>
+
+SimulatedRazerDevice::SimulatedRazerDevice(uint32_t seed)
+    : open_(true),
+      batteryRaw_(0xC0),
+      charging_(false),
+      deviceMode_(0x00),
+      transactionId_(0x1F),
+      successStatus_(0x02),
+      unknownStatus_(0x00),
+      transferCostUs_(0),
+      checksumFaults_(0),
+      rng_(seed ? seed : 1),
+      eventsSupported_(true),
+      eventSink_(nullptr),
+      hasPending_(false),
+      busyReadsLeft_(0),
+      sendCount_(0),
+      readCount_(0),
+      hangs_(0),
+      aborted_(false) {
+    std::memset(pending_, 0, REPORT_SIZE);
+}
+
+bool SimulatedRazerDevice::startEvents(RazerEventSink* sink) {
+    if (!open_ || !eventsSupported_ || sink == nullptr) {
+        return false;
+    }
+    eventSink_ = sink;
+    return true;
+}
+
+bool SimulatedRazerDevice::injectEventReport(const uint8_t* report, size_t length) {
+    if (eventSink_ == nullptr) {
+        return false;
+    }
+    eventSink_->onEventReport(report, length);
+    return true;
+}
+
+void SimulatedRazerDevice::setCommand(uint8_t cmdClass, uint8_t cmdId, const SimulatedCommandConfig& config) {
+    commands_[(uint16_t)((cmdClass << 8) | cmdId)] = config;
+}
+
+const SimulatedCommandConfig& SimulatedRazerDevice::commandConfig(uint8_t cmdClass, uint8_t cmdId) const {
+    auto it = commands_.find((uint16_t)((cmdClass << 8) | cmdId));
+    return it != commands_.end() ? it->second : defaultCommand_;
+}
+
+bool SimulatedRazerDevice::isKnownCommand(uint8_t cmdClass, uint8_t cmdId) const {
+    switch ((cmdClass << 8) | cmdId) {
+        case 0x0780: case 0x0784: case 0x0783:  // Battery, charging, idle time
+        case 0x0004: case 0x0084: case 0x0081:  // Set/get mode, firmware
+        case 0x0485:                            // DPI
+            return true;
+    }
+    return commands_.count((uint16_t)((cmdClass << 8) | cmdId)) != 0;
+}
+
+uint32_t SimulatedRazerDevice::nextRandom() {
+    // xorshift32 - deterministic per seed
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    return rng_;
+}
+
+void SimulatedRazerDevice::chargeTransferCost() const {
+    if (transferCostUs_ > 0) {
+        usleep(transferCostUs_);
+    }
+}
+
+void SimulatedRazerDevice::setHangs(uint32_t count) {
+    std::lock_guard<std::mutex> lock(hangMutex_);
+    hangs_ = count;
+}
+
+void SimulatedRazerDevice::abortTransfer() {
+    std::lock_guard<std::mutex> lock(hangMutex_);
+    aborted_ = true;
+    hangWake_.notify_all();
+}
+
+bool SimulatedRazerDevice::hang() {
+    std::unique_lock<std::mutex> lock(hangMutex_);
+    if (hangs_ == 0) {
+        return false;
+    }
+    hangs_--;
+    aborted_ = false;
+    hangWake_.wait_for(lock, std::chrono::seconds(10), [this]() { return aborted_; });
+    return true;
+}
+
+bool SimulatedRazerDevice::sendReport(const uint8_t* report) {
+    if (!open_ || hang()) {
+        return false;
+    }
+    chargeTransferCost();
+    sendCount_++;
+
+    std::memcpy(pending_, report, REPORT_SIZE);
+    hasPending_ = true;
+
+    RazerResponseView request(report);
+    const SimulatedCommandConfig& config = commandConfig(request.commandClass(), request.commandId());
+    uint32_t latencyUs = config.latencyUs;
+    if (config.jitterUs > 0) {
+        latencyUs += nextRandom() % (config.jitterUs + 1);
+    }
+    readyAt_ = Clock::now() + std::chrono::microseconds(latencyUs);
+    busyReadsLeft_ = config.busyReads;
+    return true;
+}
+
+bool SimulatedRazerDevice::readResponse(uint8_t* buffer, size_t bufferSize) {
+    if (!open_ || bufferSize < REPORT_SIZE) {
+        return false;
+    }
+    chargeTransferCost();
+    readCount_++;
+
+    if (!hasPending_) {
+        std::memset(buffer, 0, REPORT_SIZE);
+        return true;
+    }
+
+    if (Clock::now() < readyAt_ || busyReadsLeft_ > 0) {
+        if (Clock::now() >= readyAt_) {
+            busyReadsLeft_--;
+        }
+        // Still processing: busy status with the command echoed
+        std::memcpy(buffer, pending_, REPORT_SIZE);
+        buffer[RazerReportLayout::STATUS] = 0x01;
+        RazerProtocol::calculateChecksum(buffer);
+        return true;
+    }
+
+    buildAnswer(buffer);
+    return true;
+}
+
+void SimulatedRazerDevice::buildAnswer(uint8_t* buffer) {
+    std::memcpy(buffer, pending_, REPORT_SIZE);
+    RazerResponseView request(pending_);
+    uint8_t cmdClass = request.commandClass();
+    uint8_t cmdId = request.commandId();
+    uint8_t* args = buffer + RazerReportLayout::ARGS;
+
+    if (!request.checksumValid()) {
+        buffer[RazerReportLayout::STATUS] = 0x03;  // Command failure
+    } else if (request.transactionId() != transactionId_) {
+        buffer[RazerReportLayout::STATUS] = 0x03;  // Wrong transaction ID is rejected
+    } else if (commandConfig(cmdClass, cmdId).notSupported) {
+        buffer[RazerReportLayout::STATUS] = 0x04;
+    } else if (unknownStatus_ != 0 && !isKnownCommand(cmdClass, cmdId)) {
+        buffer[RazerReportLayout::STATUS] = unknownStatus_;
+    } else {
+        buffer[RazerReportLayout::STATUS] = successStatus_;
+        if (cmdClass == 0x07 && cmdId == 0x80) {
+            args[1] = batteryRaw_;
+        } else if (cmdClass == 0x07 && cmdId == 0x84) {
+            args[3] = charging_ ? 0x01 : 0x00;
+        } else if (cmdClass == 0x00 && cmdId == 0x04) {
+            deviceMode_ = request.arg(0);
+        } else if (cmdClass == 0x00 && cmdId == 0x84) {
+            args[0] = deviceMode_;
+        } else if (cmdClass == 0x04 && cmdId == 0x85) {
+            args[1] = 0x03;   // 800 DPI (big endian X, then Y)
+            args[2] = 0x20;
+            args[3] = 0x03;
+            args[4] = 0x20;
+        } else if (cmdClass == 0x00 && cmdId == 0x81) {
+            args[0] = 0x01;   // Firmware 1.2
+            args[1] = 0x02;
+        } else if (cmdClass == 0x07 && cmdId == 0x83) {
+            args[0] = 0x01;   // Idle timer 300 s
+            args[1] = 0x2C;
+        }
+    }
+
+    RazerProtocol::calculateChecksum(buffer);
+    if (checksumFaults_ > 0) {
+        checksumFaults_--;
+        buffer[RazerReportLayout::CHECKSUM] ^= 0x5A;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef SIMULATED_RAZER_DEVICE_HPP
+#define SIMULATED_RAZER_DEVICE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include "RazerReport.hpp"
+#include "RazerTransport.hpp"
+
+// Behaviour of one (class, id) command on the simulated device
+struct SimulatedCommandConfig {
+    uint32_t latencyUs = 0;      // Time from SET_REPORT until the answer is ready
+    uint32_t jitterUs = 0;       // Extra 0..jitterUs latency (deterministic PRNG)
+    uint32_t busyReads = 0;      // Reads answered 0x01 (busy) after the latency expired
+    bool notSupported = false;   // Answer with status 0x04
+};
+
+// In-process Razer endpoint implementing RazerTransport.
+//
+// Answers the commands the monitor uses (battery 0x07/0x80, charging 0x07/0x84,
+// get/set mode 0x00/0x84 and 0x00/0x04, DPI 0x04/0x85, firmware 0x00/0x81 and
+// idle time 0x07/0x83) with configurable latency, busy cycles,
+// 0x04 "not supported" replies, response checksum faults and transfers that
+// hang like a wedged receiver until aborted; other commands
+// can be made known with setCommand or refused with setUnknownStatus. Event reports
+// can be injected as if they arrived on the interrupt pipe. Everything except
+// wall-clock latency is deterministic for a given seed, so runs are repeatable.
+class SimulatedRazerDevice : public RazerTransport {
+public:
+    explicit SimulatedRazerDevice(uint32_t seed = 1);
+
+    // RazerTransport
+    bool sendReport(const uint8_t* report) override;
+    bool readResponse(uint8_t* buffer, size_t bufferSize) override;
+    bool isOpen() const override { return open_; }
+    bool startEvents(RazerEventSink* sink) override;
+    void stopEvents() override { eventSink_ = nullptr; }
+    void abortTransfer() override;
+
+    // Device state
+    void setOpen(bool open) { open_ = open; }
+    void setBatteryRaw(uint8_t raw) { batteryRaw_ = raw; }
+    void setCharging(bool charging) { charging_ = charging; }
+    void setDeviceMode(uint8_t mode) { deviceMode_ = mode; }
+    uint8_t deviceMode() const { return deviceMode_; }
+    void setTransactionId(uint8_t transactionId) { transactionId_ = transactionId; }
+    void setSuccessStatus(uint8_t status) { successStatus_ = status; }
+    // Answer to commands neither built in nor given to setCommand (0 = answer
+    // them like a known command with empty data; real mice say 0x05)
+    void setUnknownStatus(uint8_t status) { unknownStatus_ = status; }
+
+    // Interrupt pipe: false = startEvents() fails, as on a transport without one
+    void setEventsSupported(bool supported) { eventsSupported_ = supported; }
+    // Delivers report to the event sink on the calling thread; false if not listening
+    bool injectEventReport(const uint8_t* report, size_t length);
+
+    // Timing and faults
+    void setDefaultCommand(const SimulatedCommandConfig& config) { defaultCommand_ = config; }
+    void setCommand(uint8_t cmdClass, uint8_t cmdId, const SimulatedCommandConfig& config);
+    void setTransferCostUs(uint32_t us) { transferCostUs_ = us; }
+    void setChecksumFaults(uint32_t count) { checksumFaults_ = count; }  // Next N answers
+    // The next N sends block until abortTransfer() (at most 10 s) and then
+    // fail, as a control request to a wedged receiver does
+    void setHangs(uint32_t count);
+
+    // Counters
+    uint64_t sendCount() const { return sendCount_; }
+    uint64_t readCount() const { return readCount_; }
+    void resetCounters() { sendCount_ = 0; readCount_ = 0; }
+
+private:
+    static constexpr size_t REPORT_SIZE = RazerReportLayout::SIZE;
+    typedef std::chrono::steady_clock Clock;
+
+    bool open_;
+    uint8_t batteryRaw_;
+    bool charging_;
+    uint8_t deviceMode_;
+    uint8_t transactionId_;
+    uint8_t successStatus_;
+    uint8_t unknownStatus_;
+    uint32_t transferCostUs_;
+    uint32_t checksumFaults_;
+    uint32_t rng_;
+    bool eventsSupported_;
+    RazerEventSink* eventSink_;
+
+    SimulatedCommandConfig defaultCommand_;
+    std::map<uint16_t, SimulatedCommandConfig> commands_;
+
+    // The request currently being processed
+    uint8_t pending_[REPORT_SIZE];
+    bool hasPending_;
+    Clock::time_point readyAt_;
+    uint32_t busyReadsLeft_;
+
+    uint64_t sendCount_;
+    uint64_t readCount_;
+
+    // Hanging sends; abortTransfer() comes from another thread
+    std::mutex hangMutex_;
+    std::condition_variable hangWake_;
+    uint32_t hangs_;
+    bool aborted_;
+
+    const SimulatedCommandConfig& commandConfig(uint8_t cmdClass, uint8_t cmdId) const;
+    bool isKnownCommand(uint8_t cmdClass, uint8_t cmdId) const;
+    uint32_t nextRandom();
+    void buildAnswer(uint8_t* buffer);
+    void chargeTransferCost() const;
+    bool hang();  // True if this send hung (and was released)
+};
+
+#endif // SIMULATED_RAZER_DEVICE_HPP
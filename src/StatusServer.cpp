@@ -0,0 +1,447 @@
+#include "StatusServer.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+#ifdef MSG_NOSIGNAL
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;  // macOS: SO_NOSIGPIPE is set per socket instead
+#endif
+
+bool setNonBlocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 &&
+           fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+bool makeAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+void appendEscaped(std::string& out, const std::string& text) {
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char)c >= 0x20) {
+            out += c;
+        }
+    }
+}
+
+} // namespace
+
+StatusServer::StatusServer()
+    : listenFd_(-1),
+      stopping_(false),
+      version_(0),
+      clientCount_(0) {
+    wakeFds_[0] = -1;
+    wakeFds_[1] = -1;
+    line_ = "{\"devices\":[]}\n";
+    statsLine_ = "{\"stats\":[]}\n";
+}
+
+StatusServer::~StatusServer() {
+    stop();
+}
+
+std::string StatusServer::defaultSocketPath() {
+    const char* tmp = getenv("TMPDIR");
+    if (tmp != nullptr && tmp[0] != '\0') {
+        std::string dir(tmp);
+        if (dir.back() != '/') {
+            dir += '/';
+        }
+        return dir + "razer-battery.sock";
+    }
+    return "/tmp/razer-battery-" + std::to_string(getuid()) + ".sock";
+}
+
+bool StatusServer::start(const std::string& path) {
+    if (isRunning()) {
+        return false;
+    }
+
+    sockaddr_un address;
+    if (!makeAddress(path, address)) {
+        std::cerr << "Status server: socket path too long: " << path << std::endl;
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    // A socket file left by a crashed process is reused; a live server is not
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) == 0) {
+        std::cerr << "Status server: " << path << " is already served" << std::endl;
+        close(fd);
+        return false;
+    }
+    unlink(path.c_str());
+
+    if (bind(fd, (const sockaddr*)&address, sizeof(address)) != 0 ||
+        chmod(path.c_str(), 0600) != 0 ||
+        listen(fd, 16) != 0 ||
+        !setNonBlocking(fd)) {
+        std::cerr << "Status server: cannot listen on " << path << ": " << strerror(errno) << std::endl;
+        close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+
+    if (pipe(wakeFds_) != 0 || !setNonBlocking(wakeFds_[0]) || !setNonBlocking(wakeFds_[1])) {
+        close(fd);
+        unlink(path.c_str());
+        return false;
+    }
+
+    path_ = path;
+    listenFd_ = fd;
+    stopping_ = false;
+    thread_ = std::thread(&StatusServer::run, this);
+    return true;
+}
+
+void StatusServer::stop() {
+    if (thread_.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake();
+        thread_.join();
+    }
+
+    for (Client& client : clients_) {
+        close(client.fd);
+    }
+    clients_.clear();
+    if (listenFd_ >= 0) {
+        close(listenFd_);
+        listenFd_ = -1;
+        unlink(path_.c_str());
+    }
+    for (int& fd : wakeFds_) {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    clientCount_ = 0;
+}
+
+void StatusServer::wake() {
+    if (wakeFds_[1] >= 0) {
+        char byte = 1;
+        ssize_t written = write(wakeFds_[1], &byte, 1);
+        (void)written;  // Pipe full means a wakeup is already pending
+    }
+}
+
+std::string StatusServer::quoted(const std::string& text) {
+    std::string json = "\"";
+    appendEscaped(json, text);
+    json += '"';
+    return json;
+}
+
+std::string StatusServer::toJson(const DeviceStatus& status) {
+    std::string json;
+    json.reserve(160);
+    json += "{\"id\":";
+    json += std::to_string(status.id);
+    json += ",\"pid\":";
+    json += std::to_string(status.pid);
+    json += ",\"name\":\"";
+    appendEscaped(json, status.name);
+    json += "\",\"connected\":";
+    json += status.connected ? "true" : "false";
+    json += ",\"battery\":";
+    json += status.batteryValid ? std::to_string(status.batteryPercent) : "null";
+    json += ",\"charging\":";
+    json += status.charging ? "true" : "false";
+    json += ",\"timeMs\":";
+    json += std::to_string(status.timeMs);
+    if (status.estimateValid) {
+        json += status.estimateToFull ? ",\"minutesToFull\":" : ",\"minutesToEmpty\":";
+        json += std::to_string(status.estimateMs / 60000);
+    }
+    json += "}";
+    return json;
+}
+
+void StatusServer::render() {
+    std::string line = "{\"devices\":[";
+    bool first = true;
+    for (const auto& entry : devices_) {
+        if (!first) {
+            line += ',';
+        }
+        line += toJson(entry.second);
+        first = false;
+    }
+    line += "]}\n";
+
+    if (line != line_) {
+        line_.swap(line);
+        version_++;
+    }
+}
+
+void StatusServer::publish(const DeviceStatus& status) {
+    uint64_t before;
+    uint64_t after;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        before = version_;
+        devices_[status.id] = status;
+        render();
+        after = version_;
+    }
+    if (after != before) {
+        wake();
+    }
+}
+
+void StatusServer::remove(uint32_t id) {
+    bool changed = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (devices_.erase(id) != 0) {
+            render();
+            changed = true;
+        }
+    }
+    if (changed) {
+        wake();
+    }
+}
+
+void StatusServer::publishStats(const std::string& json) {
+    std::string line = json + "\n";
+    std::lock_guard<std::mutex> lock(mutex_);
+    statsLine_.swap(line);
+}
+
+std::string StatusServer::statusLine() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return line_.substr(0, line_.size() - 1);
+}
+
+size_t StatusServer::clientCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return clientCount_;
+}
+
+void StatusServer::run() {
+    std::vector<pollfd> fds;
+
+    while (true) {
+        fds.clear();
+        fds.push_back(pollfd{listenFd_, POLLIN, 0});
+        fds.push_back(pollfd{wakeFds_[0], POLLIN, 0});
+        for (const Client& client : clients_) {
+            short events = POLLIN;
+            if (!client.out.empty()) {
+                events |= POLLOUT;
+            }
+            fds.push_back(pollfd{client.fd, events, 0});
+        }
+
+        if (poll(fds.data(), (nfds_t)fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "Status server: poll failed: " << strerror(errno) << std::endl;
+            return;
+        }
+
+        bool woken = (fds[1].revents & POLLIN) != 0;
+        if (woken) {
+            char drain[64];
+            while (read(wakeFds_[0], drain, sizeof(drain)) > 0) {
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                return;
+            }
+        }
+
+        // Clients first (indices match fds), then new connections
+        std::vector<Client> alive;
+        alive.reserve(clients_.size());
+        for (size_t i = 0; i < clients_.size(); i++) {
+            Client& client = clients_[i];
+            short revents = fds[i + 2].revents;
+            bool keep = true;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                keep = readClient(client);
+            }
+            if (keep && (revents & POLLOUT)) {
+                keep = flushClient(client);
+            }
+            if (keep) {
+                alive.push_back(std::move(client));
+            } else {
+                close(client.fd);
+            }
+        }
+        clients_.swap(alive);
+
+        if (woken) {
+            pushUpdates();
+        }
+        if (fds[0].revents & POLLIN) {
+            acceptClients();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        clientCount_ = clients_.size();
+    }
+}
+
+void StatusServer::acceptClients() {
+    while (true) {
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) {
+            return;  // EAGAIN: backlog drained
+        }
+        if (!setNonBlocking(fd)) {
+            close(fd);
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+        Client client;
+        client.fd = fd;
+        client.subscribed = false;
+        client.sentVersion = 0;
+        clients_.push_back(std::move(client));
+    }
+}
+
+bool StatusServer::readClient(Client& client) {
+    char buffer[512];
+    while (true) {
+        ssize_t received = recv(client.fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            client.in.append(buffer, (size_t)received);
+            handleRequests(client);
+            if (client.in.size() > MAX_REQUEST) {
+                return false;  // Not speaking this protocol: stop buffering it
+            }
+            continue;
+        }
+        if (received == 0) {
+            return false;  // Client closed
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        }
+        if (errno != EINTR) {
+            return false;
+        }
+    }
+    return flushClient(client);
+}
+
+void StatusServer::handleRequests(Client& client) {
+    size_t newline;
+    while ((newline = client.in.find('\n')) != std::string::npos) {
+        std::string request = client.in.substr(0, newline);
+        client.in.erase(0, newline + 1);
+        if (!request.empty() && request.back() == '\r') {
+            request.pop_back();
+        }
+        handleRequest(client, request);
+    }
+}
+
+void StatusServer::handleRequest(Client& client, const std::string& request) {
+    if (request == "status" || request == "subscribe") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        client.out += line_;
+        if (request == "subscribe") {
+            client.subscribed = true;
+            client.sentVersion = version_;
+        }
+    } else if (request == "stats") {
+        std::lock_guard<std::mutex> lock(mutex_);
+        client.out += statsLine_;
+    } else if (request == "ping") {
+        client.out += "{\"ok\":true}\n";
+    } else if (!request.empty()) {
+        client.out += "{\"error\":\"unknown request\"}\n";
+    }
+}
+
+bool StatusServer::flushClient(Client& client) {
+    size_t sent = 0;
+    while (sent < client.out.size()) {
+        ssize_t n = send(client.fd, client.out.data() + sent, client.out.size() - sent, SEND_FLAGS);
+        if (n > 0) {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        return false;
+    }
+    client.out.erase(0, sent);
+    return client.out.size() <= MAX_BACKLOG;
+}
+
+void StatusServer::pushUpdates() {
+    std::string line;
+    uint64_t version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        line = line_;
+        version = version_;
+    }
+
+    std::vector<Client> alive;
+    alive.reserve(clients_.size());
+    for (Client& client : clients_) {
+        bool keep = true;
+        if (client.subscribed && client.sentVersion != version) {
+            // Only the state current at wakeup is sent: a burst of publishes costs one line
+            client.out += line;
+            client.sentVersion = version;
+            keep = flushClient(client);
+        }
+        if (keep) {
+            alive.push_back(std::move(client));
+        } else {
+            close(client.fd);
+        }
+    }
+    clients_.swap(alive);
+}
@@ -0,0 +1,98 @@
+#ifndef STATUS_SERVER_HPP
+#define STATUS_SERVER_HPP
+
+#include "DeviceStatus.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local status API over a Unix-domain stream socket, so scripts and other tools
+// read the battery without opening the device themselves.
+//
+// Line protocol, one request per line, one JSON object per reply line:
+//   status     -> {"devices":[{"id":..,"name":..,"battery":..,...}, ...]}
+//   subscribe  -> the status line now, then again after every change
+//   stats      -> the last line given to publishStats() (transfer latency),
+//                 {"stats":[]} until the first one
+//   ping       -> {"ok":true}
+// Replies come from a line rendered once per publish(), so a query is a memcpy
+// into the client's buffer and never touches USB. One poll() thread serves every
+// client; a subscriber that stops reading is dropped once its backlog is full.
+class StatusServer {
+public:
+    StatusServer();
+    ~StatusServer();
+
+    StatusServer(const StatusServer&) = delete;
+    StatusServer& operator=(const StatusServer&) = delete;
+
+    // Binds and starts serving; false if the path is in use by a live server
+    bool start(const std::string& path);
+    void stop();
+    bool isRunning() const { return listenFd_ >= 0; }
+    const std::string& path() const { return path_; }
+
+    // Any thread. Subscribers are only woken when the rendered line changed.
+    void publish(const DeviceStatus& status);
+    void remove(uint32_t id);
+
+    // Any thread. Reply to "stats", one JSON object without newline; replaces
+    // the previous one and never wakes subscribers.
+    void publishStats(const std::string& json);
+
+    // Current reply to "status" (what a client would receive, without newline)
+    std::string statusLine() const;
+
+    size_t clientCount() const;
+
+    // $TMPDIR/razer-battery.sock (per-user on macOS), else /tmp/razer-battery-<uid>.sock
+    static std::string defaultSocketPath();
+
+    // text as a JSON string literal, quotes included
+    static std::string quoted(const std::string& text);
+
+private:
+    static constexpr size_t MAX_BACKLOG = 64 * 1024;  // Unsent bytes before a client is dropped
+    static constexpr size_t MAX_REQUEST = 256;        // Longest accepted request line
+
+    struct Client {
+        int fd;
+        std::string in;
+        std::string out;
+        bool subscribed;
+        uint64_t sentVersion;
+    };
+
+    std::string path_;
+    int listenFd_;
+    int wakeFds_[2];  // Self-pipe: publish()/stop() -> poll thread
+    bool stopping_;
+
+    mutable std::mutex mutex_;  // Guards devices_, line_, statsLine_, version_, clientCount_
+    std::map<uint32_t, DeviceStatus> devices_;
+    std::string line_;          // Rendered status reply, newline included
+    std::string statsLine_;     // Reply to "stats", newline included
+    uint64_t version_;
+    size_t clientCount_;
+
+    std::vector<Client> clients_;  // Poll thread only
+    std::thread thread_;
+
+    void run();
+    void wake();
+    void render();  // Caller holds mutex_
+    void acceptClients();
+    bool readClient(Client& client);
+    bool flushClient(Client& client);
+    void handleRequests(Client& client);  // Every complete line buffered so far
+    void handleRequest(Client& client, const std::string& request);
+    void pushUpdates();
+
+    static std::string toJson(const DeviceStatus& status);
+};
+
+#endif // STATUS_SERVER_HPP
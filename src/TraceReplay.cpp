@@ -0,0 +1,215 @@
+#include "TraceReplay.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+uint64_t steadyNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Re-issues one recorded request through the same protocol call that sent it.
+// True if it produced a battery reading.
+bool replayCommand(RazerProtocol& protocol, const uint8_t* request, RazerSnapshot& snapshot) {
+    RazerCommand command = {
+        request[RazerReportLayout::COMMAND_CLASS],
+        request[RazerReportLayout::COMMAND_ID],
+        request[RazerReportLayout::DATA_SIZE],
+        request[RazerReportLayout::ARGS]
+    };
+    if (command.cmdClass == 0x00 && command.cmdId == 0x04) {
+        protocol.setDeviceMode(command.arg0, request[RazerReportLayout::ARGS + 1]);
+        return false;
+    }
+    if (command.cmdClass == RazerProtocol::CMD_DEVICE_MODE.cmdClass &&
+        command.cmdId == RazerProtocol::CMD_DEVICE_MODE.cmdId) {
+        uint8_t mode = 0;
+        protocol.queryDeviceMode(mode);
+        return false;
+    }
+
+    RazerSnapshot fresh;
+    protocol.queryAll(&command, 1, fresh);
+    if (fresh.batteryValid) {
+        snapshot.batteryValid = true;
+        snapshot.batteryPercent = fresh.batteryPercent;
+    }
+    if (fresh.chargingValid) {
+        snapshot.chargingValid = true;
+        snapshot.isCharging = fresh.isCharging;
+    }
+    if (fresh.dpiValid) {
+        snapshot.dpiValid = true;
+        snapshot.dpiX = fresh.dpiX;
+        snapshot.dpiY = fresh.dpiY;
+    }
+    if (fresh.firmwareValid) {
+        snapshot.firmwareValid = true;
+        snapshot.firmwareMajor = fresh.firmwareMajor;
+        snapshot.firmwareMinor = fresh.firmwareMinor;
+    }
+    if (fresh.idleTimeValid) {
+        snapshot.idleTimeValid = true;
+        snapshot.idleTimeSeconds = fresh.idleTimeSeconds;
+    }
+    snapshot.transfers += fresh.transfers;
+    return fresh.batteryValid;
+}
+
+} // namespace
+
+ReplayTransport::ReplayTransport(const RazerTraceReader& trace)
+    : records_(trace.records()),
+      cursor_(0),
+      realtime_(false),
+      startNs_(0),
+      baseUs_(0),
+      sink_(nullptr),
+      transfers_(0),
+      mismatches_(0),
+      events_(0) {
+}
+
+void ReplayTransport::rewind() {
+    cursor_ = 0;
+    startNs_ = 0;
+}
+
+void ReplayTransport::pace(const RazerTraceRecord& record) {
+    if (!realtime_) {
+        return;
+    }
+    uint64_t now = steadyNs();
+    if (startNs_ == 0) {
+        startNs_ = now;
+        baseUs_ = record.timeUs;
+        return;
+    }
+    uint64_t due = startNs_ + (record.timeUs - baseUs_) * 1000;
+    if (due > now) {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(due - now));
+    }
+}
+
+void ReplayTransport::deliverEvents() {
+    while (cursor_ < records_.size() && records_[cursor_].kind == TRACE_EVENT) {
+        const RazerTraceRecord& record = records_[cursor_++];
+        pace(record);
+        events_++;
+        if (sink_ != nullptr) {
+            sink_->onEventReport(record.data, record.length);
+        }
+    }
+}
+
+const RazerTraceRecord* ReplayTransport::nextCommand() {
+    while (true) {
+        deliverEvents();
+        if (cursor_ >= records_.size()) {
+            return nullptr;
+        }
+        const RazerTraceRecord& record = records_[cursor_];
+        if (record.kind == TRACE_SEND || record.kind == TRACE_PROFILE) {
+            return &record;
+        }
+        // An answer nobody asked for: the replayed code read fewer times than the original
+        mismatches_++;
+        cursor_++;
+    }
+}
+
+bool ReplayTransport::sendReport(const uint8_t* report) {
+    const RazerTraceRecord* record = nextCommand();
+    while (record != nullptr && record->kind == TRACE_PROFILE) {
+        cursor_++;  // Only meaningful between calls; the driver applies them there
+        record = nextCommand();
+    }
+    if (record == nullptr) {
+        return false;
+    }
+
+    pace(*record);
+    if (record->length != RazerProtocol::REPORT_SIZE ||
+        std::memcmp(record->data, report, RazerProtocol::REPORT_SIZE) != 0) {
+        mismatches_++;
+    }
+    cursor_++;
+    transfers_++;
+    return record->ok;
+}
+
+bool ReplayTransport::readResponse(uint8_t* buffer, size_t bufferSize) {
+    deliverEvents();
+    if (cursor_ >= records_.size() || records_[cursor_].kind != TRACE_READ) {
+        return false;  // The original stopped reading here
+    }
+
+    const RazerTraceRecord& record = records_[cursor_++];
+    pace(record);
+    std::memset(buffer, 0, bufferSize);
+    std::memcpy(buffer, record.data, std::min((size_t)record.length, bufferSize));
+    return record.ok;
+}
+
+TraceReplay::TraceReplay(const RazerTraceReader& trace)
+    : trace_(trace) {
+}
+
+void TraceReplay::run(bool realtime, uint32_t loops, TraceReplayResult& result) {
+    result = TraceReplayResult();
+
+    ReplayTransport transport(trace_);
+    transport.setRealtime(realtime);
+    RazerProtocol protocol(&transport);
+    if (!realtime) {
+        // Recorded answers are already there: never sleep between reads
+        ResponseWaitPolicy immediate;
+        immediate.minInitialDelayUs = 0;
+        immediate.maxInitialDelayUs = 0;
+        immediate.firstBackoffUs = 0;
+        immediate.maxBackoffUs = 0;
+        protocol.setResponseWaitPolicy(immediate);
+    }
+
+    RazerSnapshot& snapshot = result.snapshot;
+    protocol.setEventHandler([&snapshot](const RazerEvent& event) {
+        RazerProtocol::applyEvent(event, snapshot);
+    });
+    protocol.startEvents();
+
+    uint64_t startNs = steadyNs();
+    for (uint32_t loop = 0; loop < loops; loop++) {
+        transport.rewind();
+        const RazerTraceRecord* record;
+        while ((record = transport.nextCommand()) != nullptr) {
+            if (record->kind == TRACE_PROFILE) {
+                uint16_t pid = 0;
+                RazerProtocolProfile profile;
+                if (RazerTraceReader::readProfile(*record, pid, profile)) {
+                    protocol.setProfile(profile);
+                }
+                transport.skip();
+                continue;
+            }
+
+            uint64_t before = transport.transfers();
+            if (replayCommand(protocol, record->data, snapshot)) {
+                result.readings++;
+            }
+            result.calls++;
+            if (transport.transfers() == before) {
+                transport.skip();  // The call never reached the wire
+            }
+        }
+        result.recordedUs += trace_.durationUs();
+    }
+    result.elapsedUs = (steadyNs() - startNs) / 1000;
+    protocol.stopEvents();
+
+    result.transfers = transport.transfers();
+    result.mismatches = transport.mismatches();
+    result.events = transport.events();
+}
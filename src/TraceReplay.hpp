@@ -0,0 +1,86 @@
+#ifndef TRACE_REPLAY_HPP
+#define TRACE_REPLAY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include "RazerProtocol.hpp"
+#include "RazerTrace.hpp"
+#include "RazerTransport.hpp"
+
+// RazerTransport that answers from a recorded trace instead of a device.
+//
+// Every sendReport consumes the next recorded request (and counts a mismatch if
+// the bytes differ), every readResponse returns the next recorded answer, and
+// recorded event reports are delivered to the sink as the replay passes them.
+// A read where the recording moved on to the next request (the original command
+// timed out) fails, which the protocol handles like the original timeout.
+class ReplayTransport : public RazerTransport {
+public:
+    explicit ReplayTransport(const RazerTraceReader& trace);
+
+    // Realtime: each record is returned no earlier than its recorded offset
+    // from the start of the replay. Otherwise records are returned at once.
+    void setRealtime(bool realtime) { realtime_ = realtime; }
+    void rewind();
+
+    // RazerTransport
+    bool sendReport(const uint8_t* report) override;
+    bool readResponse(uint8_t* buffer, size_t bufferSize) override;
+    bool isOpen() const override { return cursor_ < records_.size(); }
+    bool startEvents(RazerEventSink* sink) override { sink_ = sink; return true; }
+    void stopEvents() override { sink_ = nullptr; }
+
+    // Next request or profile record not consumed yet (events delivered and
+    // stray answers skipped on the way); nullptr at the end of the trace
+    const RazerTraceRecord* nextCommand();
+    void skip() { cursor_++; }
+
+    uint64_t transfers() const { return transfers_; }
+    uint64_t mismatches() const { return mismatches_; }
+    uint64_t events() const { return events_; }
+
+private:
+    const std::vector<RazerTraceRecord>& records_;
+    size_t cursor_;
+    bool realtime_;
+    uint64_t startNs_;      // Replay start (realtime pacing), 0 = not started
+    uint64_t baseUs_;       // Recorded time of the first paced record
+    RazerEventSink* sink_;
+    uint64_t transfers_;
+    uint64_t mismatches_;
+    uint64_t events_;
+
+    void deliverEvents();
+    void pace(const RazerTraceRecord& record);
+};
+
+struct TraceReplayResult {
+    uint64_t calls = 0;        // Protocol calls issued for recorded commands
+    uint64_t transfers = 0;    // Recorded requests consumed
+    uint64_t mismatches = 0;   // Requests that differ from the recording
+    uint64_t events = 0;       // Event reports delivered
+    uint64_t readings = 0;     // Calls that produced a battery level
+    uint64_t recordedUs = 0;   // Span of the trace, times the loop count
+    uint64_t elapsedUs = 0;    // Replay wall time
+    RazerSnapshot snapshot;    // Last state the replayed queries and events produced
+};
+
+// Drives RazerProtocol (the query logic RazerDevice runs on its worker) from a
+// trace. The recorded request stream picks each call: mode switches and mode
+// queries go to setDeviceMode / queryDeviceMode, everything else to queryAll,
+// so transaction ID re-probing, busy polling, checksum checks and status
+// acceptance all run unchanged against the recorded answers. Profile records
+// re-seed the protocol the way a connect does.
+class TraceReplay {
+public:
+    explicit TraceReplay(const RazerTraceReader& trace);
+
+    // Replays the whole trace loops times. Unless realtime, response waits are
+    // zero and the replay is CPU bound (far faster than the recording).
+    void run(bool realtime, uint32_t loops, TraceReplayResult& result);
+
+private:
+    const RazerTraceReader& trace_;
+};
+
+#endif // TRACE_REPLAY_HPP
@@ -0,0 +1,299 @@
+#include "TransferStats.hpp"
+#include <chrono>
+#include <cstdio>
+
+namespace {
+
+constexpr uint32_t COMMAND_KEY_USED = 0x10000;
+
+void appendSummaryText(std::string& out, const char* label, const LatencyHistogram& histogram) {
+    char line[160];
+    uint64_t count = histogram.count();
+    snprintf(line, sizeof(line), "%-18s n=%llu mean=%lluus p50=%uus p90=%uus p99=%uus max=%uus",
+             label, (unsigned long long)count,
+             (unsigned long long)(count != 0 ? histogram.sumUs() / count : 0),
+             histogram.percentileUs(0.50), histogram.percentileUs(0.90),
+             histogram.percentileUs(0.99), histogram.maxUs());
+    out += line;
+}
+
+void appendSummaryJson(std::string& out, const LatencyHistogram& histogram) {
+    char fields[160];
+    uint64_t count = histogram.count();
+    snprintf(fields, sizeof(fields),
+             "{\"count\":%llu,\"meanUs\":%llu,\"p50Us\":%u,\"p90Us\":%u,\"p99Us\":%u,\"maxUs\":%u,\"buckets\":[",
+             (unsigned long long)count,
+             (unsigned long long)(count != 0 ? histogram.sumUs() / count : 0),
+             histogram.percentileUs(0.50), histogram.percentileUs(0.90),
+             histogram.percentileUs(0.99), histogram.maxUs());
+    out += fields;
+
+    bool first = true;
+    for (size_t i = 0; i < LatencyHistogram::BUCKETS; i++) {
+        uint32_t n = histogram.bucketCount(i);
+        if (n == 0) {
+            continue;
+        }
+        snprintf(fields, sizeof(fields), "%s[%u,%u]", first ? "" : ",", LatencyHistogram::bucketUpperUs(i), n);
+        out += fields;
+        first = false;
+    }
+    out += "]}";
+}
+
+void appendCount(std::string& out, const char* name, uint64_t value) {
+    out += name;
+    out += std::to_string(value);
+}
+
+void addRelaxed(std::atomic<uint64_t>& counter) {
+    counter.fetch_add(1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : count_(0),
+      sumUs_(0),
+      maxUs_(0) {
+    for (std::atomic<uint32_t>& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::bucketFor(uint32_t us) {
+    if (us < EXACT_BUCKETS) {
+        return us;
+    }
+    unsigned exponent = 31 - (unsigned)__builtin_clz(us);  // >= SUB_BUCKET_BITS + 1
+    unsigned sub = (us >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return EXACT_BUCKETS + (exponent - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + sub;
+}
+
+uint32_t LatencyHistogram::bucketUpperUs(size_t index) {
+    if (index < EXACT_BUCKETS) {
+        return (uint32_t)index;
+    }
+    size_t offset = index - EXACT_BUCKETS;
+    unsigned shift = (unsigned)(offset / SUB_BUCKETS) + 1;  // exponent - SUB_BUCKET_BITS
+    uint64_t lower = (uint64_t)(SUB_BUCKETS + offset % SUB_BUCKETS) << shift;
+    return (uint32_t)(lower + (1ull << shift) - 1);
+}
+
+void LatencyHistogram::record(uint32_t us) {
+    buckets_[bucketFor(us)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sumUs_.fetch_add(us, std::memory_order_relaxed);
+    uint32_t max = maxUs_.load(std::memory_order_relaxed);
+    while (us > max && !maxUs_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+uint32_t LatencyHistogram::percentileUs(double quantile) const {
+    // Totals from the buckets themselves: count_ may be a step ahead of them
+    uint64_t total = 0;
+    for (const std::atomic<uint32_t>& bucket : buckets_) {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)(quantile * (double)total + 0.999999);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint32_t upper = bucketUpperUs(i);
+            uint32_t max = maxUs();
+            return (max != 0 && max < upper) ? max : upper;
+        }
+    }
+    return maxUs();
+}
+
+const char* transferPhaseName(TransferPhase phase) {
+    switch (phase) {
+        case TransferPhase::Send: return "send";
+        case TransferPhase::Wait: return "wait";
+        case TransferPhase::Read: return "read";
+        case TransferPhase::Retry: return "retry";
+        case TransferPhase::Count: break;
+    }
+    return "unknown";
+}
+
+TransferStats::TransferStats()
+    : modeSwitchFailures_(0),
+      connectFailures_(0),
+      timeouts_(0),
+      watchdogAborts_(0),
+      untracked_(0) {
+    for (Command& command : commands_) {
+        command.key.store(0, std::memory_order_relaxed);
+        command.status00.store(0, std::memory_order_relaxed);
+        command.status02.store(0, std::memory_order_relaxed);
+        command.status04.store(0, std::memory_order_relaxed);
+        command.statusOther.store(0, std::memory_order_relaxed);
+        command.failures.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t TransferStats::nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t TransferStats::elapsedUs(uint64_t startNs, uint64_t endNs) {
+    uint64_t us = endNs > startNs ? (endNs - startNs) / 1000 : 0;
+    return us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+TransferStats::Command* TransferStats::commandFor(uint8_t cmdClass, uint8_t cmdId) {
+    uint32_t key = COMMAND_KEY_USED | (uint32_t)cmdClass << 8 | cmdId;
+    for (Command& command : commands_) {
+        uint32_t current = command.key.load(std::memory_order_acquire);
+        if (current == key) {
+            return &command;
+        }
+        if (current == 0) {
+            // Claim the entry; a reader that sees the key sees zeroed counters
+            command.key.store(key, std::memory_order_release);
+            return &command;
+        }
+    }
+    return nullptr;
+}
+
+void TransferStats::recordCommand(uint8_t cmdClass, uint8_t cmdId, uint32_t us, bool answered, uint8_t status) {
+    Command* command = commandFor(cmdClass, cmdId);
+    if (command == nullptr) {
+        addRelaxed(untracked_);
+        return;
+    }
+    command->latency.record(us);
+    if (!answered) {
+        addRelaxed(command->failures);
+    } else if (status == 0x00) {
+        addRelaxed(command->status00);
+    } else if (status == 0x02) {
+        addRelaxed(command->status02);
+    } else if (status == 0x04) {
+        addRelaxed(command->status04);
+    } else {
+        addRelaxed(command->statusOther);
+    }
+}
+
+void TransferStats::recordModeSwitch(uint32_t us, bool ok) {
+    modeSwitch_.record(us);
+    if (!ok) {
+        addRelaxed(modeSwitchFailures_);
+    }
+}
+
+void TransferStats::recordConnect(uint32_t us, bool ok) {
+    connect_.record(us);
+    if (!ok) {
+        addRelaxed(connectFailures_);
+    }
+}
+
+void TransferStats::recordTimeout(bool aborted) {
+    addRelaxed(timeouts_);
+    if (aborted) {
+        addRelaxed(watchdogAborts_);
+    }
+}
+
+size_t TransferStats::commandCount() const {
+    size_t count = 0;
+    while (count < MAX_COMMANDS && commands_[count].key.load(std::memory_order_acquire) != 0) {
+        count++;
+    }
+    return count;
+}
+
+std::string TransferStats::toText() const {
+    std::string out;
+    for (size_t i = 0; i < (size_t)TransferPhase::Count; i++) {
+        appendSummaryText(out, transferPhaseName((TransferPhase)i), phases_[i]);
+        out += '\n';
+    }
+
+    size_t commands = commandCount();
+    for (size_t i = 0; i < commands; i++) {
+        const Command& command = commands_[i];
+        char label[32];
+        snprintf(label, sizeof(label), "command 0x%02x/0x%02x", command.cmdClass(), command.cmdId());
+        appendSummaryText(out, label, command.latency);
+        appendCount(out, " 0x00=", command.status00.load(std::memory_order_relaxed));
+        appendCount(out, " 0x02=", command.status02.load(std::memory_order_relaxed));
+        appendCount(out, " 0x04=", command.status04.load(std::memory_order_relaxed));
+        appendCount(out, " other=", command.statusOther.load(std::memory_order_relaxed));
+        appendCount(out, " failed=", command.failures.load(std::memory_order_relaxed));
+        out += '\n';
+    }
+    if (untrackedCommands() != 0) {
+        appendCount(out, "untracked commands: ", untrackedCommands());
+        out += '\n';
+    }
+
+    appendSummaryText(out, "mode switch", modeSwitch_);
+    appendCount(out, " failed=", modeSwitchFailures());
+    out += '\n';
+    appendSummaryText(out, "connect", connect_);
+    appendCount(out, " failed=", connectFailures());
+    out += '\n';
+    appendCount(out, "timeouts: ", timeouts());
+    appendCount(out, " watchdog aborts=", watchdogAborts());
+    out += '\n';
+    return out;
+}
+
+std::string TransferStats::toJson() const {
+    std::string out = "{\"phases\":{";
+    for (size_t i = 0; i < (size_t)TransferPhase::Count; i++) {
+        if (i != 0) {
+            out += ',';
+        }
+        out += '"';
+        out += transferPhaseName((TransferPhase)i);
+        out += "\":";
+        appendSummaryJson(out, phases_[i]);
+    }
+
+    out += "},\"commands\":[";
+    size_t commands = commandCount();
+    for (size_t i = 0; i < commands; i++) {
+        const Command& command = commands_[i];
+        if (i != 0) {
+            out += ',';
+        }
+        appendCount(out, "{\"class\":", command.cmdClass());
+        appendCount(out, ",\"id\":", command.cmdId());
+        out += ",\"latency\":";
+        appendSummaryJson(out, command.latency);
+        appendCount(out, ",\"status\":{\"0x00\":", command.status00.load(std::memory_order_relaxed));
+        appendCount(out, ",\"0x02\":", command.status02.load(std::memory_order_relaxed));
+        appendCount(out, ",\"0x04\":", command.status04.load(std::memory_order_relaxed));
+        appendCount(out, ",\"other\":", command.statusOther.load(std::memory_order_relaxed));
+        appendCount(out, "},\"failures\":", command.failures.load(std::memory_order_relaxed));
+        out += '}';
+    }
+    appendCount(out, "],\"untrackedCommands\":", untrackedCommands());
+
+    out += ",\"modeSwitch\":";
+    appendSummaryJson(out, modeSwitch_);
+    appendCount(out, ",\"modeSwitchFailures\":", modeSwitchFailures());
+    out += ",\"connect\":";
+    appendSummaryJson(out, connect_);
+    appendCount(out, ",\"connectFailures\":", connectFailures());
+    appendCount(out, ",\"timeouts\":", timeouts());
+    appendCount(out, ",\"watchdogAborts\":", watchdogAborts());
+    out += '}';
+    return out;
+}
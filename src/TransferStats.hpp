@@ -0,0 +1,127 @@
+#ifndef TRANSFER_STATS_HPP
+#define TRANSFER_STATS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Fixed-bucket latency histogram in microseconds, HDR style: exact below 16us,
+// then 8 linear buckets per power of two (at most 12.5% relative error) up to
+// the full uint32_t range. No allocation, and recording is a few relaxed atomic
+// adds, so any thread may read it while the recording thread keeps going.
+class LatencyHistogram {
+public:
+    static constexpr unsigned SUB_BUCKET_BITS = 3;
+    static constexpr unsigned SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr unsigned EXACT_BUCKETS = 2 * SUB_BUCKETS;  // 0-15us, one per value
+    static constexpr size_t BUCKETS = EXACT_BUCKETS + (32 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+    LatencyHistogram();
+
+    void record(uint32_t us);
+
+    uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+    uint64_t sumUs() const { return sumUs_.load(std::memory_order_relaxed); }
+    uint32_t maxUs() const { return maxUs_.load(std::memory_order_relaxed); }
+    uint32_t bucketCount(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+    // Upper bound of the bucket holding the given quantile (0.0 - 1.0), 0 if empty
+    uint32_t percentileUs(double quantile) const;
+
+    static size_t bucketFor(uint32_t us);
+    static uint32_t bucketUpperUs(size_t index);
+
+private:
+    std::atomic<uint32_t> buckets_[BUCKETS];
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sumUs_;
+    std::atomic<uint32_t> maxUs_;
+};
+
+// Where the time of one report transfer goes
+enum class TransferPhase {
+    Send,   // SET_REPORT call
+    Wait,   // SET_REPORT done until the answer is in the buffer (sleeps included)
+    Read,   // One GET_REPORT call (several per wait while the device is busy)
+    Retry,  // Transaction ID re-probing after the cached profile failed
+    Count
+};
+
+const char* transferPhaseName(TransferPhase phase);
+
+// Per-device transfer instrumentation for the USB control path: latency per
+// phase, per command class/id (with the answered status codes) and for the
+// device-level operations (mode switch, whole connect). Timestamps come from
+// steady_clock. One thread records (the device's worker); export from any
+// thread sees a slightly stale but never torn view of each counter.
+class TransferStats {
+public:
+    static constexpr size_t MAX_COMMANDS = 16;  // Distinct class/id pairs tracked per device
+
+    struct Command {
+        std::atomic<uint32_t> key;     // 0x10000 | class << 8 | id, 0 = unused
+        LatencyHistogram latency;      // One transfer: SET_REPORT until the answer is read and checked
+        std::atomic<uint64_t> status00;
+        std::atomic<uint64_t> status02;
+        std::atomic<uint64_t> status04;
+        std::atomic<uint64_t> statusOther;
+        std::atomic<uint64_t> failures; // Send/read error, timeout or bad checksum
+
+        uint8_t cmdClass() const { return (uint8_t)(key.load(std::memory_order_relaxed) >> 8); }
+        uint8_t cmdId() const { return (uint8_t)key.load(std::memory_order_relaxed); }
+    };
+
+    TransferStats();
+
+    TransferStats(const TransferStats&) = delete;
+    TransferStats& operator=(const TransferStats&) = delete;
+
+    void recordPhase(TransferPhase phase, uint32_t us) { phases_[(size_t)phase].record(us); }
+    // answered = false records a failure, otherwise the response status byte
+    void recordCommand(uint8_t cmdClass, uint8_t cmdId, uint32_t us, bool answered, uint8_t status);
+    void recordModeSwitch(uint32_t us, bool ok);
+    void recordConnect(uint32_t us, bool ok);
+    // A send or read that ran into its deadline; aborted = freed by the watchdog
+    // rather than by the transport's own timeout
+    void recordTimeout(bool aborted);
+
+    const LatencyHistogram& phase(TransferPhase phase) const { return phases_[(size_t)phase]; }
+    const LatencyHistogram& modeSwitch() const { return modeSwitch_; }
+    const LatencyHistogram& connect() const { return connect_; }
+    uint64_t modeSwitchFailures() const { return modeSwitchFailures_.load(std::memory_order_relaxed); }
+    uint64_t connectFailures() const { return connectFailures_.load(std::memory_order_relaxed); }
+    uint64_t timeouts() const { return timeouts_.load(std::memory_order_relaxed); }
+    uint64_t watchdogAborts() const { return watchdogAborts_.load(std::memory_order_relaxed); }
+    // Commands beyond MAX_COMMANDS: counted here, not broken down
+    uint64_t untrackedCommands() const { return untracked_.load(std::memory_order_relaxed); }
+
+    // Tracked commands in first-seen order; stops at the first unused entry
+    const Command& command(size_t index) const { return commands_[index]; }
+    size_t commandCount() const;
+
+    // Human-readable summary (count, mean and percentiles per histogram)
+    std::string toText() const;
+    // One JSON object: the same summary plus the non-empty buckets as
+    // [upperUs, count] pairs, so histograms from several runs can be merged
+    std::string toJson() const;
+
+    // Microseconds between two steady_clock readings, saturated to uint32_t
+    static uint32_t elapsedUs(uint64_t startNs, uint64_t endNs);
+    static uint64_t nowNs();
+
+private:
+    LatencyHistogram phases_[(size_t)TransferPhase::Count];
+    LatencyHistogram modeSwitch_;
+    LatencyHistogram connect_;
+    std::atomic<uint64_t> modeSwitchFailures_;
+    std::atomic<uint64_t> connectFailures_;
+    std::atomic<uint64_t> timeouts_;
+    std::atomic<uint64_t> watchdogAborts_;
+    std::atomic<uint64_t> untracked_;
+    Command commands_[MAX_COMMANDS];
+
+    Command* commandFor(uint8_t cmdClass, uint8_t cmdId);
+};
+
+#endif // TRANSFER_STATS_HPP
@@ -0,0 +1,129 @@
+#include "TransferWatchdog.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+TransferWatchdog::TransferWatchdog()
+    : stopping_(false),
+      aborts_(0) {
+    active_.reserve(16);
+}
+
+TransferWatchdog::~TransferWatchdog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+TransferWatchdog& TransferWatchdog::shared() {
+    static TransferWatchdog watchdog;
+    return watchdog;
+}
+
+void TransferWatchdog::begin(Watch& watch, RazerTransport* transport, uint32_t deadlineUs) {
+    watch.transport = transport;
+    watch.deadlineNs = TransferStats::nowNs() + (uint64_t)deadlineUs * 1000;
+    watch.fired = false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!thread_.joinable()) {
+        thread_ = std::thread(&TransferWatchdog::run, this);
+    }
+    active_.push_back(&watch);
+    wake_.notify_one();  // May be earlier than what the thread sleeps towards
+}
+
+void TransferWatchdog::end(Watch& watch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(active_.begin(), active_.end(), &watch);
+    if (it != active_.end()) {
+        active_.erase(it);
+    }
+}
+
+void TransferWatchdog::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        uint64_t now = TransferStats::nowNs();
+        uint64_t next = UINT64_MAX;
+        for (Watch* watch : active_) {
+            if (watch->fired) {
+                continue;  // Aborted; waiting for its end()
+            }
+            if (watch->deadlineNs <= now) {
+                watch->fired = true;
+                aborts_.fetch_add(1, std::memory_order_relaxed);
+                watch->transport->abortTransfer();
+            } else {
+                next = std::min(next, watch->deadlineNs);
+            }
+        }
+
+        if (next == UINT64_MAX) {
+            wake_.wait(lock);
+        } else {
+            wake_.wait_for(lock, std::chrono::nanoseconds(next - now));
+        }
+    }
+}
+
+WatchdogTransport::WatchdogTransport(RazerTransport* inner, TransferWatchdog* watchdog)
+    : inner_(inner),
+      watchdog_(watchdog),
+      stats_(nullptr),
+      timeoutMs_(DEFAULT_TIMEOUT_MS),
+      degraded_(false) {
+    inner_->setTransferTimeoutMs(timeoutMs_);
+}
+
+void WatchdogTransport::setTransferTimeoutMs(uint32_t timeoutMs) {
+    timeoutMs_ = timeoutMs;
+    inner_->setTransferTimeoutMs(timeoutMs);
+}
+
+bool WatchdogTransport::finish(const TransferWatchdog::Watch& watch, uint64_t startNs, bool ok) {
+    if (ok && !watch.fired) {
+        return true;
+    }
+    uint32_t elapsedUs = TransferStats::elapsedUs(startNs, TransferStats::nowNs());
+    if (!watch.fired && elapsedUs < timeoutMs_ * 1000) {
+        return false;  // An ordinary failure, not a stuck request
+    }
+    if (stats_ != nullptr) {
+        stats_->recordTimeout(watch.fired);
+    }
+    if (!degraded_.exchange(true, std::memory_order_acq_rel)) {
+        std::cerr << "Transfer " << (watch.fired ? "aborted by the watchdog" : "timed out") << " after "
+                  << elapsedUs / 1000 << " ms - link degraded" << std::endl;
+    }
+    return false;
+}
+
+bool WatchdogTransport::sendReport(const uint8_t* report) {
+    if (isDegraded()) {
+        return false;  // Wedged: fail fast until reconnected
+    }
+    TransferWatchdog::Watch watch;
+    uint64_t startNs = TransferStats::nowNs();
+    watchdog_->begin(watch, inner_, timeoutMs_ * 1500);
+    bool ok = inner_->sendReport(report);
+    watchdog_->end(watch);
+    return finish(watch, startNs, ok);
+}
+
+bool WatchdogTransport::readResponse(uint8_t* buffer, size_t bufferSize) {
+    if (isDegraded()) {
+        return false;
+    }
+    TransferWatchdog::Watch watch;
+    uint64_t startNs = TransferStats::nowNs();
+    watchdog_->begin(watch, inner_, timeoutMs_ * 1500);
+    bool ok = inner_->readResponse(buffer, bufferSize);
+    watchdog_->end(watch);
+    return finish(watch, startNs, ok);
+}
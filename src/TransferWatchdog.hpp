@@ -0,0 +1,96 @@
+#ifndef TRANSFER_WATCHDOG_HPP
+#define TRANSFER_WATCHDOG_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "RazerTransport.hpp"
+#include "TransferStats.hpp"
+
+// Aborts report transfers that outlive their deadline.
+//
+// Transports enforce a per-transfer timeout themselves where they can
+// (ControlRequestTO on IOKit); the watchdog is the backstop for a request the
+// kernel does not give back. One thread serves every device: it sleeps until
+// the earliest deadline among the transfers in flight and calls abortTransfer()
+// on the transport of each one past it. The abort runs under the watchdog's lock
+// and end() takes the same lock, so once end() returns that transfer is never
+// aborted any more and its transport may be closed.
+class TransferWatchdog {
+public:
+    // One transfer in flight, on the caller's stack between begin() and end()
+    struct Watch {
+        RazerTransport* transport;
+        uint64_t deadlineNs;
+        bool fired;  // Aborted by the watchdog; stable after end()
+    };
+
+    TransferWatchdog();
+    ~TransferWatchdog();
+
+    TransferWatchdog(const TransferWatchdog&) = delete;
+    TransferWatchdog& operator=(const TransferWatchdog&) = delete;
+
+    void begin(Watch& watch, RazerTransport* transport, uint32_t deadlineUs);
+    void end(Watch& watch);
+
+    uint64_t aborts() const { return aborts_.load(std::memory_order_relaxed); }
+
+    // The instance every RazerDevice shares
+    static TransferWatchdog& shared();
+
+private:
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Watch*> active_;
+    std::thread thread_;  // Started by the first begin()
+    bool stopping_;
+    std::atomic<uint64_t> aborts_;
+
+    void run();
+};
+
+// Runs every transfer of the wrapped transport under a deadline: the inner
+// transport's own timeout, backed by the watchdog at 1.5 times that. A transfer
+// that times out or is aborted marks the link degraded. From then on every
+// transfer fails at once until clearDegraded() (the next connect), so a wedged
+// receiver costs one deadline per refresh instead of one per command and read,
+// and the caller hands the device to its reconnect logic.
+class WatchdogTransport : public RazerTransport {
+public:
+    static constexpr uint32_t DEFAULT_TIMEOUT_MS = 500;
+
+    WatchdogTransport(RazerTransport* inner, TransferWatchdog* watchdog);
+
+    // Timeouts and aborts are counted here (per device); optional
+    void setStats(TransferStats* stats) { stats_ = stats; }
+
+    uint32_t transferTimeoutMs() const { return timeoutMs_; }
+    bool isDegraded() const { return degraded_.load(std::memory_order_acquire); }
+    void clearDegraded() { degraded_.store(false, std::memory_order_release); }
+
+    // RazerTransport
+    bool sendReport(const uint8_t* report) override;
+    bool readResponse(uint8_t* buffer, size_t bufferSize) override;
+    bool isOpen() const override { return inner_->isOpen(); }
+    bool startEvents(RazerEventSink* sink) override { return inner_->startEvents(sink); }
+    void stopEvents() override { inner_->stopEvents(); }
+    void setTransferTimeoutMs(uint32_t timeoutMs) override;
+    void abortTransfer() override { inner_->abortTransfer(); }
+
+private:
+    RazerTransport* inner_;
+    TransferWatchdog* watchdog_;
+    TransferStats* stats_;
+    uint32_t timeoutMs_;
+    std::atomic<bool> degraded_;
+
+    // After one inner transfer: counts a timeout or abort and degrades the link
+    bool finish(const TransferWatchdog::Watch& watch, uint64_t startNs, bool ok);
+};
+
+#endif // TRANSFER_WATCHDOG_HPP
@@ -0,0 +1,605 @@
+/**
+ * daemon.cpp - Headless Razer battery daemon
+ *
+ * The device core of the menu bar app (RazerDeviceMonitor, DeviceRegistry,
+ * RazerDevice) without Cocoa. Every supported device is polled on its own
+ * worker at its drain-paced interval, and the cached readings are served over
+ * StatusServer's Unix socket and published in a SharedStatus segment, so any
+ * number of scripts and widgets share this one poll loop and none of them
+ * opens the device.
+ *
+ * Transfer latency histograms of every device are served as the "stats"
+ * request and printed as text on SIGUSR1. --trace PREFIX records every
+ * device's transfers to PREFIX-<id>-<unix time>.rztrace for RazerReplay.
+ * Capability files written by RazerDiscover are loaded at startup from
+ * CapabilityDatabase::defaultDirectory() or --capabilities DIR.
+ *
+ * Usage: RazerBatteryDaemon [--socket PATH] [--shared PATH] [--trace PREFIX] [--capabilities DIR]
+ */
+
+#include "CapabilityDatabase.hpp"
+#include "ConnectionStateMachine.hpp"
+#include "DeviceEvents.hpp"
+#include "DeviceRegistry.hpp"
+#include "DeviceWorker.hpp"
+#include "DrainModel.hpp"
+#include "RazerDevice.hpp"
+#include "RazerDeviceMonitor.hpp"
+#include "SharedStatus.hpp"
+#include "StatusServer.hpp"
+#include <CoreFoundation/CoreFoundation.h>
+#include <dispatch/dispatch.h>
+#include <algorithm>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <time.h>
+#include <vector>
+
+namespace {
+
+// Coalescing keys for device worker jobs (same meaning as in main.mm)
+enum DeviceJobKey : uint32_t {
+    kJobNone = 0,
+    kJobRefresh = 1,
+    kJobReconnect = 2,
+    kJobProbe = 3
+};
+
+uint64_t monotonicMs() {
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW) / 1000000;
+}
+
+uint64_t wallClockMs() {
+    return clock_gettime_nsec_np(CLOCK_REALTIME) / 1000000;
+}
+
+// Per-device state. usb is only touched from the device's worker; everything
+// else belongs to the run loop thread (name and locationId never change).
+struct DaemonDevice {
+    RazerDevice usb;
+    DrainModel drainModel;
+    DeviceStatus status;
+    std::string name;
+    uint32_t locationId = 0;
+    uint64_t nextPollMs = 0;
+    unsigned jobsInFlight = 0;
+    uint64_t registration = 0;  // Tells a re-plug on the same port from the device before it
+};
+
+typedef DeviceRegistry<DaemonDevice> DaemonDevices;
+typedef DaemonDevices::Slot DeviceSlot;
+
+void runRefreshJob(DaemonDevice* device, uint16_t pid, DeviceJobResult& result) {
+    RazerDevice& usb = device->usb;
+    if (!usb.isConnected()) {
+        bool connected = usb.connect(pid, device->locationId);
+        result.reached = usb.connectPhase();
+        if (!connected) {
+            return;
+        }
+    }
+    result.connected = true;
+    result.reached = ConnectionState::Ready;
+    result.pid = usb.connectedPid();
+    result.locationId = usb.connectedLocationId();
+
+    static const RazerCommand refreshCommands[] = {
+        RazerProtocol::CMD_BATTERY,
+        RazerProtocol::CMD_CHARGING
+    };
+    usb.queryAll(refreshCommands, sizeof(refreshCommands) / sizeof(refreshCommands[0]), result.snapshot);
+    result.ok = result.snapshot.batteryValid;
+    if (usb.isDegraded()) {
+        // A transfer got stuck: drop the interface, the reconnect ladder takes over
+        std::cerr << device->name << ": transfers stuck - reconnecting" << std::endl;
+        usb.disconnect();
+        result.connected = false;
+        result.ok = false;
+    }
+}
+
+void runProbeJob(DaemonDevice* device, uint16_t pid, DeviceJobResult& result) {
+    if (device->usb.isConnected() && !device->usb.isAlive()) {
+        device->usb.disconnect();
+        return;
+    }
+    runRefreshJob(device, pid, result);
+}
+
+class BatteryDaemon {
+public:
+    BatteryDaemon();
+    ~BatteryDaemon();
+
+    bool start(const std::string& socketPath, const std::string& sharedPath);
+    void stop();
+
+    // Capture each device registered from now on into PREFIX-<id>-<unix time>.rztrace
+    // (a new file per registration, so a re-plugged device keeps its old trace)
+    void setTracePrefix(const std::string& prefix) { tracePrefix_ = prefix; }
+
+    // Transfer statistics of every device as text on stdout
+    void logStats();
+
+private:
+    struct Completed {
+        uint32_t id;
+        uint64_t registration;  // Of the device the job ran for
+        uint32_t key;
+        DeviceJobResult result;
+    };
+
+    RazerDeviceMonitor monitor_;
+    DaemonDevices devices_;
+    StatusServer server_;
+    SharedStatusWriter shared_;
+    std::string tracePrefix_;
+    uint64_t registrations_;
+    CFRunLoopRef runLoop_;
+    CFRunLoopTimerRef timer_;             // Fires at the next due attempt or poll
+    CFRunLoopSourceRef completionSource_; // Signalled by workers
+
+    std::mutex completedMutex_;
+    std::vector<Completed> completed_;
+
+    void discover();
+    bool isClaimed(const DeviceEvent& event);
+    void registerDevice(const DeviceEvent& event);
+    void unregisterDevice(uint32_t id);
+    void handleEvent(const DeviceEvent& event);
+    void reconnect(DeviceSlot* slot);
+    void publish(const DeviceStatus& status);
+    void publishStats();
+
+    void post(DeviceSlot* slot, uint32_t key);
+    void runDue();
+    void armTimer();
+    void drainCompletions();
+    void handleResult(DeviceSlot* slot, uint32_t key, const DeviceJobResult& result);
+    void handleDeviceEvent(uint32_t id, const RazerEvent& event);
+
+    static void onDeviceChange(void* context, const DeviceEvent& event);
+    static void onTimer(CFRunLoopTimerRef timer, void* info);
+    static void onCompletion(void* info);
+};
+
+BatteryDaemon::BatteryDaemon()
+    : registrations_(0),
+      runLoop_(nullptr),
+      timer_(nullptr),
+      completionSource_(nullptr) {
+}
+
+BatteryDaemon::~BatteryDaemon() {
+    stop();
+}
+
+bool BatteryDaemon::start(const std::string& socketPath, const std::string& sharedPath) {
+    if (!server_.start(socketPath)) {
+        return false;
+    }
+    std::cout << "Serving battery status on " << socketPath << std::endl;
+    if (shared_.open(sharedPath)) {
+        std::cout << "Publishing battery snapshots in " << sharedPath << std::endl;
+    }
+
+    runLoop_ = CFRunLoopGetCurrent();
+
+    CFRunLoopTimerContext timerContext;
+    std::memset(&timerContext, 0, sizeof(timerContext));
+    timerContext.info = this;
+    // Repeats once a day unless re-armed; armTimer() moves it to the next due time
+    timer_ = CFRunLoopTimerCreate(kCFAllocatorDefault, CFAbsoluteTimeGetCurrent() + 86400.0, 86400.0,
+                                  0, 0, onTimer, &timerContext);
+    CFRunLoopAddTimer(runLoop_, timer_, kCFRunLoopDefaultMode);
+
+    CFRunLoopSourceContext sourceContext;
+    std::memset(&sourceContext, 0, sizeof(sourceContext));
+    sourceContext.info = this;
+    sourceContext.perform = onCompletion;
+    completionSource_ = CFRunLoopSourceCreate(kCFAllocatorDefault, 0, &sourceContext);
+    CFRunLoopAddSource(runLoop_, completionSource_, kCFRunLoopDefaultMode);
+
+    monitor_.startMonitoring(onDeviceChange, this);
+    discover();
+    runDue();
+    return true;
+}
+
+void BatteryDaemon::stop() {
+    monitor_.stopMonitoring();
+    for (DeviceSlot* slot : devices_.slots()) {
+        slot->connection.cancel();
+    }
+    devices_.clear();  // Joins every worker before its device goes away
+    server_.stop();
+    shared_.close();
+
+    if (timer_ != nullptr) {
+        CFRunLoopTimerInvalidate(timer_);
+        CFRelease(timer_);
+        timer_ = nullptr;
+    }
+    if (completionSource_ != nullptr) {
+        CFRunLoopSourceInvalidate(completionSource_);
+        CFRelease(completionSource_);
+        completionSource_ = nullptr;
+    }
+}
+
+void BatteryDaemon::discover() {
+    std::vector<DeviceEvent> present;
+    RazerDeviceMonitor::presentDevices(present);
+    for (const DeviceEvent& event : present) {
+        if (!isClaimed(event)) {
+            registerDevice(event);
+        }
+    }
+}
+
+bool BatteryDaemon::isClaimed(const DeviceEvent& event) {
+    for (DeviceSlot* slot : devices_.slots()) {
+        if (classifyDeviceEvent(event, true, slot->pid, slot->device->locationId) != DeviceEventAction::Ignore) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BatteryDaemon::registerDevice(const DeviceEvent& event) {
+    RazerDeviceMatch match = RazerDeviceTable::find(event.pid);
+    if (match.device == nullptr) {
+        return;
+    }
+
+    uint32_t id = event.locationId != 0 ? event.locationId : event.pid;
+    std::unique_ptr<DaemonDevice> device(new DaemonDevice());
+    device->name = match.device->name;
+    device->locationId = event.locationId;
+    device->registration = ++registrations_;
+    device->usb.setEventHandler([this, id](const RazerEvent& deviceEvent) {
+        handleDeviceEvent(id, deviceEvent);
+    });
+    if (!tracePrefix_.empty()) {
+        device->usb.startTrace(tracePrefix_ + "-" + std::to_string(id) + "-" +
+                               std::to_string(wallClockMs() / 1000) + ".rztrace");  // No worker yet
+    }
+
+    DeviceSlot* slot = devices_.add(id, event.pid, std::move(device));
+    if (slot == nullptr) {
+        return;
+    }
+
+    DeviceStatus& status = slot->device->status;
+    status.id = id;
+    status.pid = event.pid;
+    status.name = slot->device->name;
+    publish(status);
+
+    std::cout << "Monitoring " << slot->device->name << " (PID 0x" << std::hex << event.pid
+              << ", location 0x" << event.locationId << std::dec << ")" << std::endl;
+    slot->connection.onDeviceMatched(monotonicMs());
+}
+
+void BatteryDaemon::unregisterDevice(uint32_t id) {
+    DeviceSlot* slot = devices_.find(id);
+    if (slot == nullptr) {
+        return;
+    }
+    std::cout << slot->device->name << " removed" << std::endl;
+    slot->connection.cancel();
+    devices_.remove(id);
+    server_.remove(id);
+    shared_.remove(id);
+    publishStats();
+}
+
+void BatteryDaemon::publish(const DeviceStatus& status) {
+    server_.publish(status);
+    shared_.publish(status);
+}
+
+void BatteryDaemon::publishStats() {
+    // Counters only move while jobs run, so re-rendering after each result keeps
+    // the "stats" reply current without the server thread touching any device
+    std::string json = "{\"stats\":[";
+    bool first = true;
+    for (DeviceSlot* slot : devices_.slots()) {
+        if (!first) {
+            json += ',';
+        }
+        json += "{\"id\":" + std::to_string(slot->id) + ",\"name\":" + StatusServer::quoted(slot->device->name);
+        json += ",\"transfers\":" + slot->device->usb.transferStats().toJson() + "}";
+        first = false;
+    }
+    json += "]}";
+    server_.publishStats(json);
+}
+
+void BatteryDaemon::logStats() {
+    for (DeviceSlot* slot : devices_.slots()) {
+        std::cout << slot->device->name << " (" << slot->id << ")\n"
+                  << slot->device->usb.transferStats().toText() << std::flush;
+    }
+}
+
+void BatteryDaemon::reconnect(DeviceSlot* slot) {
+    RazerDevice* usb = &slot->device->usb;
+    devices_.post(slot->id, kJobNone, [usb](DeviceJobResult&) { usb->disconnect(); });
+    slot->connection.onDeviceLost(monotonicMs());
+}
+
+void BatteryDaemon::handleEvent(const DeviceEvent& event) {
+    if (!RazerDeviceTable::isSupported(event.pid)) {
+        return;
+    }
+
+    bool claimed = false;
+    bool removed = false;
+    for (DeviceSlot* slot : devices_.slots()) {
+        switch (classifyDeviceEvent(event, true, slot->pid, slot->device->locationId)) {
+            case DeviceEventAction::Ignore:
+                break;
+            case DeviceEventAction::Probe:
+                claimed = true;
+                post(slot, kJobProbe);
+                break;
+            case DeviceEventAction::Reconnect:
+                claimed = true;
+                if (event.added) {
+                    reconnect(slot);
+                } else {
+                    unregisterDevice(slot->id);  // slot is gone from here on
+                    removed = true;
+                }
+                break;
+        }
+    }
+
+    if (!claimed && event.added) {
+        registerDevice(event);
+    }
+    if (removed) {
+        discover();
+    }
+    runDue();
+}
+
+void BatteryDaemon::post(DeviceSlot* slot, uint32_t key) {
+    DaemonDevice* device = slot->device.get();
+    uint16_t pid = slot->pid;
+    uint32_t id = slot->id;
+    uint64_t registration = device->registration;
+
+    DeviceWorker::Job job;
+    if (key == kJobProbe) {
+        job = [device, pid](DeviceJobResult& result) { runProbeJob(device, pid, result); };
+    } else {
+        job = [device, pid](DeviceJobResult& result) { runRefreshJob(device, pid, result); };
+    }
+
+    device->jobsInFlight++;
+    devices_.post(id, key, job, [this, id, registration, key](const DeviceJobResult& result) {
+        // Worker thread: hand the result to the run loop
+        {
+            std::lock_guard<std::mutex> lock(completedMutex_);
+            completed_.push_back(Completed{id, registration, key, result});
+        }
+        CFRunLoopSourceSignal(completionSource_);
+        CFRunLoopWakeUp(runLoop_);
+    });
+}
+
+void BatteryDaemon::runDue() {
+    uint64_t now = monotonicMs();
+    for (DeviceSlot* slot : devices_.slots()) {
+        if (slot->device->jobsInFlight > 0) {
+            continue;
+        }
+        if (slot->connection.hasPendingAttempt()) {
+            if (slot->connection.beginAttemptIfDue(now)) {
+                post(slot, kJobReconnect);
+            }
+        } else if (slot->connection.state() == ConnectionState::Ready && now >= slot->device->nextPollMs) {
+            post(slot, kJobRefresh);
+        }
+    }
+    armTimer();
+}
+
+void BatteryDaemon::armTimer() {
+    // Earliest pending connect attempt or poll; nothing due = sleep
+    uint64_t now = monotonicMs();
+    uint64_t due = UINT64_MAX;
+    for (DeviceSlot* slot : devices_.slots()) {
+        if (slot->device->jobsInFlight > 0) {
+            continue;
+        }
+        if (slot->connection.hasPendingAttempt()) {
+            due = std::min(due, slot->connection.nextAttemptAtMs());
+        } else if (slot->connection.state() == ConnectionState::Ready) {
+            due = std::min(due, slot->device->nextPollMs);
+        }
+    }
+    if (due == UINT64_MAX) {
+        return;
+    }
+
+    double delay = due > now ? (double)(due - now) / 1000.0 : 0.0;
+    CFRunLoopTimerSetNextFireDate(timer_, CFAbsoluteTimeGetCurrent() + delay);
+}
+
+void BatteryDaemon::drainCompletions() {
+    std::vector<Completed> completed;
+    {
+        std::lock_guard<std::mutex> lock(completedMutex_);
+        completed.swap(completed_);
+    }
+    for (const Completed& done : completed) {
+        // Unregistered while the job ran, possibly with the same port
+        // registered again since: the result belongs to a device that is gone
+        DeviceSlot* slot = devices_.find(done.id);
+        if (slot == nullptr || slot->device->registration != done.registration ||
+            slot->device->jobsInFlight == 0) {
+            continue;
+        }
+        slot->device->jobsInFlight--;
+        handleResult(slot, done.key, done.result);
+    }
+    runDue();
+}
+
+void BatteryDaemon::handleResult(DeviceSlot* slot, uint32_t key, const DeviceJobResult& result) {
+    uint64_t now = monotonicMs();
+    DaemonDevice& device = *slot->device;
+    slot->last = result;
+
+    if (key == kJobReconnect) {
+        slot->connection.onAttemptFinished(result.reached, now);
+        if (slot->connection.state() == ConnectionState::Ready) {
+            std::cout << "Connected to " << device.name << std::endl;
+        } else {
+            std::cerr << device.name << ": connect attempt " << slot->connection.attempts()
+                      << " stopped at " << connectionStateName(result.reached) << std::endl;
+        }
+    } else if (!result.connected && !slot->connection.hasPendingAttempt()) {
+        reconnect(slot);  // Stopped answering, or re-enumerated in another mode
+    }
+
+    if (result.ok) {
+        bool charging = result.snapshot.chargingValid && result.snapshot.isCharging;
+        BatterySample sample;
+        sample.timeMs = wallClockMs();
+        sample.latencyUs = result.snapshot.elapsedUs;
+        sample.percent = result.snapshot.batteryPercent;
+        sample.charging = charging;
+        device.drainModel.add(sample);
+        slot->scheduler.addSample(now, sample.percent, charging);
+    }
+    if (slot->connection.state() == ConnectionState::Ready) {
+        device.nextPollMs = now + slot->scheduler.nextIntervalMs();
+    }
+
+    updateDeviceStatus(device.status, result, device.drainModel, wallClockMs());
+    publish(device.status);
+    publishStats();
+}
+
+void BatteryDaemon::handleDeviceEvent(uint32_t id, const RazerEvent& event) {
+    // Interrupt pipe completion, on the run loop thread like everything else here
+    DeviceSlot* slot = devices_.find(id);
+    if (slot == nullptr || !slot->last.connected) {
+        return;
+    }
+    DaemonDevice& device = *slot->device;
+
+    DeviceJobResult result = slot->last;
+    if (!RazerProtocol::applyEvent(event, result.snapshot)) {
+        if (device.jobsInFlight == 0) {
+            post(slot, kJobRefresh);  // Something changed; ask for the details now
+        }
+        return;
+    }
+    result.ok = result.snapshot.batteryValid;
+    slot->last = result;
+
+    uint64_t now = monotonicMs();
+    bool charging = result.snapshot.chargingValid && result.snapshot.isCharging;
+    if (event.kind == RazerEventKind::Battery) {
+        BatterySample sample;
+        sample.timeMs = wallClockMs();
+        sample.percent = event.batteryPercent;
+        sample.charging = charging;
+        device.drainModel.add(sample);
+    }
+    if (result.ok) {
+        slot->scheduler.addSample(now, result.snapshot.batteryPercent, charging);  // Re-paces on a charger change
+        device.nextPollMs = now + slot->scheduler.nextIntervalMs();
+    }
+
+    updateDeviceStatus(device.status, result, device.drainModel, wallClockMs());
+    publish(device.status);
+    armTimer();
+}
+
+void BatteryDaemon::onDeviceChange(void* context, const DeviceEvent& event) {
+    // IOKit notifications arrive on the run loop thread already
+    static_cast<BatteryDaemon*>(context)->handleEvent(event);
+}
+
+void BatteryDaemon::onTimer(CFRunLoopTimerRef timer, void* info) {
+    (void)timer;
+    static_cast<BatteryDaemon*>(info)->runDue();
+}
+
+void BatteryDaemon::onCompletion(void* info) {
+    static_cast<BatteryDaemon*>(info)->drainCompletions();
+}
+
+void onTerminate(void* context) {
+    (void)context;
+    CFRunLoopStop(CFRunLoopGetMain());
+}
+
+void onDumpStats(void* context) {
+    static_cast<BatteryDaemon*>(context)->logStats();
+}
+
+void watchSignal(int signalNumber, dispatch_function_t handler, void* context) {
+    // Handled on the main queue (drained by the run loop), not in signal context
+    signal(signalNumber, SIG_IGN);
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_SIGNAL, (uintptr_t)signalNumber,
+                                                      0, dispatch_get_main_queue());
+    dispatch_set_context(source, context);
+    dispatch_source_set_event_handler_f(source, handler);
+    dispatch_resume(source);
+}
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    std::string socketPath = StatusServer::defaultSocketPath();
+    std::string sharedPath = defaultSharedStatusPath();
+    std::string tracePrefix;
+    std::string capabilityDir = CapabilityDatabase::defaultDirectory();
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socketPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--shared") == 0 && i + 1 < argc) {
+            sharedPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePrefix = argv[++i];
+        } else if (std::strcmp(argv[i], "--capabilities") == 0 && i + 1 < argc) {
+            capabilityDir = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--socket PATH] [--shared PATH] [--trace PREFIX]"
+                      << " [--capabilities DIR]" << std::endl;
+            return 2;
+        }
+    }
+
+    // Before any device connects: every instance reads it without locking
+    CapabilityDatabase capabilities;
+    if (capabilities.loadDirectory(capabilityDir) && capabilities.size() != 0) {
+        std::cout << "Loaded capabilities of " << capabilities.size() << " device(s) from " << capabilityDir << std::endl;
+        RazerDevice::setCapabilities(&capabilities);
+    }
+
+    BatteryDaemon daemon;
+    signal(SIGPIPE, SIG_IGN);
+    watchSignal(SIGINT, onTerminate, nullptr);
+    watchSignal(SIGTERM, onTerminate, nullptr);
+    watchSignal(SIGUSR1, onDumpStats, &daemon);
+    daemon.setTracePrefix(tracePrefix);
+
+    if (!daemon.start(socketPath, sharedPath)) {
+        return 1;
+    }
+    CFRunLoopRun();
+    daemon.stop();
+    return 0;
+}
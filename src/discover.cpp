@@ -0,0 +1,173 @@
+/**
+ * discover.cpp - Sweeps every attached Razer device for the commands it answers
+ *
+ * Replaces CommandScanner's hand-written list of 18 commands and fixed sleeps
+ * with DiscoveryEngine: every transaction ID, then every get command
+ * (class 0x00-0xFF, id 0x80-0xFF) under the IDs the device answers, each
+ * device on its own thread. Progress is checkpointed next to the output, so
+ * Ctrl-C and a second run continue where the first stopped. The results are
+ * merged into razer-<pid>.caps (with the table's response layout for a new
+ * PID), which the app and the daemon map at startup.
+ *
+ * Usage: RazerDiscover [--out DIR] [--classes FIRST-LAST] [--tid ID] [--fresh]
+ */
+
+#include "CapabilityDatabase.hpp"
+#include "DiscoveryEngine.hpp"
+#include "RazerDevice.hpp"
+#include "RazerDeviceMonitor.hpp"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+std::atomic<bool> stopRequested(false);
+std::mutex outputMutex;
+
+void onInterrupt(int) {
+    stopRequested.store(true, std::memory_order_relaxed);
+}
+
+// mkdir -p
+bool makeDirectories(const std::string& path) {
+    for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+        std::string prefix = path.substr(0, slash);
+        if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+            return false;
+        }
+        if (slash == std::string::npos) {
+            return true;
+        }
+    }
+}
+
+std::string checkpointPath(const std::string& dir, const DeviceEvent& event) {
+    char name[64];
+    snprintf(name, sizeof(name), "/discover-%04x-%08x.ckpt", event.pid, event.locationId);
+    return dir + name;
+}
+
+void discoverDevice(const DeviceEvent& event, const DiscoveryOptions& options, const std::string& dir,
+                    bool fresh) {
+    RazerDevice device;
+    if (!device.connect(event.pid, event.locationId)) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        std::cerr << "PID 0x" << std::hex << event.pid << std::dec << ": cannot open the device" << std::endl;
+        return;
+    }
+
+    std::string checkpoint = checkpointPath(dir, event);
+    if (fresh) {
+        unlink(checkpoint.c_str());
+    }
+    DiscoveryEngine engine;
+    if (!engine.openCheckpoint(checkpoint, event.pid)) {
+        return;
+    }
+    if (engine.resumedRecords() != 0) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        printf("PID 0x%04x: resuming after %llu probes\n", event.pid, (unsigned long long)engine.resumedRecords());
+    }
+
+    uint16_t pid = event.pid;
+    engine.setProgressHandler([pid](const DiscoveryRecord& record) {
+        bool answered = DiscoveryEngine::isDataStatus(record.status);
+        if (record.kind == DISCOVERY_SKIP_CLASS || (record.kind == DISCOVERY_COMMAND && !answered) ||
+            (record.kind == DISCOVERY_TRANSACTION && !answered && !DiscoveryEngine::isUnsupportedStatus(record.status))) {
+            return;  // Only what the device answers is worth a line
+        }
+        std::lock_guard<std::mutex> lock(outputMutex);
+        printf("PID 0x%04x: %s 0x%02x/0x%02x transaction 0x%02x status 0x%02x size %u%s %.1f ms%s\n",
+               pid, record.kind == DISCOVERY_TRANSACTION ? "transaction ID" : "command",
+               record.cmdClass, record.cmdId, record.transactionId, record.status, record.dataSize,
+               (record.flags & DISCOVERY_HAS_DATA) ? " with data" : "", record.latencyUs / 1000.0,
+               record.attempts > 1 ? " (busy, retried)" : "");
+        fflush(stdout);
+    });
+
+    bool complete = engine.run(*device.transport(), options, &stopRequested);
+
+    RazerCapabilities capabilities;
+    std::string path = dir + "/" + CapabilityDatabase::fileName(event.pid);
+    if (!CapabilityDatabase::load(path, capabilities)) {
+        capabilities = RazerCapabilities();
+        capabilities.describe(RazerDeviceTable::find(event.pid));
+    }
+    capabilities.pid = event.pid;
+    capabilities.merge(engine.records());
+    bool saved = CapabilityDatabase::save(dir, capabilities);
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    printf("PID 0x%04x: %zu commands on transaction 0x%02x (%s%s), %llu probes this run%s%s\n",
+           event.pid, capabilities.commands.size(), capabilities.transactionId,
+           (capabilities.flags & CAPABILITY_WIRELESS) ? "wireless" : "wired",
+           (capabilities.flags & CAPABILITY_NO_BATTERY) ? ", no battery query" : "",
+           (unsigned long long)engine.probesSent(), saved ? ", saved to " : "", saved ? path.c_str() : "");
+    if (complete) {
+        engine.closeCheckpoint();
+        unlink(checkpoint.c_str());
+    } else {
+        printf("PID 0x%04x: sweep incomplete, run again to resume from %s\n", event.pid, checkpoint.c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    std::string dir = CapabilityDatabase::defaultDirectory();
+    DiscoveryOptions options;
+    bool fresh = false;
+    for (int i = 1; i < argc; i++) {
+        unsigned first = 0;
+        unsigned last = 0;
+        if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (std::strcmp(argv[i], "--classes") == 0 && i + 1 < argc &&
+                   sscanf(argv[i + 1], "%x-%x", &first, &last) == 2 && first <= last && last <= 0xFF) {
+            options.firstClass = (uint8_t)first;
+            options.lastClass = (uint8_t)last;
+            i++;
+        } else if (std::strcmp(argv[i], "--tid") == 0 && i + 1 < argc) {
+            options.transactionIds.push_back((uint8_t)strtoul(argv[++i], nullptr, 16));
+        } else if (std::strcmp(argv[i], "--fresh") == 0) {
+            fresh = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--out DIR] [--classes FIRST-LAST] [--tid ID] [--fresh]" << std::endl;
+            return 2;
+        }
+    }
+    if (!makeDirectories(dir)) {
+        std::cerr << "Cannot create " << dir << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    std::vector<DeviceEvent> devices;
+    RazerDeviceMonitor::presentDevices(devices);
+    if (devices.empty()) {
+        std::cerr << "No supported Razer device attached" << std::endl;
+        return 1;
+    }
+    signal(SIGINT, onInterrupt);
+
+    // The device holds one report buffer, so one thread per device is the
+    // parallelism there is
+    std::vector<std::thread> threads;
+    for (const DeviceEvent& event : devices) {
+        threads.emplace_back(discoverDevice, event, options, dir, fresh);
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    return stopRequested.load() ? 130 : 0;
+}
@@ -2,60 +2,272 @@
 #import <IOKit/IOKitLib.h>
 #import <IOKit/usb/IOUSBLib.h>
 #import "RazerDevice.hpp"
+#import "RazerDeviceMonitor.hpp"
+#import "DeviceRegistry.hpp"
+#import "DeviceWorker.hpp"
+#import "ConnectionStateMachine.hpp"
+#import "PollScheduler.hpp"
+#import "DrainModel.hpp"
+#import "SampleRing.hpp"
+#import "HistoryLog.hpp"
+#import "DeviceStatus.hpp"
+#import "SharedStatus.hpp"
+#import "CapabilityDatabase.hpp"
+#import "MenuBarState.hpp"
+#include <memory>
+#include <string>
+#include <time.h>
+#include <vector>
 
 // Forward declaration
 @class BatteryMonitorApp;
 
-// Static callback for RazerDevice monitoring
-static void onDeviceChange(void* context) {
-    BatteryMonitorApp* app = (__bridge BatteryMonitorApp*)context;
-    // Ensure we run on main thread for UI updates
-    dispatch_async(dispatch_get_main_queue(), ^{
-        [app performSelector:@selector(handleUSBEvent)];
-    });
+// Coalescing keys for device worker jobs (0 = never coalesced)
+enum DeviceJobKey : uint32_t {
+    kJobNone = 0,
+    kJobRefresh = 1,    // Connect if needed, then battery + charging batch
+    kJobReconnect = 2,  // Same work, requested by the hotplug retry ladder
+    kJobProbe = 3       // Liveness check on the open interface, then refresh
+};
+
+// Readings handed from the device worker (producer) to the main thread (consumer)
+typedef SampleRing<BatterySample, 256> BatterySampleRing;
+
+// Everything the app keeps per monitored device. usb is only touched from the
+// device's worker and samples is the hand-off to the main thread; name and
+// locationId are fixed at registration, the rest belongs to the main thread.
+struct MonitoredDevice {
+    RazerDevice usb;
+    BatterySampleRing samples;
+    DrainModel drainModel;
+    HistoryLog history;
+    DeviceStatus status;  // What other processes see through sharedStatus_
+    std::string name;
+    uint32_t locationId = 0;
+    bool everConnected = false;
+    uint8_t lastBatteryLevel = 0;
+    bool notificationShown = false;
+};
+
+typedef DeviceRegistry<MonitoredDevice> MonitoredDevices;
+typedef MonitoredDevices::Slot DeviceSlot;
+
+// One device's row in the menu; equal rows render the same text (the name is
+// fixed per registry key and PID)
+struct DeviceMenuRow {
+    uint32_t id;
+    uint16_t pid;
+    MenuBarState state;
+
+    bool operator==(const DeviceMenuRow& other) const {
+        return id == other.id && pid == other.pid && state == other.state;
+    }
+};
+
+// One device's line in the tooltip, at the minute resolution it is shown in
+struct DeviceEstimate {
+    uint32_t id;
+    uint16_t pid;
+    bool toFull;
+    uint64_t minutes;
+
+    bool operator==(const DeviceEstimate& other) const {
+        return id == other.id && pid == other.pid && toFull == other.toFull && minutes == other.minutes;
+    }
+};
+
+// Registry key: the USB location is stable per port; fall back to the PID
+static uint32_t deviceKeyFor(const DeviceEvent& event) {
+    return event.locationId != 0 ? event.locationId : event.pid;
+}
+
+// Monotonic clock for timers and the connection state machine
+static uint64_t monotonicMs() {
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW) / 1000000;
+}
+
+// Title color of a menu bar state (TintNone has no attributed title)
+static NSColor* colorForTint(MenuBarState::Tint tint) {
+    switch (tint) {
+        case MenuBarState::TintRed:
+            return [NSColor systemRedColor];
+        case MenuBarState::TintYellow:
+            return [NSColor systemYellowColor];
+        case MenuBarState::TintGreen:
+            return [NSColor systemGreenColor];
+        default:
+            return [NSColor systemGrayColor];
+    }
+}
+
+// Wall clock for battery samples, which outlive the process in the history log
+static uint64_t wallClockMs() {
+    return clock_gettime_nsec_np(CLOCK_REALTIME) / 1000000;
+}
+
+// Runs on the device's worker: (re)connect if needed and read one snapshot
+static void runRefreshJob(MonitoredDevice* monitored, uint16_t pid, DeviceJobResult& result) {
+    RazerDevice* device = &monitored->usb;
+    if (!device->isConnected()) {
+        bool connected = device->connect(pid, monitored->locationId);
+        result.reached = device->connectPhase();
+        if (!connected) {
+            result.connected = false;
+            return;
+        }
+        NSLog(@"Connected to %s", monitored->name.c_str());
+    }
+    result.connected = true;
+    result.reached = ConnectionState::Ready;
+    result.pid = device->connectedPid();
+    result.locationId = device->connectedLocationId();
+    
+    // Battery and charging in one batch (add telemetry commands here as needed)
+    static const RazerCommand refreshCommands[] = {
+        RazerProtocol::CMD_BATTERY,
+        RazerProtocol::CMD_CHARGING
+    };
+    device->queryAll(refreshCommands, sizeof(refreshCommands) / sizeof(refreshCommands[0]), result.snapshot);
+    result.ok = result.snapshot.batteryValid;
+    if (device->isDegraded()) {
+        // A transfer got stuck: drop the interface, the reconnect ladder takes over
+        NSLog(@"%s: transfers stuck - reconnecting", monitored->name.c_str());
+        device->disconnect();
+        result.connected = false;
+        result.ok = false;
+        return;
+    }
+    
+    if (result.ok) {
+        BatterySample sample;
+        sample.timeMs = wallClockMs();
+        sample.latencyUs = result.snapshot.elapsedUs;
+        sample.percent = result.snapshot.batteryPercent;
+        sample.transactionId = device->transactionId();
+        sample.charging = result.snapshot.chargingValid && result.snapshot.isCharging;
+        monitored->samples.push(sample);
+    }
+}
+
+// Runs on the device's worker: keep the open interface if it still answers
+static void runProbeJob(MonitoredDevice* monitored, uint16_t pid, DeviceJobResult& result) {
+    RazerDevice* device = &monitored->usb;
+    if (device->isConnected() && !device->isAlive()) {
+        NSLog(@"%s stopped answering - dropping interface", monitored->name.c_str());
+        device->disconnect();
+        result.connected = false;
+        return;
+    }
+    runRefreshJob(monitored, pid, result);
 }
 
 @interface BatteryMonitorApp : NSObject <NSApplicationDelegate> {
     NSStatusItem* statusItem_;
-    RazerDevice* razerDevice_;
-    NSTimer* pollTimer_;
-    uint8_t lastBatteryLevel_;
-    bool notificationShown_;
+    RazerDeviceMonitor* deviceMonitor_;  // Discovery + hotplug notifications
+    MonitoredDevices* devices_;    // One slot (worker, connect state, poll schedule) per device
+    NSMutableDictionary* pollTimers_;    // Device key -> one-shot NSTimer, re-armed by its scheduler
+    NSMutableArray* deviceMenuItems_;    // Per-device rows at the top of the menu
+    NSString* historyDirectory_;
+    SharedStatusWriter* sharedStatus_;   // Snapshots for widgets, read without syscalls
+    CapabilityDatabase* capabilities_;   // RazerDiscover results, read by every RazerDevice
+    NSImage* mouseIcon_;                 // SF Symbol, resolved once (nil: emoji titles instead)
+    NSArray* readingTitles_;             // Colored title per MenuBarState::readingIndex()
+    MenuBarState shownState_;            // What the status item shows now
+    bool menuBarDrawn_;                  // shownState_ is on screen
+    std::vector<DeviceMenuRow> shownRows_;        // What deviceMenuItems_ show now
+    std::vector<DeviceEstimate> shownEstimates_;  // What the tooltip shows now
 }
 
-- (void)updateBatteryDisplay;
+- (void)discoverDevices;
+- (bool)isClaimed:(const DeviceEvent&)event;
+- (void)registerDevice:(const DeviceEvent&)event;
+- (void)unregisterDevice:(uint32_t)deviceId;
+- (void)refreshDevice:(uint32_t)deviceId;
+- (void)postDeviceJob:(uint32_t)deviceId key:(uint32_t)key job:(DeviceWorker::Job)job completion:(void (^)(DeviceSlot* slot, const DeviceJobResult& result))completion;
+- (void)postRefresh:(uint32_t)deviceId key:(uint32_t)key completion:(void (^)(DeviceSlot* slot, const DeviceJobResult& result))completion;
+- (DeviceSlot*)acceptResult:(const DeviceJobResult&)result forDevice:(uint32_t)deviceId;
+- (void)handleProbeResult:(const DeviceJobResult&)result slot:(DeviceSlot*)slot;
+- (void)displayResult:(const DeviceJobResult&)result device:(MonitoredDevice*)device;
+- (void)showMenuBarState:(const MenuBarState&)state;
+- (NSAttributedString*)titleForState:(const MenuBarState&)state;
+- (void)updateStatusItem;
+- (void)updateDeviceMenu;
+- (void)showNotFound;
 - (void)pollBattery:(NSTimer*)timer;
-- (void)connectToDevice;
-- (void)handleUSBEvent;
-- (NSImage*)mouseIconWithColor:(NSColor*)color;
+- (void)handleUSBEvent:(const DeviceEvent&)event;
+- (void)probeDevice:(uint32_t)deviceId;
+- (void)reconnectDevice:(uint32_t)deviceId;
+- (void)startConnecting:(uint32_t)deviceId;
+- (void)armConnectTimer:(uint32_t)deviceId;
+- (void)connectTimerFired:(uint32_t)deviceId;
+- (void)noteReading:(const DeviceJobResult&)result slot:(DeviceSlot*)slot;
+- (void)checkLowBattery:(const DeviceJobResult&)result device:(MonitoredDevice*)device;
+- (void)schedulePoll:(DeviceSlot*)slot;
+- (void)cancelPoll:(uint32_t)deviceId;
+- (void)drainSamples:(MonitoredDevice*)device;
+- (void)updateEstimate;
+- (void)openHistory:(MonitoredDevice*)device model:(const RazerSupportedDevice&)model;
+- (void)publishStatus:(MonitoredDevice*)device;
+- (void)handleDeviceEvent:(const RazerEvent&)event device:(uint32_t)deviceId;
+- (NSImage*)loadMouseIcon;
+- (void)showLowBatteryNotification:(uint8_t)batteryPercent device:(MonitoredDevice*)device;
 @end
 
+// Static callback for RazerDeviceMonitor
+static void onDeviceChange(void* context, const DeviceEvent& event) {
+    BatteryMonitorApp* app = (__bridge BatteryMonitorApp*)context;
+    DeviceEvent copy = event;
+    // Ensure we run on main thread for UI updates
+    dispatch_async(dispatch_get_main_queue(), ^{
+        [app handleUSBEvent:copy];
+    });
+}
+
 @implementation BatteryMonitorApp
 
 - (instancetype)init {
     self = [super init];
     if (self) {
         statusItem_ = nil;
-        // Create device instance immediately and keep it alive
-        razerDevice_ = new RazerDevice();
-        pollTimer_ = nil;
-        lastBatteryLevel_ = 0;
-        notificationShown_ = false;
+        deviceMonitor_ = new RazerDeviceMonitor();
+        devices_ = new MonitoredDevices();
+        pollTimers_ = [[NSMutableDictionary alloc] init];
+        deviceMenuItems_ = [[NSMutableArray alloc] init];
+        historyDirectory_ = nil;
+        sharedStatus_ = new SharedStatusWriter();
+        capabilities_ = new CapabilityDatabase();
+        mouseIcon_ = nil;
+        readingTitles_ = nil;
+        menuBarDrawn_ = false;
     }
     return self;
 }
 
 - (void)dealloc {
-    if (pollTimer_) {
-        [pollTimer_ invalidate];
-        pollTimer_ = nil;
+    for (NSTimer* timer in [pollTimers_ allValues]) {
+        [timer invalidate];
     }
-    if (razerDevice_) {
+    [pollTimers_ release];
+    [deviceMenuItems_ release];
+    [historyDirectory_ release];
+    [mouseIcon_ release];
+    [readingTitles_ release];
+    if (deviceMonitor_) {
         // Stop monitoring before deleting
-        razerDevice_->stopMonitoring();
-        delete razerDevice_;
-        razerDevice_ = nil;
+        deviceMonitor_->stopMonitoring();
+        delete deviceMonitor_;
+        deviceMonitor_ = nullptr;
     }
+    if (devices_) {
+        // Joins every worker before the devices they use go away
+        delete devices_;
+        devices_ = nullptr;
+    }
+    delete sharedStatus_;  // Removes the segment file
+    sharedStatus_ = nullptr;
+    RazerDevice::setCapabilities(nullptr);  // Workers are gone
+    delete capabilities_;
+    capabilities_ = nullptr;
     [super dealloc];
 }
 
@@ -63,255 +275,700 @@ static void onDeviceChange(void* context) {
     // STEP 1: Create UI FIRST
     NSStatusBar* statusBar = [NSStatusBar systemStatusBar];
     statusItem_ = [[statusBar statusItemWithLength:NSVariableStatusItemLength] retain];
-    
-    NSImage* mouseIcon = [self mouseIconWithColor:[NSColor whiteColor]];
-    if (mouseIcon) {
-        statusItem_.button.image = mouseIcon;
-        statusItem_.button.title = @"...";
+
+    // The icon is a template image and every title is built here once; later
+    // updates only swap the title, and only when the shown state changes
+    mouseIcon_ = [[self loadMouseIcon] retain];
+    if (mouseIcon_) {
+        statusItem_.button.image = mouseIcon_;
         statusItem_.button.imagePosition = NSImageLeft;
-    } else {
-        statusItem_.button.title = @"🖱️ ...";
     }
+    NSMutableArray* titles = [[NSMutableArray alloc] initWithCapacity:MenuBarState::READING_STATES];
+    for (size_t i = 0; i < MenuBarState::READING_STATES; i++) {
+        [titles addObject:[self titleForState:MenuBarState::reading((uint8_t)(i / 2), (i % 2) != 0)]];
+    }
+    readingTitles_ = titles;
+    [self showMenuBarState:MenuBarState::of(MenuBarState::Connecting)];
     statusItem_.button.toolTip = @"Razer Battery Monitor";
-    
+
     // Create menu
     NSMenu* menu = [[NSMenu alloc] init];
-    
-    NSMenuItem* refreshItem = [[NSMenuItem alloc] initWithTitle:@"Refresh" 
-                                                         action:@selector(manualRefresh:) 
+
+    NSMenuItem* refreshItem = [[NSMenuItem alloc] initWithTitle:@"Refresh"
+                                                         action:@selector(manualRefresh:)
                                                   keyEquivalent:@"r"];
     [refreshItem setTarget:self];
     [menu addItem:refreshItem];
-    
+
+    NSMenuItem* statsItem = [[NSMenuItem alloc] initWithTitle:@"Copy Transfer Statistics"
+                                                       action:@selector(copyTransferStats:)
+                                                keyEquivalent:@""];
+    [statsItem setTarget:self];
+    [menu addItem:statsItem];
+    [statsItem release];
+
     [menu addItem:[NSMenuItem separatorItem]];
-    
-    NSMenuItem* quitItem = [[NSMenuItem alloc] initWithTitle:@"Quit" 
-                                                       action:@selector(terminate:) 
+
+    NSMenuItem* quitItem = [[NSMenuItem alloc] initWithTitle:@"Quit"
+                                                       action:@selector(terminate:)
                                                 keyEquivalent:@"q"];
     [quitItem setTarget:NSApp];
     [menu addItem:quitItem];
     statusItem_.menu = menu;
-    
+
     // STEP 2: Force UI to appear immediately
     [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.1]];
-    
-    // STEP 3: Start IOKit Hotplug Monitoring via RazerDevice
-    if (razerDevice_) {
-        razerDevice_->startMonitoring(onDeviceChange, (__bridge void*)self);
+
+    // Optional: the daemon may already publish the segment
+    sharedStatus_->open(defaultSharedStatusPath());
+
+    // Discovered transaction IDs, loaded before the first connect reads them
+    if (capabilities_->loadDirectory(CapabilityDatabase::defaultDirectory()) && capabilities_->size() != 0) {
+        NSLog(@"Loaded capabilities of %zu device(s)", capabilities_->size());
+        RazerDevice::setCapabilities(capabilities_);
     }
-    
-    // STEP 4: Connect to device
-    [self performSelector:@selector(connectToDevice) withObject:nil afterDelay:0.5];
+
+    // STEP 3: Start IOKit Hotplug Monitoring (changes from here on)
+    deviceMonitor_->startMonitoring(onDeviceChange, (__bridge void*)self);
+
+    // STEP 4: Register every supported device attached now and connect them all
+    [self discoverDevices];
+    [self updateStatusItem];
 }
 
-- (void)handleUSBEvent {
-    NSLog(@"USB event detected - refreshing...");
-    
-    // Reconnect to device (may have changed mode)
-    if (razerDevice_) {
-        razerDevice_->disconnect();
-        
-        // Aggressive Retry Logic: Try to reconnect multiple times
-        // This ensures we catch the device as soon as it finishes enumeration
-        
-        // 1s
-        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(1.0 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-            if (razerDevice_->connect()) [self updateBatteryDisplay];
-        });
+- (void)discoverDevices {
+    std::vector<DeviceEvent> present;
+    RazerDeviceMonitor::presentDevices(present);
+    for (const DeviceEvent& event : present) {
+        if (![self isClaimed:event]) {
+            [self registerDevice:event];
+        }
+    }
+}
 
-        // 3s
-        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(3.0 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-            if (razerDevice_->connect()) [self updateBatteryDisplay];
-        });
+- (bool)isClaimed:(const DeviceEvent&)event {
+    // Already monitored, or the other PID of a monitored mouse (cable next to its dongle)
+    for (DeviceSlot* slot : devices_->slots()) {
+        if (classifyDeviceEvent(event, true, slot->pid, slot->device->locationId) != DeviceEventAction::Ignore) {
+            return true;
+        }
+    }
+    return false;
+}
 
-        // 6s
-        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(6.0 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-            if (razerDevice_->connect()) [self updateBatteryDisplay];
-        });
-        
-        // 10s
-        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(10.0 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-            if (razerDevice_->connect()) [self updateBatteryDisplay];
+- (void)registerDevice:(const DeviceEvent&)event {
+    RazerDeviceMatch match = RazerDeviceTable::find(event.pid);
+    if (match.device == nullptr) {
+        return;
+    }
+
+    uint32_t deviceId = deviceKeyFor(event);
+    std::unique_ptr<MonitoredDevice> device(new MonitoredDevice());
+    device->name = match.device->name;
+    device->locationId = event.locationId;
+    device->usb.setEventHandler([self, deviceId](const RazerEvent& deviceEvent) {
+        [self handleDeviceEvent:deviceEvent device:deviceId];
+    });
+    [self openHistory:device.get() model:*match.device];
+
+    DeviceSlot* slot = devices_->add(deviceId, event.pid, std::move(device));
+    if (slot == nullptr) {
+        return;
+    }
+    if (slot->device->lastBatteryLevel > 0) {
+        slot->last.connected = true;  // Shown as "NN% (?)" until a live reading arrives
+    }
+    slot->device->status.id = slot->id;
+    slot->device->status.pid = event.pid;
+    slot->device->status.name = slot->device->name;
+    [self publishStatus:slot->device.get()];
+
+    NSLog(@"Monitoring %s (PID 0x%04x, location 0x%08x)", slot->device->name.c_str(),
+          event.pid, event.locationId);
+    [self startConnecting:slot->id];
+}
+
+- (void)unregisterDevice:(uint32_t)deviceId {
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr) {
+        return;
+    }
+    NSLog(@"%s removed", slot->device->name.c_str());
+    [self cancelPoll:deviceId];
+    slot->connection.cancel();
+    devices_->remove(deviceId);  // Pending connect timers see the slot gone
+    sharedStatus_->remove(deviceId);
+}
+
+- (DeviceSlot*)acceptResult:(const DeviceJobResult&)result forDevice:(uint32_t)deviceId {
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr) {
+        return nullptr;  // Unregistered while the job ran
+    }
+    slot->last = result;
+    if (result.ok) {
+        slot->device->lastBatteryLevel = result.snapshot.batteryPercent;
+    }
+    [self drainSamples:slot->device.get()];
+    updateDeviceStatus(slot->device->status, result, slot->device->drainModel, wallClockMs());
+    [self publishStatus:slot->device.get()];
+    return slot;
+}
+
+- (void)handleDeviceEvent:(const RazerEvent&)event device:(uint32_t)deviceId {
+    // Interrupt pipe completion, already on the main run loop
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr || !slot->last.connected) {
+        return;
+    }
+
+    DeviceJobResult result = slot->last;
+    if (!RazerProtocol::applyEvent(event, result.snapshot)) {
+        [self refreshDevice:deviceId];  // Something changed; ask for the details now
+        return;
+    }
+    result.ok = result.snapshot.batteryValid;
+
+    if (event.kind == RazerEventKind::Battery) {
+        BatterySample sample;
+        sample.timeMs = wallClockMs();
+        sample.percent = event.batteryPercent;
+        sample.charging = result.snapshot.chargingValid && result.snapshot.isCharging;
+        slot->device->drainModel.add(sample);
+        slot->device->history.append(HistoryLog::makeRecord(sample));
+    }
+
+    slot = [self acceptResult:result forDevice:deviceId];
+    [self noteReading:result slot:slot];  // A charger change re-paces the poll
+    [self updateStatusItem];
+}
+
+- (void)publishStatus:(MonitoredDevice*)device {
+    sharedStatus_->publish(device->status);  // No-op when the segment is not open
+}
+
+- (void)postDeviceJob:(uint32_t)deviceId key:(uint32_t)key job:(DeviceWorker::Job)job completion:(void (^)(DeviceSlot* slot, const DeviceJobResult& result))completion {
+    if (devices_->find(deviceId) == nullptr) {
+        return;
+    }
+
+    // Released once delivered (each completion runs exactly once)
+    void (^mainCompletion)(DeviceSlot*, const DeviceJobResult&) = [completion copy];
+
+    devices_->post(deviceId, key, job,
+        [self, deviceId, mainCompletion](const DeviceJobResult& result) {
+            // Deliver on the main queue - UI is only touched there
+            DeviceJobResult copy = result;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                DeviceSlot* slot = [self acceptResult:copy forDevice:deviceId];
+                if (slot != nullptr) {
+                    mainCompletion(slot, copy);
+                }
+                [mainCompletion release];
+            });
         });
-        
-        // 15s - Last attempt
-        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(15.0 * NSEC_PER_SEC)), dispatch_get_main_queue(), ^{
-             if (razerDevice_->connect()) {
-                 [self updateBatteryDisplay];
-             } else {
-                // Only show "Not Found" if ALL attempts fail after 15 seconds
-                NSImage* icon = [self mouseIconWithColor:[NSColor systemGrayColor]];
-                if (icon) {
-                    statusItem_.button.image = icon;
-                    statusItem_.button.title = @"Not Found";
+}
+
+- (void)postRefresh:(uint32_t)deviceId key:(uint32_t)key completion:(void (^)(DeviceSlot* slot, const DeviceJobResult& result))completion {
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr) {
+        return;
+    }
+    MonitoredDevice* device = slot->device.get();
+    uint16_t pid = slot->pid;
+    DeviceWorker::Job job = [device, pid](DeviceJobResult& result) { runRefreshJob(device, pid, result); };
+    [self postDeviceJob:deviceId key:key job:job completion:completion];
+}
+
+- (void)handleUSBEvent:(const DeviceEvent&)event {
+    if (!RazerDeviceTable::isSupported(event.pid)) {
+        return;  // Keyboard, headset, ... on the same VID
+    }
+
+    bool claimed = false;
+    bool removed = false;
+    for (DeviceSlot* slot : devices_->slots()) {
+        uint32_t deviceId = slot->id;
+        DeviceEventAction action = classifyDeviceEvent(event, true, slot->pid, slot->device->locationId);
+
+        switch (action) {
+            case DeviceEventAction::Ignore:
+                // Another device - keep its interface untouched
+                break;
+            case DeviceEventAction::Probe:
+                NSLog(@"USB event for sibling PID 0x%04x - probing %s", event.pid, slot->device->name.c_str());
+                claimed = true;
+                [self probeDevice:deviceId];
+                break;
+            case DeviceEventAction::Reconnect:
+                claimed = true;
+                if (event.added) {
+                    NSLog(@"USB event for PID 0x%04x - reconnecting...", event.pid);
+                    [self reconnectDevice:deviceId];
                 } else {
-                    statusItem_.button.image = nil;
-                    statusItem_.button.title = @"🖱️ Not Found";
+                    [self unregisterDevice:deviceId];  // slot is gone from here on
+                    removed = true;
                 }
-             }
-        });
+                break;
+        }
     }
+
+    if (!claimed && event.added) {
+        [self registerDevice:event];
+    }
+    if (removed) {
+        // E.g. the dongle left while the mouse is still cabled: pick up what remains
+        [self discoverDevices];
+    }
+    [self updateStatusItem];
 }
 
-- (void)manualRefresh:(id)sender {
-    (void)sender;
-    [self handleUSBEvent];
+- (void)handleProbeResult:(const DeviceJobResult&)result slot:(DeviceSlot*)slot {
+    if (result.connected) {
+        [self noteReading:result slot:slot];  // Charger changes arrive this way
+    } else {
+        [self reconnectDevice:slot->id];
+    }
+    [self updateStatusItem];
 }
 
-- (void)connectToDevice {
-    // Try to connect
-    if (!razerDevice_->connect()) {
-        NSImage* icon = [self mouseIconWithColor:[NSColor systemGrayColor]];
-        if (icon) {
-            statusItem_.button.image = icon;
-            statusItem_.button.title = @"Not Found";
-        } else {
-            statusItem_.button.image = nil;
-            statusItem_.button.title = @"🖱️ Not Found";
-        }
-        NSLog(@"Failed to connect to Razer Viper V2 Pro");
-        
-        // Retry in 10 seconds if initial connection fails
-        [self performSelector:@selector(connectToDevice) withObject:nil afterDelay:10.0];
+- (void)probeDevice:(uint32_t)deviceId {
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr) {
         return;
     }
-    
-    // Initial battery query
-    [self updateBatteryDisplay];
-    
-    // Set up polling timer (30 seconds)
-    // We still keep this as a fallback for battery % changes over time
-    if (!pollTimer_) {
-        pollTimer_ = [NSTimer scheduledTimerWithTimeInterval:30.0
-                                                       target:self
-                                                     selector:@selector(pollBattery:)
-                                                     userInfo:nil
-                                                      repeats:YES];
+    MonitoredDevice* device = slot->device.get();
+    uint16_t pid = slot->pid;
+    DeviceWorker::Job job = [device, pid](DeviceJobResult& result) { runProbeJob(device, pid, result); };
+    [self postDeviceJob:deviceId key:kJobProbe job:job completion:^(DeviceSlot* done, const DeviceJobResult& result) {
+        [self handleProbeResult:result slot:done];
+    }];
+}
+
+- (void)reconnectDevice:(uint32_t)deviceId {
+    // Reconnect to device (may have changed mode)
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr) {
+        return;
     }
+    RazerDevice* usb = &slot->device->usb;
+    devices_->post(deviceId, kJobNone, [usb](DeviceJobResult& result) {
+        usb->disconnect();
+        result.connected = false;
+    });
+
+    // The device's serial worker runs the disconnect before the first attempt
+    slot->connection.onDeviceLost(monotonicMs());
+    [self armConnectTimer:deviceId];
 }
 
-- (void)updateBatteryDisplay {
-    if (razerDevice_ == nil) {
-        NSImage* icon = [self mouseIconWithColor:[NSColor whiteColor]];
-        if (icon) {
-            statusItem_.button.image = icon;
-            statusItem_.button.title = @"...";
-        } else {
-            statusItem_.button.image = nil;
-            statusItem_.button.title = @"🖱️ ...";
+- (void)startConnecting:(uint32_t)deviceId {
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr) {
+        return;
+    }
+    // First attempt fires immediately; retries follow the state machine's backoff
+    slot->connection.onDeviceMatched(monotonicMs());
+    [self armConnectTimer:deviceId];
+}
+
+- (void)armConnectTimer:(uint32_t)deviceId {
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr || !slot->connection.hasPendingAttempt()) {
+        return;
+    }
+
+    uint64_t generation = slot->connection.generation();
+    uint64_t now = monotonicMs();
+    uint64_t due = slot->connection.nextAttemptAtMs();
+    int64_t delayNs = due > now ? (int64_t)(due - now) * (int64_t)NSEC_PER_MSEC : 0;
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, delayNs), dispatch_get_main_queue(), ^{
+        // Unregistering, a restart or cancel since arming makes this timer stale
+        DeviceSlot* current = devices_ ? devices_->find(deviceId) : nullptr;
+        if (current == nullptr || current->connection.generation() != generation) {
+            return;
         }
+        [self connectTimerFired:deviceId];
+    });
+}
+
+- (void)connectTimerFired:(uint32_t)deviceId {
+    DeviceSlot* slot = devices_->find(deviceId);
+    if (slot == nullptr || !slot->connection.beginAttemptIfDue(monotonicMs())) {
         return;
     }
-    
-    if (!razerDevice_->isConnected()) {
-        // Only show disconnected if we really can't connect after a retry
-        if (!razerDevice_->connect()) {
-             NSImage* icon = [self mouseIconWithColor:[NSColor systemGrayColor]];
-             if (icon) {
-                 statusItem_.button.image = icon;
-                 statusItem_.button.title = @"Disconnected";
-             } else {
-                 statusItem_.button.image = nil;
-                 statusItem_.button.title = @"🖱️ Disconnected";
-             }
-             return;
+
+    [self postRefresh:deviceId key:kJobReconnect completion:^(DeviceSlot* done, const DeviceJobResult& result) {
+        done->connection.onAttemptFinished(result.reached, monotonicMs());
+
+        if (done->connection.state() == ConnectionState::Ready) {
+            done->device->everConnected = true;
+            [self noteReading:result slot:done];
+            [self updateStatusItem];
+            return;
+        }
+
+        NSLog(@"%s: connect attempt %u stopped at %s", done->device->name.c_str(),
+              done->connection.attempts(), connectionStateName(result.reached));
+        if (done->connection.gaveUp() || !done->device->everConnected) {
+            // Keep the last reading on screen while a known device re-enumerates
+            done->last.connected = false;
+            done->device->lastBatteryLevel = 0;
         }
-        NSLog(@"Reconnected to Razer device");
+        [self updateStatusItem];
+        [self armConnectTimer:done->id];
+    }];
+}
+
+- (void)noteReading:(const DeviceJobResult&)result slot:(DeviceSlot*)slot {
+    if (result.ok) {
+        slot->scheduler.addSample(monotonicMs(), result.snapshot.batteryPercent,
+                                  result.snapshot.chargingValid && result.snapshot.isCharging);
+        [self checkLowBattery:result device:slot->device.get()];
     }
-    
-    uint8_t batteryPercent = 0;
-    if (razerDevice_->queryBattery(batteryPercent)) {
-        lastBatteryLevel_ = batteryPercent;
-        
-        // Check charging status
-        bool isCharging = false;
-        razerDevice_->queryChargingStatus(isCharging);
-        
-        // Format title text (battery percentage + charging indicator)
-        NSString* titleText;
-        NSString* titleTextWithEmoji;
-        if (isCharging) {
-            titleText = [NSString stringWithFormat:@"%d%% ⚡", batteryPercent];
-            titleTextWithEmoji = [NSString stringWithFormat:@"🖱️ %d%% ⚡", batteryPercent];
-        } else {
-            titleText = [NSString stringWithFormat:@"%d%%", batteryPercent];
-            titleTextWithEmoji = [NSString stringWithFormat:@"🖱️ %d%%", batteryPercent];
+    [self schedulePoll:slot];
+}
+
+- (void)checkLowBattery:(const DeviceJobResult&)result device:(MonitoredDevice*)device {
+    uint8_t batteryPercent = result.snapshot.batteryPercent;
+    bool isCharging = result.snapshot.chargingValid && result.snapshot.isCharging;
+
+    // Low battery notification, once per device until it recovers or charges
+    if (batteryPercent < 20 && batteryPercent > 0 && !device->notificationShown && !isCharging) {
+        [self showLowBatteryNotification:batteryPercent device:device];
+        device->notificationShown = true;
+    } else if (batteryPercent >= 20 || isCharging) {
+        device->notificationShown = false;
+    }
+}
+
+- (void)drainSamples:(MonitoredDevice*)device {
+    BatterySample sample;
+    while (device->samples.pop(sample)) {
+        device->drainModel.add(sample);
+        device->history.append(HistoryLog::makeRecord(sample));
+    }
+}
+
+- (void)openHistory:(MonitoredDevice*)device model:(const RazerSupportedDevice&)model {
+    if (historyDirectory_ == nil) {
+        NSArray* dirs = NSSearchPathForDirectoriesInDomains(NSApplicationSupportDirectory, NSUserDomainMask, YES);
+        if ([dirs count] == 0) {
+            return;
         }
-        
-        // Color based on battery level (for both icon and text)
-        NSColor* displayColor;
-        if (batteryPercent <= 20) {
-            displayColor = [NSColor systemRedColor];      // Critical: Red (0-20%)
-        } else if (batteryPercent <= 40) {
-            displayColor = [NSColor systemYellowColor];   // Warning: Yellow (21-40%)
-        } else {
-            displayColor = [NSColor systemGreenColor];    // Good: Green (41-100%)
+        NSString* dir = [[dirs objectAtIndex:0] stringByAppendingPathComponent:@"RazerBatteryMonitor"];
+        [[NSFileManager defaultManager] createDirectoryAtPath:dir withIntermediateDirectories:YES
+                                                   attributes:nil error:nil];
+        historyDirectory_ = [dir retain];
+    }
+
+    // One file per model (named by its wireless PID, so cable and dongle share
+    // it); a second mouse of the same model gets its own file per port
+    NSString* file = [NSString stringWithFormat:@"history-%04x.bin", model.wirelessPid];
+    for (DeviceSlot* slot : devices_->slots()) {
+        if (RazerDeviceTable::find(slot->pid).device == &model) {
+            file = [NSString stringWithFormat:@"history-%04x-%08x.bin", model.wirelessPid, device->locationId];
+            break;
         }
-        
-        // Set icon (SF Symbol or emoji fallback)
-        NSImage* icon = [self mouseIconWithColor:displayColor];
-        if (icon) {
-            statusItem_.button.image = icon;
-            statusItem_.button.title = titleText;
+    }
+    NSString* path = [historyDirectory_ stringByAppendingPathComponent:file];
+    if (!device->history.open([path fileSystemRepresentation])) {
+        return;  // Run without persistence
+    }
+
+    // Last known level and drain model from disk, before the first (slow) query
+    HistoryRecord last;
+    if (device->history.replay(device->drainModel) > 0 && device->history.latest(last)) {
+        device->lastBatteryLevel = last.percent;
+        device->status.batteryValid = true;
+        device->status.batteryPercent = last.percent;
+        device->status.charging = (last.flags & HISTORY_FLAG_CHARGING) != 0;
+        device->status.timeMs = last.wallMs;
+    }
+}
+
+- (void)updateEstimate {
+    // Estimates go into the tooltip; the title stays a plain percentage
+    std::vector<DeviceEstimate> estimates;
+    for (DeviceSlot* slot : devices_->slots()) {
+        const DrainModel& model = slot->device->drainModel;
+        uint64_t remainingMs = 0;
+        if (model.timeToEmptyMs(remainingMs)) {
+            estimates.push_back(DeviceEstimate{slot->id, slot->pid, false, remainingMs / 60000});
+        } else if (model.timeToFullMs(remainingMs)) {
+            estimates.push_back(DeviceEstimate{slot->id, slot->pid, true, remainingMs / 60000});
+        }
+    }
+    if (estimates == shownEstimates_ && statusItem_.button.toolTip != nil) {
+        return;  // Same minutes as shown: no string to build
+    }
+    shownEstimates_.swap(estimates);
+
+    NSMutableString* tooltip = [NSMutableString stringWithString:@"Razer Battery Monitor"];
+    for (const DeviceEstimate& estimate : shownEstimates_) {
+        const char* name = devices_->find(estimate.id)->device->name.c_str();
+        uint64_t minutes = estimate.minutes;
+        if (estimate.toFull) {
+            [tooltip appendFormat:@"\n%s: ~%llu h %02llu min to full", name, minutes / 60, minutes % 60];
         } else {
-            statusItem_.button.image = nil;
-            statusItem_.button.title = titleTextWithEmoji;
+            [tooltip appendFormat:@"\n%s: ~%llu h %02llu min remaining", name, minutes / 60, minutes % 60];
         }
-        
-        // Apply colored text
-        NSString* finalTitle = icon ? titleText : titleTextWithEmoji;
-        NSDictionary* attrs = @{
-            NSForegroundColorAttributeName: displayColor,
-            NSFontAttributeName: [NSFont menuBarFontOfSize:0]
-        };
-        statusItem_.button.attributedTitle = [[NSAttributedString alloc] initWithString:finalTitle attributes:attrs];
-        
-        // Low battery notification
-        if (batteryPercent < 20 && batteryPercent > 0 && !notificationShown_ && !isCharging) {
-            [self showLowBatteryNotification:batteryPercent];
-            notificationShown_ = true;
-        } else if (batteryPercent >= 20 || isCharging) {
-            notificationShown_ = false;
+    }
+    statusItem_.button.toolTip = tooltip;
+}
+
+- (void)schedulePoll:(DeviceSlot*)slot {
+    // Polling is a fallback for battery % changes over time; each device's
+    // interval follows its own measured drain rate (~1% per poll)
+    [self cancelPoll:slot->id];
+
+    NSTimeInterval interval = slot->scheduler.nextIntervalMs() / 1000.0;
+    NSTimer* timer = [NSTimer scheduledTimerWithTimeInterval:interval
+                                                      target:self
+                                                    selector:@selector(pollBattery:)
+                                                    userInfo:@(slot->id)
+                                                     repeats:NO];
+    // Let the system batch this wakeup with others
+    timer.tolerance = interval / 10.0;
+    [pollTimers_ setObject:timer forKey:@(slot->id)];
+}
+
+- (void)cancelPoll:(uint32_t)deviceId {
+    NSTimer* timer = [pollTimers_ objectForKey:@(deviceId)];
+    if (timer) {
+        [timer invalidate];
+        [pollTimers_ removeObjectForKey:@(deviceId)];
+    }
+}
+
+- (void)manualRefresh:(id)sender {
+    (void)sender;
+    // Probe every device at once on its own worker: the slowest one bounds the wait
+    uint64_t startedMs = monotonicMs();
+    size_t posted = devices_->postAll(kJobProbe,
+        [](DeviceSlot& slot) -> DeviceWorker::Job {
+            MonitoredDevice* device = slot.device.get();
+            uint16_t pid = slot.pid;
+            return [device, pid](DeviceJobResult& result) { runProbeJob(device, pid, result); };
+        },
+        [self](uint32_t deviceId, const DeviceJobResult& result) {
+            DeviceJobResult copy = result;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                DeviceSlot* slot = [self acceptResult:copy forDevice:deviceId];
+                if (slot != nullptr) {
+                    // Keep the interface if it still answers; reconnect only if it does not
+                    [self handleProbeResult:copy slot:slot];
+                }
+            });
+        },
+        [startedMs]() {
+            uint64_t elapsedMs = monotonicMs() - startedMs;
+            dispatch_async(dispatch_get_main_queue(), ^{
+                NSLog(@"Refreshed all devices in %llu ms", elapsedMs);
+            });
+        });
+
+    if (posted == 0) {
+        // Nothing registered: look again (e.g. attached before permissions were granted)
+        [self discoverDevices];
+        [self updateStatusItem];
+    }
+}
+
+- (void)copyTransferStats:(id)sender {
+    (void)sender;
+    // Histograms are atomics written by the workers: safe to read from here
+    std::string text;
+    for (DeviceSlot* slot : devices_->slots()) {
+        text += slot->device->name + " (" + std::to_string(slot->id) + ")\n";
+        text += slot->device->usb.transferStats().toText();
+    }
+    if (text.empty()) {
+        text = "No devices\n";
+    }
+
+    NSPasteboard* pasteboard = [NSPasteboard generalPasteboard];
+    [pasteboard clearContents];
+    [pasteboard setString:[NSString stringWithUTF8String:text.c_str()] forType:NSPasteboardTypeString];
+    NSLog(@"Transfer statistics:\n%s", text.c_str());
+}
+
+- (void)showNotFound {
+    [self showMenuBarState:MenuBarState::of(MenuBarState::NotFound)];
+}
+
+- (void)refreshDevice:(uint32_t)deviceId {
+    [self postRefresh:deviceId key:kJobRefresh completion:^(DeviceSlot* slot, const DeviceJobResult& result) {
+        if (result.connected) {
+            [self noteReading:result slot:slot];
+        } else if (slot->connection.state() == ConnectionState::Ready) {
+            // Lost the device between polls: let the state machine take over
+            slot->connection.onDeviceLost(monotonicMs());
+            [self armConnectTimer:slot->id];
+        }
+        [self updateStatusItem];
+    }];
+}
+
+- (void)updateStatusItem {
+    // The title follows the device that needs attention first: connected before
+    // disconnected, then the lowest known level
+    DeviceSlot* shown = nullptr;
+    for (DeviceSlot* slot : devices_->slots()) {
+        if (slot->device->lastBatteryLevel == 0 && !slot->last.connected) {
+            continue;
         }
+        if (shown == nullptr) {
+            shown = slot;
+            continue;
+        }
+        bool connected = slot->last.connected;
+        bool shownConnected = shown->last.connected;
+        if (connected != shownConnected) {
+            if (connected) {
+                shown = slot;
+            }
+        } else if (slot->device->lastBatteryLevel < shown->device->lastBatteryLevel) {
+            shown = slot;
+        }
+    }
+
+    if (shown != nullptr) {
+        [self displayResult:shown->last device:shown->device.get()];
     } else {
-        // If query fails, show cached value with (?) indicator to avoid flickering
-        NSString* errorText;
-        NSString* errorTextWithEmoji;
-        NSColor* errorColor = [NSColor systemGrayColor];
-        if (lastBatteryLevel_ > 0) {
-            errorText = [NSString stringWithFormat:@"%d%% (?)", lastBatteryLevel_];
-            errorTextWithEmoji = [NSString stringWithFormat:@"🖱️ %d%% (?)", lastBatteryLevel_];
-        } else {
-            errorText = @"Error";
-            errorTextWithEmoji = @"🖱️ Error";
+        // Keep "..." while a device is still on its first connect attempt
+        bool firstAttempt = false;
+        for (DeviceSlot* slot : devices_->slots()) {
+            const ConnectionStateMachine& connection = slot->connection;
+            if (connection.attempts() == 0 || (connection.attempts() == 1 && connection.attemptInFlight())) {
+                firstAttempt = true;
+            }
         }
-        
-        NSImage* icon = [self mouseIconWithColor:errorColor];
-        if (icon) {
-            statusItem_.button.image = icon;
-            statusItem_.button.title = errorText;
+        if (!firstAttempt) {
+            [self showNotFound];
+        }
+    }
+    [self updateDeviceMenu];
+    [self updateEstimate];
+}
+
+- (void)updateDeviceMenu {
+    // One row per device, in registry order
+    std::vector<DeviceMenuRow> rows;
+    for (DeviceSlot* slot : devices_->slots()) {
+        const MonitoredDevice& device = *slot->device;
+        MenuBarState state;
+        if (!slot->last.connected) {
+            state = MenuBarState::of(slot->connection.gaveUp() ? MenuBarState::NotFound : MenuBarState::Connecting);
+        } else if (slot->last.ok) {
+            bool charging = slot->last.snapshot.chargingValid && slot->last.snapshot.isCharging;
+            state = MenuBarState::reading(device.lastBatteryLevel, charging);
+        } else if (device.lastBatteryLevel > 0) {
+            state = MenuBarState::stale(device.lastBatteryLevel);
         } else {
-            statusItem_.button.image = nil;
-            statusItem_.button.title = errorTextWithEmoji;
+            state = MenuBarState::of(MenuBarState::Error);
         }
-        
-        NSString* finalTitle = icon ? errorText : errorTextWithEmoji;
-        NSDictionary* attrs = @{
-            NSForegroundColorAttributeName: errorColor,
-            NSFontAttributeName: [NSFont menuBarFontOfSize:0]
-        };
-        statusItem_.button.attributedTitle = [[NSAttributedString alloc] initWithString:finalTitle attributes:attrs];
+        rows.push_back(DeviceMenuRow{slot->id, slot->pid, state});
+    }
+    if (rows == shownRows_) {
+        return;  // Same rows as on screen: leave the menu alone
+    }
+
+    // Same devices: retitle the rows that changed. Otherwise rebuild them all.
+    NSMenu* menu = statusItem_.menu;
+    bool sameDevices = rows.size() == shownRows_.size();
+    for (size_t i = 0; sameDevices && i < rows.size(); i++) {
+        sameDevices = rows[i].id == shownRows_[i].id && rows[i].pid == shownRows_[i].pid;
+    }
+    if (!sameDevices) {
+        for (NSMenuItem* item in deviceMenuItems_) {
+            [menu removeItem:item];
+        }
+        [deviceMenuItems_ removeAllObjects];
+    }
+
+    NSInteger index = 0;
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (sameDevices && rows[i] == shownRows_[i]) {
+            continue;
+        }
+        char text[64];
+        rows[i].state.formatTitle(text, sizeof(text), false);
+        const char* name = devices_->find(rows[i].id)->device->name.c_str();
+        NSString* title = [NSString stringWithFormat:@"%s: %s", name, text];
+        if (sameDevices) {
+            [[deviceMenuItems_ objectAtIndex:i] setTitle:title];
+            continue;
+        }
+        NSMenuItem* item = [[NSMenuItem alloc] initWithTitle:title action:nil keyEquivalent:@""];
+        [item setEnabled:NO];
+        [menu insertItem:item atIndex:index++];
+        [deviceMenuItems_ addObject:item];
+        [item release];
+    }
+    if (!sameDevices && !rows.empty()) {
+        // Separator above Refresh
+        NSMenuItem* separator = [NSMenuItem separatorItem];
+        [menu insertItem:separator atIndex:index];
+        [deviceMenuItems_ addObject:separator];
+    }
+    shownRows_.swap(rows);
+}
+
+- (void)displayResult:(const DeviceJobResult&)result device:(MonitoredDevice*)device {
+    const RazerSnapshot& snapshot = result.snapshot;
+    if (!result.connected) {
+        // Only show disconnected if we really can't connect after a retry
+        [self showMenuBarState:MenuBarState::of(MenuBarState::Disconnected)];
+    } else if (snapshot.batteryValid) {
+        // Charging status from the same batch
+        bool isCharging = snapshot.chargingValid && snapshot.isCharging;
+        [self showMenuBarState:MenuBarState::reading(snapshot.batteryPercent, isCharging)];
+    } else if (device->lastBatteryLevel > 0) {
+        // If query fails, show cached value with (?) indicator to avoid flickering
+        [self showMenuBarState:MenuBarState::stale(device->lastBatteryLevel)];
+    } else {
+        [self showMenuBarState:MenuBarState::of(MenuBarState::Error)];
+    }
+}
+
+- (void)showMenuBarState:(const MenuBarState&)state {
+    if (menuBarDrawn_ && state == shownState_) {
+        return;  // Same reading as on screen: no AppKit work at all
     }
+    if (state.tint() == MenuBarState::TintNone) {
+        char text[64];
+        state.formatTitle(text, sizeof(text), mouseIcon_ == nil);
+        statusItem_.button.title = [NSString stringWithUTF8String:text];
+    } else if (state.kind == MenuBarState::Reading) {
+        statusItem_.button.attributedTitle = [readingTitles_ objectAtIndex:state.readingIndex()];
+    } else {
+        statusItem_.button.attributedTitle = [self titleForState:state];  // Rare: failed queries
+    }
+    shownState_ = state;
+    menuBarDrawn_ = true;
+}
+
+- (NSAttributedString*)titleForState:(const MenuBarState&)state {
+    char text[64];
+    state.formatTitle(text, sizeof(text), mouseIcon_ == nil);
+    NSDictionary* attrs = @{
+        NSForegroundColorAttributeName: colorForTint(state.tint()),
+        NSFontAttributeName: [NSFont menuBarFontOfSize:0]
+    };
+    return [[[NSAttributedString alloc] initWithString:[NSString stringWithUTF8String:text]
+                                            attributes:attrs] autorelease];
 }
 
 - (void)pollBattery:(NSTimer*)timer {
-    (void)timer;
-    [self updateBatteryDisplay];
+    // Non-repeating: already invalidated by firing
+    uint32_t deviceId = [(NSNumber*)[timer userInfo] unsignedIntValue];
+    [pollTimers_ removeObjectForKey:@(deviceId)];
+    [self refreshDevice:deviceId];
 }
 
-- (NSImage*)mouseIconWithColor:(NSColor*)color {
-    (void)color;  // Color parameter reserved for future use
-    
+- (NSImage*)loadMouseIcon {
     // Try SF Symbol first (macOS 11+)
     if (@available(macOS 11.0, *)) {
         NSImage* icon = [NSImage imageWithSystemSymbolName:@"computermouse.fill" 
@@ -327,9 +984,9 @@ static void onDeviceChange(void* context) {
     return nil;
 }
 
-- (void)showLowBatteryNotification:(uint8_t)batteryPercent {
+- (void)showLowBatteryNotification:(uint8_t)batteryPercent device:(MonitoredDevice*)device {
     NSUserNotification* notification = [[NSUserNotification alloc] init];
-    [notification setTitle:@"Razer Viper V2 Pro - Low Battery"];
+    [notification setTitle:[NSString stringWithFormat:@"%s - Low Battery", device->name.c_str()]];
     [notification setInformativeText:[NSString stringWithFormat:@"Battery level is %d%%. Please charge your mouse.", batteryPercent]];
     [notification setSoundName:NSUserNotificationDefaultSoundName];
     
@@ -341,14 +998,24 @@ static void onDeviceChange(void* context) {
 
 - (void)applicationWillTerminate:(NSNotification*)notification {
     (void)notification;
-    if (pollTimer_) {
-        [pollTimer_ invalidate];
-        pollTimer_ = nil;
+    for (NSTimer* timer in [pollTimers_ allValues]) {
+        [timer invalidate];
+    }
+    [pollTimers_ removeAllObjects];
+    if (deviceMonitor_) {
+        deviceMonitor_->stopMonitoring();
     }
-    if (razerDevice_) {
-        razerDevice_->stopMonitoring();
-        razerDevice_->disconnect();
+    if (devices_) {
+        // No jobs may run once the devices are being torn down
+        for (DeviceSlot* slot : devices_->slots()) {
+            slot->connection.cancel();
+        }
+        devices_->stopAll();
+        for (DeviceSlot* slot : devices_->slots()) {
+            slot->device->usb.disconnect();
+        }
     }
+    sharedStatus_->close();
 }
 
 @end
@@ -0,0 +1,115 @@
+/**
+ * replay.cpp - Replays a captured RazerTrace without the mouse
+ *
+ * Feeds a trace recorded by `RazerBatteryDaemon --trace` (or
+ * RazerDevice::startTrace) back through RazerProtocol, at the recorded pace or
+ * as fast as the CPU allows, and reports what the protocol made of it and
+ * whether it still sends exactly the recorded requests. --dump lists the
+ * records instead. Portable: `make CXX=g++ replay` builds it on Linux.
+ *
+ * Usage: RazerReplay TRACE [--realtime] [--loops N] [--dump]
+ */
+
+#include "RazerTrace.hpp"
+#include "TraceReplay.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+
+const char* kindName(uint8_t kind) {
+    switch (kind) {
+        case TRACE_SEND: return "send";
+        case TRACE_READ: return "read";
+        case TRACE_EVENT: return "event";
+        case TRACE_PROFILE: return "profile";
+    }
+    return "unknown";
+}
+
+void dump(const RazerTraceReader& trace) {
+    for (const RazerTraceRecord& record : trace.records()) {
+        printf("%10.3f ms  %-7s %s", record.timeUs / 1000.0, kindName(record.kind), record.ok ? "  " : "! ");
+        uint16_t pid = 0;
+        RazerProtocolProfile profile;
+        if (RazerTraceReader::readProfile(record, pid, profile)) {
+            printf("pid 0x%04x transaction 0x%02x battery@%u charging@%u\n", pid, profile.transactionId,
+                   profile.batteryOffset, profile.chargingOffset);
+        } else if ((record.kind == TRACE_SEND || record.kind == TRACE_READ) &&
+                   record.length == RazerProtocol::REPORT_SIZE) {
+            RazerResponseView view(record.data);
+            printf("status 0x%02x transaction 0x%02x command 0x%02x/0x%02x args %02x %02x %02x %02x\n",
+                   view.status(), record.data[RazerReportLayout::TRANSACTION_ID],
+                   view.commandClass(), view.commandId(), view.arg(0), view.arg(1), view.arg(2), view.arg(3));
+        } else {
+            for (size_t i = 0; i < record.length && i < 16; i++) {
+                printf("%02x ", record.data[i]);
+            }
+            printf("\n");
+        }
+    }
+}
+
+} // namespace
+
+int main(int argc, const char* argv[]) {
+    std::string path;
+    bool realtime = false;
+    bool listRecords = false;
+    uint32_t loops = 1;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--realtime") == 0) {
+            realtime = true;
+        } else if (std::strcmp(argv[i], "--dump") == 0) {
+            listRecords = true;
+        } else if (std::strcmp(argv[i], "--loops") == 0 && i + 1 < argc) {
+            loops = (uint32_t)std::max(1, atoi(argv[++i]));
+        } else if (path.empty() && argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " TRACE [--realtime] [--loops N] [--dump]" << std::endl;
+        return 2;
+    }
+
+    RazerTraceReader trace;
+    if (!trace.load(path)) {
+        std::cerr << path << " is not a Razer trace" << std::endl;
+        return 1;
+    }
+    if (listRecords) {
+        dump(trace);
+        return 0;
+    }
+
+    TraceReplay replay(trace);
+    TraceReplayResult result;
+    replay.run(realtime, loops, result);
+
+    std::cout << path << ": " << trace.records().size() << " records, "
+              << trace.durationUs() / 1000 << " ms recorded" << std::endl;
+    std::cout << "  " << result.calls << " protocol calls, " << result.transfers << " transfers, "
+              << result.events << " events, " << result.readings << " battery readings" << std::endl;
+    std::cout << "  replayed " << loops << "x in " << result.elapsedUs / 1000.0 << " ms";
+    if (result.elapsedUs != 0) {
+        std::cout << " (" << (double)result.recordedUs / (double)result.elapsedUs << "x real time)";
+    }
+    std::cout << std::endl;
+    if (result.snapshot.batteryValid) {
+        std::cout << "  last battery " << (int)result.snapshot.batteryPercent << "%"
+                  << (result.snapshot.chargingValid && result.snapshot.isCharging ? ", charging" : "") << std::endl;
+    }
+    if (result.mismatches != 0) {
+        std::cout << "  " << result.mismatches << " requests differ from the recording" << std::endl;
+        return 1;
+    }
+    return 0;
+}